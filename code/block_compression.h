@@ -0,0 +1,452 @@
+#if !defined BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+// cpu block compression for gpu textures
+// - BC1 (GL_COMPRESSED_RGB_S3TC_DXT1_EXT) for opaque color, 8 bytes per 4x4 block
+// - BC5 (GL_COMPRESSED_RG_RGTC2) for normal maps (x and y, z is reconstructed), 16 bytes per 4x4 block
+//
+// both use a range fit: endpoints from the (inset) bounding box, indices by projection onto the endpoint axis.
+// every kernel has a scalar reference and an sse2 version, which compute the same indices
+// with the same float operations, so their output is identical.
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && (_M_IX86_FP >= 2))
+#   define BLOCK_COMPRESSION_SSE2
+#   include <emmintrin.h>
+#endif
+
+#if !defined GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#   define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+#if !defined GL_COMPRESSED_RG_RGTC2
+#   define GL_COMPRESSED_RG_RGTC2 0x8DBD
+#endif
+
+enum Block_Format {
+    Block_Format_BC1,
+    Block_Format_BC5,
+};
+
+inline u32 get_block_size(Block_Format format) {
+    return (format == Block_Format_BC1) ? 8 : 16;
+}
+
+inline GLenum get_block_gl_format(Block_Format format) {
+    return (format == Block_Format_BC1) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RG_RGTC2;
+}
+
+inline u32 get_compressed_image_size(u32 width, u32 height, Block_Format format) {
+    return ((width + 3) / 4) * ((height + 3) / 4) * get_block_size(format);
+}
+
+// helpers
+
+inline u16 rgb_to_565(u32 r, u32 g, u32 b) {
+    return cast_v(u16, ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+inline void rgb_from_565(s32 *rgb, u16 color) {
+    s32 r = (color >> 11) & 31;
+    s32 g = (color >> 5)  & 63;
+    s32 b =  color        & 31;
+
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// projection index q (0 at e1, 3 at e0) to bc1 index
+u8 const Bc1_Index_From_Projection[4] = { 1, 3, 2, 0 };
+
+// projection index q (0 at e1, 7 at e0) to bc4 index
+u8 const Bc4_Index_From_Projection[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+// the part both bc1 kernels share: endpoints from the channel bounds
+struct Bc1_Endpoints {
+    u16 color0;
+    u16 color1;
+    s32 e1[3];
+    s32 axis[3];
+    f32 scale;
+};
+
+// returns false if the block has a single color (all indices 0)
+bool bc1_find_endpoints(Bc1_Endpoints *endpoints, u8 const *min_color, u8 const *max_color) {
+    u32 low[3];
+    u32 high[3];
+
+    // inset the bounding box by 1/16 to reduce the error of the outer pixels
+    for (u32 c = 0; c < 3; c++) {
+        u32 inset = (max_color[c] - min_color[c]) >> 4;
+        low[c]  = min_color[c] + inset;
+        high[c] = max_color[c] - inset;
+    }
+
+    endpoints->color0 = rgb_to_565(high[0], high[1], high[2]);
+    endpoints->color1 = rgb_to_565(low[0],  low[1],  low[2]);
+
+    // high >= low per channel, so color0 >= color1 and the block is in 4 color mode unless they are equal
+    if (endpoints->color0 == endpoints->color1)
+        return false;
+
+    s32 e0[3];
+    rgb_from_565(e0, endpoints->color0);
+    rgb_from_565(endpoints->e1, endpoints->color1);
+
+    s32 total = 0;
+    for (u32 c = 0; c < 3; c++) {
+        endpoints->axis[c] = e0[c] - endpoints->e1[c];
+        total += endpoints->axis[c] * endpoints->axis[c];
+    }
+
+    endpoints->scale = 3.0f / total;
+
+    return true;
+}
+
+void bc1_write_block(u8 *block, u16 color0, u16 color1, u8 const *projections) {
+    u32 indices = 0;
+    for (u32 i = 0; i < 16; i++)
+        indices |= cast_v(u32, Bc1_Index_From_Projection[projections[i]]) << (i * 2);
+
+    block[0] = cast_v(u8, color0);
+    block[1] = cast_v(u8, color0 >> 8);
+    block[2] = cast_v(u8, color1);
+    block[3] = cast_v(u8, color1 >> 8);
+    block[4] = cast_v(u8, indices);
+    block[5] = cast_v(u8, indices >> 8);
+    block[6] = cast_v(u8, indices >> 16);
+    block[7] = cast_v(u8, indices >> 24);
+}
+
+void bc4_write_block(u8 *block, u8 max_value, u8 min_value, u8 const *projections) {
+    u64 indices = 0;
+    for (u32 i = 0; i < 16; i++)
+        indices |= cast_v(u64, Bc4_Index_From_Projection[projections[i]]) << (i * 3);
+
+    block[0] = max_value;
+    block[1] = min_value;
+
+    for (u32 i = 0; i < 6; i++)
+        block[2 + i] = cast_v(u8, indices >> (i * 8));
+}
+
+// scalar reference
+
+// rgba: 16 pixels with 4 bytes each, alpha is ignored
+void bc1_compress_block_scalar(u8 *block, u8 const *rgba) {
+    u8 min_color[3] = { 255, 255, 255 };
+    u8 max_color[3] = { 0, 0, 0 };
+
+    for (u32 i = 0; i < 16; i++) {
+        for (u32 c = 0; c < 3; c++) {
+            min_color[c] = min(min_color[c], rgba[i * 4 + c]);
+            max_color[c] = max(max_color[c], rgba[i * 4 + c]);
+        }
+    }
+
+    u8 projections[16] = {};
+
+    Bc1_Endpoints endpoints;
+    if (bc1_find_endpoints(&endpoints, min_color, max_color)) {
+        for (u32 i = 0; i < 16; i++) {
+            s32 d = 0;
+            for (u32 c = 0; c < 3; c++)
+                d += (rgba[i * 4 + c] - endpoints.e1[c]) * endpoints.axis[c];
+
+            s32 q = cast_v(s32, cast_v(f32, d) * endpoints.scale + 0.5f);
+            projections[i] = cast_v(u8, min(max(q, 0), 3));
+        }
+    }
+    else {
+        // index 0 is color0
+        for (u32 i = 0; i < 16; i++)
+            projections[i] = 3;
+    }
+
+    bc1_write_block(block, endpoints.color0, endpoints.color1, projections);
+}
+
+// values: 16 single channel values with the given stride in bytes
+void bc4_compress_block_scalar(u8 *block, u8 const *values, u32 stride) {
+    u8 min_value = 255;
+    u8 max_value = 0;
+
+    for (u32 i = 0; i < 16; i++) {
+        min_value = min(min_value, values[i * stride]);
+        max_value = max(max_value, values[i * stride]);
+    }
+
+    u8 projections[16];
+
+    if (max_value == min_value) {
+        for (u32 i = 0; i < 16; i++)
+            projections[i] = 7;
+    }
+    else {
+        f32 scale = 7.0f / (max_value - min_value);
+
+        for (u32 i = 0; i < 16; i++) {
+            s32 q = cast_v(s32, cast_v(f32, values[i * stride] - min_value) * scale + 0.5f);
+            projections[i] = cast_v(u8, min(max(q, 0), 7));
+        }
+    }
+
+    bc4_write_block(block, max_value, min_value, projections);
+}
+
+// rgba: 16 pixels with 4 bytes each, r and g are compressed
+void bc5_compress_block_scalar(u8 *block, u8 const *rgba) {
+    bc4_compress_block_scalar(block,     rgba + 0, 4);
+    bc4_compress_block_scalar(block + 8, rgba + 1, 4);
+}
+
+#if defined BLOCK_COMPRESSION_SSE2
+
+// q values of 16 pixels, clamped to [0, max_q]
+inline void sse2_store_projections(u8 *projections, __m128 f0, __m128 f1, __m128 f2, __m128 f3, s16 max_q) {
+    __m128i q01 = _mm_packs_epi32(_mm_cvttps_epi32(f0), _mm_cvttps_epi32(f1));
+    __m128i q23 = _mm_packs_epi32(_mm_cvttps_epi32(f2), _mm_cvttps_epi32(f3));
+
+    __m128i zero  = _mm_setzero_si128();
+    __m128i upper = _mm_set1_epi16(max_q);
+    q01 = _mm_min_epi16(_mm_max_epi16(q01, zero), upper);
+    q23 = _mm_min_epi16(_mm_max_epi16(q23, zero), upper);
+
+    _mm_storeu_si128(cast_p(__m128i, projections), _mm_packs_epi16(q01, q23));
+}
+
+// projections of 4 pixels (rgba bytes in the low 16 bytes) onto the axis
+inline __m128 sse2_bc1_project(__m128i pixels, __m128i e1, __m128i axis, __m128 scale) {
+    __m128i zero = _mm_setzero_si128();
+
+    // [r*ar + g*ag, b*ab + a*0] per pixel
+    __m128i low  = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(pixels, zero), e1), axis);
+    __m128i high = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(pixels, zero), e1), axis);
+
+    low  = _mm_add_epi32(low,  _mm_shuffle_epi32(low,  _MM_SHUFFLE(2, 3, 0, 1)));
+    high = _mm_add_epi32(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    __m128i d = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(low), _mm_castsi128_ps(high), _MM_SHUFFLE(2, 0, 2, 0)));
+
+    return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(d), scale), _mm_set1_ps(0.5f));
+}
+
+void bc1_compress_block_sse2(u8 *block, u8 const *rgba) {
+    __m128i p0 = _mm_loadu_si128(cast_p(__m128i, rgba) + 0);
+    __m128i p1 = _mm_loadu_si128(cast_p(__m128i, rgba) + 1);
+    __m128i p2 = _mm_loadu_si128(cast_p(__m128i, rgba) + 2);
+    __m128i p3 = _mm_loadu_si128(cast_p(__m128i, rgba) + 3);
+
+    __m128i min_color = _mm_min_epu8(_mm_min_epu8(p0, p1), _mm_min_epu8(p2, p3));
+    __m128i max_color = _mm_max_epu8(_mm_max_epu8(p0, p1), _mm_max_epu8(p2, p3));
+
+    min_color = _mm_min_epu8(min_color, _mm_shuffle_epi32(min_color, _MM_SHUFFLE(1, 0, 3, 2)));
+    min_color = _mm_min_epu8(min_color, _mm_shuffle_epi32(min_color, _MM_SHUFFLE(2, 3, 0, 1)));
+    max_color = _mm_max_epu8(max_color, _mm_shuffle_epi32(max_color, _MM_SHUFFLE(1, 0, 3, 2)));
+    max_color = _mm_max_epu8(max_color, _mm_shuffle_epi32(max_color, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    u32 min_bits = cast_v(u32, _mm_cvtsi128_si32(min_color));
+    u32 max_bits = cast_v(u32, _mm_cvtsi128_si32(max_color));
+
+    u8 min_bytes[4] = { cast_v(u8, min_bits), cast_v(u8, min_bits >> 8), cast_v(u8, min_bits >> 16), cast_v(u8, min_bits >> 24) };
+    u8 max_bytes[4] = { cast_v(u8, max_bits), cast_v(u8, max_bits >> 8), cast_v(u8, max_bits >> 16), cast_v(u8, max_bits >> 24) };
+
+    u8 projections[16];
+
+    Bc1_Endpoints endpoints;
+    if (bc1_find_endpoints(&endpoints, min_bytes, max_bytes)) {
+        __m128i e1   = _mm_setr_epi16(endpoints.e1[0],   endpoints.e1[1],   endpoints.e1[2],   0, endpoints.e1[0],   endpoints.e1[1],   endpoints.e1[2],   0);
+        __m128i axis = _mm_setr_epi16(endpoints.axis[0], endpoints.axis[1], endpoints.axis[2], 0, endpoints.axis[0], endpoints.axis[1], endpoints.axis[2], 0);
+        __m128 scale = _mm_set1_ps(endpoints.scale);
+
+        sse2_store_projections(projections,
+                               sse2_bc1_project(p0, e1, axis, scale),
+                               sse2_bc1_project(p1, e1, axis, scale),
+                               sse2_bc1_project(p2, e1, axis, scale),
+                               sse2_bc1_project(p3, e1, axis, scale),
+                               3);
+    }
+    else {
+        memset(projections, 3, sizeof(projections));
+    }
+
+    bc1_write_block(block, endpoints.color0, endpoints.color1, projections);
+}
+
+// values: 16 bytes
+void bc4_compress_block_sse2(u8 *block, __m128i values) {
+    __m128i min_value = values;
+    __m128i max_value = values;
+
+    min_value = _mm_min_epu8(min_value, _mm_srli_si128(min_value, 8));
+    min_value = _mm_min_epu8(min_value, _mm_srli_si128(min_value, 4));
+    min_value = _mm_min_epu8(min_value, _mm_srli_si128(min_value, 2));
+    min_value = _mm_min_epu8(min_value, _mm_srli_si128(min_value, 1));
+    max_value = _mm_max_epu8(max_value, _mm_srli_si128(max_value, 8));
+    max_value = _mm_max_epu8(max_value, _mm_srli_si128(max_value, 4));
+    max_value = _mm_max_epu8(max_value, _mm_srli_si128(max_value, 2));
+    max_value = _mm_max_epu8(max_value, _mm_srli_si128(max_value, 1));
+
+    u8 low  = cast_v(u8, _mm_cvtsi128_si32(min_value));
+    u8 high = cast_v(u8, _mm_cvtsi128_si32(max_value));
+
+    u8 projections[16];
+
+    if (high == low) {
+        memset(projections, 7, sizeof(projections));
+    }
+    else {
+        __m128i zero = _mm_setzero_si128();
+        __m128 scale = _mm_set1_ps(7.0f / (high - low));
+        __m128 half  = _mm_set1_ps(0.5f);
+
+        __m128i offsets = _mm_sub_epi8(values, _mm_set1_epi8(cast_v(char, low)));
+        __m128i offsets_low  = _mm_unpacklo_epi8(offsets, zero);
+        __m128i offsets_high = _mm_unpackhi_epi8(offsets, zero);
+
+        sse2_store_projections(projections,
+                               _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(offsets_low,  zero)), scale), half),
+                               _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(offsets_low,  zero)), scale), half),
+                               _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(offsets_high, zero)), scale), half),
+                               _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(offsets_high, zero)), scale), half),
+                               7);
+    }
+
+    bc4_write_block(block, high, low, projections);
+}
+
+void bc5_compress_block_sse2(u8 *block, u8 const *rgba) {
+    __m128i p0 = _mm_loadu_si128(cast_p(__m128i, rgba) + 0);
+    __m128i p1 = _mm_loadu_si128(cast_p(__m128i, rgba) + 1);
+    __m128i p2 = _mm_loadu_si128(cast_p(__m128i, rgba) + 2);
+    __m128i p3 = _mm_loadu_si128(cast_p(__m128i, rgba) + 3);
+
+    // gather r and g of all 16 pixels into one register each
+    __m128i byte_mask = _mm_set1_epi32(0xFF);
+
+    __m128i r01 = _mm_packs_epi32(_mm_and_si128(p0, byte_mask), _mm_and_si128(p1, byte_mask));
+    __m128i r23 = _mm_packs_epi32(_mm_and_si128(p2, byte_mask), _mm_and_si128(p3, byte_mask));
+    __m128i g01 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), byte_mask), _mm_and_si128(_mm_srli_epi32(p1, 8), byte_mask));
+    __m128i g23 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p2, 8), byte_mask), _mm_and_si128(_mm_srli_epi32(p3, 8), byte_mask));
+
+    bc4_compress_block_sse2(block,     _mm_packus_epi16(r01, r23));
+    bc4_compress_block_sse2(block + 8, _mm_packus_epi16(g01, g23));
+}
+
+#endif // BLOCK_COMPRESSION_SSE2
+
+// images
+
+// copies a 4x4 block to 16 rgba pixels, repeating the last row and column at the image border
+void gather_block(u8 *rgba, u8 const *pixels, u32 width, u32 height, u32 channel_count, u32 block_x, u32 block_y) {
+    for (u32 y = 0; y < 4; y++) {
+        u32 source_y = min(block_y * 4 + y, height - 1);
+
+        for (u32 x = 0; x < 4; x++) {
+            u32 source_x = min(block_x * 4 + x, width - 1);
+            u8 const *source = pixels + (source_y * width + source_x) * channel_count;
+            u8 *destination = rgba + (y * 4 + x) * 4;
+
+            destination[0] = source[0];
+            destination[1] = (channel_count > 1) ? source[1] : 0;
+            destination[2] = (channel_count > 2) ? source[2] : 0;
+            destination[3] = (channel_count > 3) ? source[3] : 255;
+        }
+    }
+}
+
+// writes get_compressed_image_size bytes, blocks are stored row by row from the first pixel row
+void compress_image(u8 *destination, u8 const *pixels, u32 width, u32 height, u32 channel_count, Block_Format format, bool use_simd = true) {
+    u32 block_size = get_block_size(format);
+    u32 block_count_x = (width  + 3) / 4;
+    u32 block_count_y = (height + 3) / 4;
+
+#if !defined BLOCK_COMPRESSION_SSE2
+    use_simd = false;
+#endif
+
+    u8 rgba[64];
+
+    for (u32 block_y = 0; block_y < block_count_y; block_y++) {
+        for (u32 block_x = 0; block_x < block_count_x; block_x++) {
+            gather_block(rgba, pixels, width, height, channel_count, block_x, block_y);
+
+            u8 *block = destination + (block_y * block_count_x + block_x) * block_size;
+
+#if defined BLOCK_COMPRESSION_SSE2
+            if (use_simd) {
+                if (format == Block_Format_BC1)
+                    bc1_compress_block_sse2(block, rgba);
+                else
+                    bc5_compress_block_sse2(block, rgba);
+
+                continue;
+            }
+#endif
+
+            if (format == Block_Format_BC1)
+                bc1_compress_block_scalar(block, rgba);
+            else
+                bc5_compress_block_scalar(block, rgba);
+        }
+    }
+}
+
+// decoding, only needed to measure the error
+
+void bc1_decompress_block(u8 *rgba, u8 const *block) {
+    u16 color0 = block[0] | (block[1] << 8);
+    u16 color1 = block[2] | (block[3] << 8);
+    u32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | (cast_v(u32, block[7]) << 24);
+
+    s32 palette[4][3];
+    rgb_from_565(palette[0], color0);
+    rgb_from_565(palette[1], color1);
+
+    for (u32 c = 0; c < 3; c++) {
+        if (color0 > color1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+
+    for (u32 i = 0; i < 16; i++) {
+        u32 index = (indices >> (i * 2)) & 3;
+        for (u32 c = 0; c < 3; c++)
+            rgba[i * 4 + c] = cast_v(u8, palette[index][c]);
+
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+void bc4_decompress_block(u8 *values, u32 stride, u8 const *block) {
+    s32 palette[8];
+    palette[0] = block[0];
+    palette[1] = block[1];
+
+    if (palette[0] > palette[1]) {
+        for (u32 i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7;
+    }
+    else {
+        for (u32 i = 1; i < 5; i++)
+            palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5;
+
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    u64 indices = 0;
+    for (u32 i = 0; i < 6; i++)
+        indices |= cast_v(u64, block[2 + i]) << (i * 8);
+
+    for (u32 i = 0; i < 16; i++)
+        values[i * stride] = cast_v(u8, palette[(indices >> (i * 3)) & 7]);
+}
+
+#endif // BLOCK_COMPRESSION_H
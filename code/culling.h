@@ -0,0 +1,298 @@
+#if !defined CULLING_H
+#define CULLING_H
+
+// frustum culling of bounding spheres stored as structure of arrays.
+// the kernels test 4 (sse2) or 8 (avx) spheres against all 6 planes at once
+// and write the indices of the visible spheres in order.
+// every kernel has a scalar reference, all return the same indices.
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && (_M_IX86_FP >= 2))
+#   define CULLING_SSE2
+#   include <emmintrin.h>
+#endif
+
+#if defined __AVX__
+#   define CULLING_AVX
+#   include <immintrin.h>
+#endif
+
+// the arrays are padded to a multiple of Bounding_Sphere_Lane_Count
+u32 const Bounding_Sphere_Lane_Count = 8;
+
+struct Bounding_Spheres {
+    f32 *center_x;
+    f32 *center_y;
+    f32 *center_z;
+    f32 *radius;
+    u32 count;
+};
+
+// planes point inside: dot(normal, p) + distance >= 0
+struct Frustum {
+    f32 normal_x[6];
+    f32 normal_y[6];
+    f32 normal_z[6];
+    f32 distance[6];
+};
+
+// from the rows of world_to_clip (gl clip space, z in [-w, w])
+Frustum make_frustum(mat4f world_to_clip) {
+    f32 const *m = &world_to_clip.columns[0].x;
+
+    // m[column * 4 + row]
+    f32 rows[4][4];
+    for (u32 row = 0; row < 4; row++) {
+        for (u32 column = 0; column < 4; column++)
+            rows[row][column] = m[column * 4 + row];
+    }
+
+    Frustum frustum;
+
+    for (u32 i = 0; i < 6; i++) {
+        u32 axis = i / 2;
+        f32 sign = (i % 2) ? -1.0f : 1.0f;
+
+        f32 plane[4];
+        for (u32 j = 0; j < 4; j++)
+            plane[j] = rows[3][j] + sign * rows[axis][j];
+
+        f32 length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+
+        // an infinite far plane never culls
+        if (length < 1e-6f) {
+            plane[0] = plane[1] = plane[2] = 0;
+            plane[3] = 1;
+            length = 1;
+        }
+
+        frustum.normal_x[i] = plane[0] / length;
+        frustum.normal_y[i] = plane[1] / length;
+        frustum.normal_z[i] = plane[2] / length;
+        frustum.distance[i] = plane[3] / length;
+    }
+
+    return frustum;
+}
+
+// a single sphere, for the few things culled outside of a render queue
+bool is_sphere_in_frustum(Frustum const *frustum, vec3f center, f32 radius) {
+    for (u32 plane = 0; plane < 6; plane++) {
+        f32 distance = frustum->normal_x[plane] * center.x + frustum->normal_y[plane] * center.y + frustum->normal_z[plane] * center.z + frustum->distance[plane];
+        if (distance < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+u32 cull_bounding_spheres_scalar(Frustum const *frustum, Bounding_Spheres const *spheres, u32 *visible_indices) {
+    u32 visible_count = 0;
+
+    for (u32 i = 0; i < spheres->count; i++) {
+        bool is_visible = true;
+
+        for (u32 plane = 0; plane < 6; plane++) {
+            f32 distance = frustum->normal_x[plane] * spheres->center_x[i] + frustum->normal_y[plane] * spheres->center_y[i] + frustum->normal_z[plane] * spheres->center_z[i] + frustum->distance[plane];
+            is_visible &= (distance >= -spheres->radius[i]);
+        }
+
+        visible_indices[visible_count] = i;
+        visible_count += is_visible;
+    }
+
+    return visible_count;
+}
+
+#if defined CULLING_SSE2
+
+u32 cull_bounding_spheres_sse2(Frustum const *frustum, Bounding_Spheres const *spheres, u32 *visible_indices) {
+    u32 visible_count = 0;
+
+    __m128 normal_x[6], normal_y[6], normal_z[6], distance[6];
+    for (u32 plane = 0; plane < 6; plane++) {
+        normal_x[plane] = _mm_set1_ps(frustum->normal_x[plane]);
+        normal_y[plane] = _mm_set1_ps(frustum->normal_y[plane]);
+        normal_z[plane] = _mm_set1_ps(frustum->normal_z[plane]);
+        distance[plane] = _mm_set1_ps(frustum->distance[plane]);
+    }
+
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    for (u32 i = 0; i < spheres->count; i += 4) {
+        __m128 x = _mm_loadu_ps(spheres->center_x + i);
+        __m128 y = _mm_loadu_ps(spheres->center_y + i);
+        __m128 z = _mm_loadu_ps(spheres->center_z + i);
+        __m128 negative_radius = _mm_xor_ps(_mm_loadu_ps(spheres->radius + i), sign_mask);
+
+        __m128 is_visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (u32 plane = 0; plane < 6; plane++) {
+            // same operation order as the scalar version
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normal_x[plane], x), _mm_mul_ps(normal_y[plane], y)), _mm_mul_ps(normal_z[plane], z)), distance[plane]);
+            is_visible = _mm_and_ps(is_visible, _mm_cmpge_ps(d, negative_radius));
+        }
+
+        u32 mask = _mm_movemask_ps(is_visible);
+
+        // the padding lanes past count are dropped
+        u32 lane_count = min(spheres->count - i, 4u);
+        mask &= (1u << lane_count) - 1;
+
+        for (u32 lane = 0; lane < 4; lane++) {
+            visible_indices[visible_count] = i + lane;
+            visible_count += (mask >> lane) & 1;
+        }
+    }
+
+    return visible_count;
+}
+
+#endif
+
+#if defined CULLING_AVX
+
+u32 cull_bounding_spheres_avx(Frustum const *frustum, Bounding_Spheres const *spheres, u32 *visible_indices) {
+    u32 visible_count = 0;
+
+    __m256 normal_x[6], normal_y[6], normal_z[6], distance[6];
+    for (u32 plane = 0; plane < 6; plane++) {
+        normal_x[plane] = _mm256_set1_ps(frustum->normal_x[plane]);
+        normal_y[plane] = _mm256_set1_ps(frustum->normal_y[plane]);
+        normal_z[plane] = _mm256_set1_ps(frustum->normal_z[plane]);
+        distance[plane] = _mm256_set1_ps(frustum->distance[plane]);
+    }
+
+    __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+    for (u32 i = 0; i < spheres->count; i += 8) {
+        __m256 x = _mm256_loadu_ps(spheres->center_x + i);
+        __m256 y = _mm256_loadu_ps(spheres->center_y + i);
+        __m256 z = _mm256_loadu_ps(spheres->center_z + i);
+        __m256 negative_radius = _mm256_xor_ps(_mm256_loadu_ps(spheres->radius + i), sign_mask);
+
+        __m256 is_visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (u32 plane = 0; plane < 6; plane++) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal_x[plane], x), _mm256_mul_ps(normal_y[plane], y)), _mm256_mul_ps(normal_z[plane], z)), distance[plane]);
+            is_visible = _mm256_and_ps(is_visible, _mm256_cmp_ps(d, negative_radius, _CMP_GE_OQ));
+        }
+
+        u32 mask = _mm256_movemask_ps(is_visible);
+
+        u32 lane_count = min(spheres->count - i, 8u);
+        mask &= (1u << lane_count) - 1;
+
+        for (u32 lane = 0; lane < 8; lane++) {
+            visible_indices[visible_count] = i + lane;
+            visible_count += (mask >> lane) & 1;
+        }
+    }
+
+    return visible_count;
+}
+
+#endif
+
+// visible_indices needs room for count rounded up to Bounding_Sphere_Lane_Count
+u32 cull_bounding_spheres(Frustum const *frustum, Bounding_Spheres const *spheres, u32 *visible_indices) {
+#if defined CULLING_AVX
+    return cull_bounding_spheres_avx(frustum, spheres, visible_indices);
+#elif defined CULLING_SSE2
+    return cull_bounding_spheres_sse2(frustum, spheres, visible_indices);
+#else
+    return cull_bounding_spheres_scalar(frustum, spheres, visible_indices);
+#endif
+}
+
+#if defined BENCHMARK_FRUSTUM_CULLING
+
+#include "random.h"
+#include "report.h"
+
+typedef u32 (*Cull_Function)(Frustum const *frustum, Bounding_Spheres const *spheres, u32 *visible_indices);
+
+// culls random spheres against a 90 degree view with every kernel
+// and writes throughput and whether all kernels agree to frustum_culling_benchmark.txt
+void benchmark_frustum_culling(Platform_API *platform_api, Memory_Allocator *allocator) {
+    u32 const Iteration_Count = 16;
+    u32 const Object_Counts[] = { 10000, 100000, 1000000 };
+
+    struct {
+        char const *name;
+        Cull_Function function;
+    } kernels[] = {
+        { "scalar", cull_bounding_spheres_scalar },
+#if defined CULLING_SSE2
+        { "sse2",   cull_bounding_spheres_sse2 },
+#endif
+#if defined CULLING_AVX
+        { "avx",    cull_bounding_spheres_avx },
+#endif
+    };
+
+    auto world_to_camera = make_inverse_unscaled_transform(make_transform(make_quat(VEC3_Y_AXIS, 0.3f), vec3f{ 10, 20, 30 }));
+    Frustum frustum = make_frustum(make_perspective_fov_projection(Pi32 * 0.5f, 16.0f / 9.0f) * world_to_camera);
+
+    char report_buffer[4096];
+    auto report = make_report(report_buffer, sizeof(report_buffer));
+
+    report_write(&report, "frustum culling benchmark, best of %u runs\n%-10s %-8s %10s %14s %12s %6s\n",
+                 Iteration_Count, "objects", "kernel", "visible", "MObjects/s", "ns/object", "equal");
+
+    u32 max_count = Object_Counts[ARRAY_COUNT(Object_Counts) - 1];
+    u32 padded_count = align_up(max_count, Bounding_Sphere_Lane_Count);
+
+    u8_array memory = {};
+    u8 *base = TRACK_GROW(allocator, &memory, padded_count * (4 * sizeof(f32) + 2 * sizeof(u32)));
+    defer { TRACK_FREE_ARRAY(allocator, &memory); };
+
+    Bounding_Spheres spheres;
+    spheres.center_x = cast_p(f32, base);
+    spheres.center_y = spheres.center_x + padded_count;
+    spheres.center_z = spheres.center_y + padded_count;
+    spheres.radius   = spheres.center_z + padded_count;
+
+    u32 *reference_indices = cast_p(u32, spheres.radius + padded_count);
+    u32 *visible_indices   = reference_indices + padded_count;
+
+    Random random = { 12345 };
+    for (u32 i = 0; i < padded_count; i++) {
+        f32 values[4];
+        random_units(&random, ARRAY_WITH_COUNT(values));
+
+        spheres.center_x[i] = values[0] * 1000.0f - 500.0f;
+        spheres.center_y[i] = values[1] * 1000.0f - 500.0f;
+        spheres.center_z[i] = values[2] * 1000.0f - 500.0f;
+        spheres.radius[i]   = values[3] * 4.0f + 0.5f;
+    }
+
+    for (u32 count_index = 0; count_index < ARRAY_COUNT(Object_Counts); count_index++) {
+        spheres.count = Object_Counts[count_index];
+
+        u32 reference_count = cull_bounding_spheres_scalar(&frustum, &spheres, reference_indices);
+
+        for (u32 kernel_index = 0; kernel_index < ARRAY_COUNT(kernels); kernel_index++) {
+            f64 best_seconds = 1e30;
+            u32 visible_count = 0;
+
+            for (u32 iteration = 0; iteration < Iteration_Count; iteration++) {
+                u64 start = get_clock_ticks();
+                visible_count = kernels[kernel_index].function(&frustum, &spheres, visible_indices);
+                best_seconds = min(best_seconds, get_clock_seconds(get_clock_ticks() - start));
+            }
+
+            bool is_equal = (visible_count == reference_count) && (memcmp(visible_indices, reference_indices, visible_count * sizeof(u32)) == 0);
+
+            report_write(&report, "%-10u %-8s %10u %14.1f %12.3f %6s\n",
+                         spheres.count, kernels[kernel_index].name, visible_count,
+                         spheres.count / best_seconds * 1e-6, best_seconds * 1e9 / spheres.count,
+                         is_equal ? "yes" : "NO");
+        }
+    }
+
+    write_report(&report, platform_api, S("frustum_culling_benchmark.txt"));
+}
+
+#endif // BENCHMARK_FRUSTUM_CULLING
+
+#endif // CULLING_H
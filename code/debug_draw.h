@@ -0,0 +1,233 @@
+#if !defined DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+// batched debug lines, only with DEBUG_EDITOR.
+// lines are appended to a vertex list and flushed once per frame in a single draw,
+// the vertices are streamed through the uniform ring, which already fences its frames.
+// persistent lines stay for some seconds or until cleared, so static gizmos are only pushed once.
+// without DEBUG_EDITOR all debug_draw_ calls expand to nothing, their arguments are not evaluated.
+
+#if defined DEBUG_EDITOR
+
+u32 const Debug_Draw_Max_Vertex_Count = 8192;
+u32 const Debug_Draw_Circle_Segment_Count = 24;
+
+// lifetime of lines that stay until clear_persistent_debug_draw
+f32 const Debug_Draw_Forever = -1.0f;
+
+struct Debug_Draw_Vertex {
+    vec3f position;
+    u32 color;
+};
+
+struct Debug_Draw {
+    GLuint program_object;
+    GLuint vertex_array_object;
+
+    union {
+        struct {
+            GLint World_To_Clip;
+        } uniform;
+
+        GLint uniforms[sizeof(uniform) / sizeof(GLint)];
+    };
+
+    // only collects lines while enabled, persistent lines are kept but not drawn
+    bool is_enabled;
+
+    u8_array memory;
+
+    // cleared every frame
+    Debug_Draw_Vertex *frame_vertices;
+    u32 frame_vertex_count;
+
+    // two vertices and one remaining lifetime per line
+    Debug_Draw_Vertex *persistent_vertices;
+    f32 *persistent_seconds;
+    u32 persistent_line_count;
+
+    // lines that did not fit, should stay 0
+    u32 dropped_line_count;
+};
+
+// packs like GL_UNSIGNED_BYTE x 4 reads it on little endian
+inline u32 pack_debug_color(vec4f color) {
+    u32 result = 0;
+    for (u32 i = 0; i < 4; i++) {
+        f32 channel = min(max(color.values[i], 0.0f), 1.0f);
+        result |= cast_v(u32, channel * 255.0f + 0.5f) << (i * 8);
+    }
+
+    return result;
+}
+
+bool init_debug_draw(Debug_Draw *debug_draw, Platform_API *platform_api, Memory_Allocator *allocator, Memory_Allocator *transient_allocator) {
+    *debug_draw = {};
+    debug_draw->program_object = load_program(platform_api, transient_allocator, ARRAY_WITH_COUNT(debug_draw->uniforms), S("shaders/debug_draw.shader.txt"),
+                                              EMPTY_STRING,
+                                              S("World_To_Clip"));
+    if (!debug_draw->program_object)
+        return false;
+
+    u32 vertices_size = Debug_Draw_Max_Vertex_Count * sizeof(Debug_Draw_Vertex);
+    u8 *base = TRACK_GROW(allocator, &debug_draw->memory, 2 * vertices_size + (Debug_Draw_Max_Vertex_Count / 2) * sizeof(f32));
+
+    debug_draw->frame_vertices      = cast_p(Debug_Draw_Vertex, base);
+    debug_draw->persistent_vertices = cast_p(Debug_Draw_Vertex, base + vertices_size);
+    debug_draw->persistent_seconds  = cast_p(f32, base + 2 * vertices_size);
+
+    glGenVertexArrays(1, &debug_draw->vertex_array_object);
+
+    return true;
+}
+
+// seconds 0 draws the line for this frame only
+void debug_draw_line(Debug_Draw *debug_draw, vec3f a, vec3f b, vec4f color, f32 seconds = 0.0f) {
+    if (!debug_draw->is_enabled && !seconds)
+        return;
+
+    Debug_Draw_Vertex *vertices;
+    if (seconds) {
+        if ((debug_draw->persistent_line_count + 1) * 2 > Debug_Draw_Max_Vertex_Count) {
+            debug_draw->dropped_line_count++;
+            return;
+        }
+
+        debug_draw->persistent_seconds[debug_draw->persistent_line_count] = seconds;
+        vertices = debug_draw->persistent_vertices + debug_draw->persistent_line_count * 2;
+        debug_draw->persistent_line_count++;
+    }
+    else {
+        if (debug_draw->frame_vertex_count + 2 > Debug_Draw_Max_Vertex_Count) {
+            debug_draw->dropped_line_count++;
+            return;
+        }
+
+        vertices = debug_draw->frame_vertices + debug_draw->frame_vertex_count;
+        debug_draw->frame_vertex_count += 2;
+    }
+
+    u32 packed_color = pack_debug_color(color);
+    vertices[0] = { a, packed_color };
+    vertices[1] = { b, packed_color };
+}
+
+void debug_draw_circle(Debug_Draw *debug_draw, vec3f center, f32 radius, vec3f normal, vec4f color, f32 seconds = 0.0f) {
+    if (!debug_draw->is_enabled && !seconds)
+        return;
+
+    // any axis not parallel to the normal spans the circle's plane
+    vec3f axis = (abs(normal.y) < 0.9f) ? VEC3_Y_AXIS : VEC3_X_AXIS;
+    vec3f u = normalize(cross(normal, axis)) * radius;
+    vec3f v = normalize(cross(normal, u)) * radius;
+
+    vec3f previous = center + u;
+    for (u32 i = 1; i <= Debug_Draw_Circle_Segment_Count; i++) {
+        f32 angle = 2 * Pi32 * i / Debug_Draw_Circle_Segment_Count;
+        vec3f point = center + u * cos(angle) + v * sin(angle);
+
+        debug_draw_line(debug_draw, previous, point, color, seconds);
+        previous = point;
+    }
+}
+
+void debug_draw_transform(Debug_Draw *debug_draw, mat4x3f object_to_world, f32 seconds = 0.0f) {
+    debug_draw_line(debug_draw, object_to_world.translation, object_to_world.translation + object_to_world.columns[0], vec4f{1, 0, 0, 1}, seconds);
+    debug_draw_line(debug_draw, object_to_world.translation, object_to_world.translation + object_to_world.columns[1], vec4f{0, 1, 0, 1}, seconds);
+    debug_draw_line(debug_draw, object_to_world.translation, object_to_world.translation + object_to_world.columns[2], vec4f{0, 0, 1, 1}, seconds);
+}
+
+// axis aligned, the 12 edges between min and max
+void debug_draw_box(Debug_Draw *debug_draw, vec3f min_corner, vec3f max_corner, vec4f color, f32 seconds = 0.0f) {
+    if (!debug_draw->is_enabled && !seconds)
+        return;
+
+    vec3f corners[8];
+    for (u32 i = 0; i < 8; i++)
+        corners[i] = vec3f{ (i & 1) ? max_corner.x : min_corner.x, (i & 2) ? max_corner.y : min_corner.y, (i & 4) ? max_corner.z : min_corner.z };
+
+    // corners differing in one bit share an edge
+    for (u32 i = 0; i < 8; i++) {
+        for (u32 bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit))
+                debug_draw_line(debug_draw, corners[i], corners[i | bit], color, seconds);
+        }
+    }
+}
+
+void clear_persistent_debug_draw(Debug_Draw *debug_draw) {
+    debug_draw->persistent_line_count = 0;
+}
+
+// call once per frame before pushing lines
+void begin_debug_draw_frame(Debug_Draw *debug_draw, bool is_enabled, f32 delta_seconds) {
+    debug_draw->is_enabled = is_enabled;
+    debug_draw->frame_vertex_count = 0;
+
+    // remove expired lines, keeping the order of the others
+    u32 kept_count = 0;
+    for (u32 i = 0; i < debug_draw->persistent_line_count; i++) {
+        f32 seconds = debug_draw->persistent_seconds[i];
+
+        if (seconds > 0) {
+            seconds -= delta_seconds;
+            if (seconds <= 0)
+                continue;
+        }
+
+        debug_draw->persistent_seconds[kept_count] = seconds;
+        debug_draw->persistent_vertices[kept_count * 2]     = debug_draw->persistent_vertices[i * 2];
+        debug_draw->persistent_vertices[kept_count * 2 + 1] = debug_draw->persistent_vertices[i * 2 + 1];
+        kept_count++;
+    }
+
+    debug_draw->persistent_line_count = kept_count;
+}
+
+// draws persistent and frame lines with one draw call into the current frame buffer
+void flush_debug_draw(Debug_Draw *debug_draw, Uniform_Ring *ring, mat4f world_to_clip) {
+    if (!debug_draw->is_enabled)
+        return;
+
+    u32 persistent_vertex_count = debug_draw->persistent_line_count * 2;
+    u32 vertex_count = persistent_vertex_count + debug_draw->frame_vertex_count;
+    if (!vertex_count)
+        return;
+
+    auto range = push_uniform_range(ring, vertex_count * sizeof(Debug_Draw_Vertex));
+    memcpy(range.data, debug_draw->persistent_vertices, persistent_vertex_count * sizeof(Debug_Draw_Vertex));
+    memcpy(range.data + persistent_vertex_count * sizeof(Debug_Draw_Vertex), debug_draw->frame_vertices, debug_draw->frame_vertex_count * sizeof(Debug_Draw_Vertex));
+    flush_uniform_range(ring, range);
+
+    glUseProgram(debug_draw->program_object);
+    glUniformMatrix4fv(debug_draw->uniform.World_To_Clip, 1, GL_FALSE, world_to_clip);
+
+    glBindVertexArray(debug_draw->vertex_array_object);
+    glBindBuffer(GL_ARRAY_BUFFER, range.buffer_object);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Debug_Draw_Vertex), cast_p(void, cast_v(size_t, range.offset)));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Debug_Draw_Vertex), cast_p(void, cast_v(size_t, range.offset + sizeof(vec3f))));
+
+    glDrawArrays(GL_LINES, 0, vertex_count);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#else
+
+#define init_debug_draw(...) true
+#define debug_draw_line(...)
+#define debug_draw_circle(...)
+#define debug_draw_transform(...)
+#define debug_draw_box(...)
+#define clear_persistent_debug_draw(...)
+#define begin_debug_draw_frame(...)
+#define flush_debug_draw(...)
+
+#endif // DEBUG_EDITOR
+
+#endif // DEBUG_DRAW_H
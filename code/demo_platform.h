@@ -0,0 +1,316 @@
+#if !defined DEMO_PLATFORM_H
+#define DEMO_PLATFORM_H
+
+// small platform helpers the demo needs on top of Platform_API:
+// - read only file mappings (cooked assets are used in place)
+// - page allocations any thread can make, for results of jobs
+// - a high resolution clock for load time measurements
+// - threads, semaphores and atomics for the job system
+
+#if defined WIN32
+#   if !defined WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   if !defined NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <pthread.h>
+#   include <semaphore.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <time.h>
+#endif
+
+struct Mapped_File {
+    u8_array data;
+
+#if defined WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#else
+    int file_descriptor;
+#endif
+};
+
+// platform paths need a 0-terminated copy of the string
+bool copy_to_c_string(char *buffer, u32 buffer_count, string text) {
+    if (text.count + 1 > buffer_count)
+        return false;
+
+    memcpy(buffer, text.data, text.count);
+    buffer[text.count] = '\0';
+
+    return true;
+}
+
+bool map_file(Mapped_File *mapped_file, string path) {
+    *mapped_file = {};
+
+    char c_path[512];
+    if (!copy_to_c_string(c_path, sizeof(c_path), path))
+        return false;
+
+#if defined WIN32
+    mapped_file->file_handle = CreateFileA(c_path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (mapped_file->file_handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapped_file->file_handle, &size) || (size.QuadPart == 0) || (size.QuadPart > 0xFFFFFFFF)) {
+        CloseHandle(mapped_file->file_handle);
+        return false;
+    }
+
+    mapped_file->mapping_handle = CreateFileMappingA(mapped_file->file_handle, 0, PAGE_READONLY, 0, 0, 0);
+    if (!mapped_file->mapping_handle) {
+        CloseHandle(mapped_file->file_handle);
+        return false;
+    }
+
+    mapped_file->data.data  = cast_p(u8, MapViewOfFile(mapped_file->mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    mapped_file->data.count = cast_v(u32, size.QuadPart);
+
+    if (!mapped_file->data.data) {
+        CloseHandle(mapped_file->mapping_handle);
+        CloseHandle(mapped_file->file_handle);
+        return false;
+    }
+#else
+    mapped_file->file_descriptor = open(c_path, O_RDONLY);
+    if (mapped_file->file_descriptor < 0)
+        return false;
+
+    struct stat info;
+    if ((fstat(mapped_file->file_descriptor, &info) != 0) || (info.st_size == 0) || (info.st_size > 0xFFFFFFFF)) {
+        close(mapped_file->file_descriptor);
+        return false;
+    }
+
+    void *memory = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, mapped_file->file_descriptor, 0);
+    if (memory == MAP_FAILED) {
+        close(mapped_file->file_descriptor);
+        return false;
+    }
+
+    madvise(memory, info.st_size, MADV_SEQUENTIAL);
+
+    mapped_file->data.data  = cast_p(u8, memory);
+    mapped_file->data.count = cast_v(u32, info.st_size);
+#endif
+
+    return true;
+}
+
+void unmap_file(Mapped_File *mapped_file) {
+    if (!mapped_file->data.data)
+        return;
+
+#if defined WIN32
+    UnmapViewOfFile(mapped_file->data.data);
+    CloseHandle(mapped_file->mapping_handle);
+    CloseHandle(mapped_file->file_handle);
+#else
+    munmap(mapped_file->data.data, mapped_file->data.count);
+    close(mapped_file->file_descriptor);
+#endif
+
+    *mapped_file = {};
+}
+
+// zeroed, the count is 0 if it failed
+u8_array allocate_pages(u32 size) {
+    u8_array pages = {};
+
+#if defined WIN32
+    void *memory = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!memory)
+        return pages;
+#else
+    void *memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return pages;
+#endif
+
+    pages.data  = cast_p(u8, memory);
+    pages.count = size;
+
+    return pages;
+}
+
+void free_pages(u8_array *pages) {
+    if (!pages->data)
+        return;
+
+#if defined WIN32
+    VirtualFree(pages->data, 0, MEM_RELEASE);
+#else
+    munmap(pages->data, pages->count);
+#endif
+
+    *pages = {};
+}
+
+u64 get_clock_ticks() {
+#if defined WIN32
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart;
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return cast_v(u64, time.tv_sec) * 1000000000ull + time.tv_nsec;
+#endif
+}
+
+f64 get_clock_seconds(u64 ticks) {
+#if defined WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return ticks / cast_v(f64, frequency.QuadPart);
+#else
+    return ticks * 1e-9;
+#endif
+}
+
+// threads
+
+// thread functions are declared with THREAD_FUNCTION_DEC and return 0
+
+#if defined WIN32
+typedef HANDLE Thread_Handle;
+typedef HANDLE Semaphore_Handle;
+typedef LPTHREAD_START_ROUTINE Thread_Function;
+#   define THREAD_FUNCTION_DEC(name) DWORD WINAPI name(void *data)
+#else
+typedef pthread_t Thread_Handle;
+typedef sem_t Semaphore_Handle;
+typedef void * (*Thread_Function)(void *data);
+#   define THREAD_FUNCTION_DEC(name) void * name(void *data)
+#endif
+
+bool start_thread(Thread_Handle *thread, Thread_Function function, void *data) {
+#if defined WIN32
+    *thread = CreateThread(0, 0, function, data, 0, 0);
+    return (*thread != 0);
+#else
+    return (pthread_create(thread, 0, function, data) == 0);
+#endif
+}
+
+void join_thread(Thread_Handle *thread) {
+#if defined WIN32
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+#else
+    pthread_join(*thread, 0);
+#endif
+}
+
+u32 get_processor_count() {
+#if defined WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? cast_v(u32, count) : 1;
+#endif
+}
+
+void init_semaphore(Semaphore_Handle *semaphore, u32 count = 0) {
+#if defined WIN32
+    *semaphore = CreateSemaphoreA(0, count, 0x7FFFFFFF, 0);
+#else
+    sem_init(semaphore, 0, count);
+#endif
+}
+
+void free_semaphore(Semaphore_Handle *semaphore) {
+#if defined WIN32
+    CloseHandle(*semaphore);
+#else
+    sem_destroy(semaphore);
+#endif
+}
+
+void signal_semaphore(Semaphore_Handle *semaphore, u32 count = 1) {
+#if defined WIN32
+    ReleaseSemaphore(*semaphore, count, 0);
+#else
+    for (u32 i = 0; i < count; i++)
+        sem_post(semaphore);
+#endif
+}
+
+void wait_for_semaphore(Semaphore_Handle *semaphore) {
+#if defined WIN32
+    WaitForSingleObject(*semaphore, INFINITE);
+#else
+    while (sem_wait(semaphore) != 0);
+#endif
+}
+
+// returns false instead of blocking
+bool try_wait_for_semaphore(Semaphore_Handle *semaphore) {
+#if defined WIN32
+    return (WaitForSingleObject(*semaphore, 0) == WAIT_OBJECT_0);
+#else
+    return (sem_trywait(semaphore) == 0);
+#endif
+}
+
+// atomics, all are full barriers
+
+inline u32 atomic_increment(u32 volatile *value) {
+#if defined WIN32
+    return cast_v(u32, InterlockedIncrement(cast_p(LONG volatile, value)));
+#else
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline u32 atomic_decrement(u32 volatile *value) {
+#if defined WIN32
+    return cast_v(u32, InterlockedDecrement(cast_p(LONG volatile, value)));
+#else
+    return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline u32 atomic_add(u32 volatile *value, u32 amount) {
+#if defined WIN32
+    return cast_v(u32, InterlockedExchangeAdd(cast_p(LONG volatile, value), amount)) + amount;
+#else
+    return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline u32 atomic_read(u32 volatile *value) {
+#if defined WIN32
+    return cast_v(u32, InterlockedCompareExchange(cast_p(LONG volatile, value), 0, 0));
+#else
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline void atomic_write(u32 volatile *value, u32 new_value) {
+#if defined WIN32
+    InterlockedExchange(cast_p(LONG volatile, value), new_value);
+#else
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline bool atomic_compare_exchange(u32 volatile *value, u32 expected, u32 new_value) {
+#if defined WIN32
+    return cast_v(u32, InterlockedCompareExchange(cast_p(LONG volatile, value), new_value, expected)) == expected;
+#else
+    return __atomic_compare_exchange_n(value, &expected, new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+#endif // DEMO_PLATFORM_H
@@ -0,0 +1,141 @@
+#if !defined FRAME_GOVERNOR_H
+#define FRAME_GOVERNOR_H
+
+// dynamic resolution.
+// the governor compares the frame time against a budget and steps through quality levels,
+// which lower the render resolution of the reflection probes, the shadow map and the main view, in that order.
+// render targets keep their full size, lower resolutions render into a part of them (see main.cpp).
+// a level drops once the frame stayed over budget for Frame_Governor_Drop_Seconds
+// and rises once it stayed below Frame_Governor_Raise_Ratio of the budget for Frame_Governor_Raise_Seconds.
+// after a change the measured frames still ran at the old level, so the governor waits before it judges again.
+
+#include "frame_profiler.h"
+
+struct Quality_Level {
+    // of the main view and shadow map width and height
+    f32 main_view_scale;
+    f32 shadow_map_scale;
+
+    // reflection probe faces are rendered into this mip level, each level halves their resolution
+    u32 reflection_probe_level;
+};
+
+Quality_Level const Quality_Levels[] = {
+    { 1.0f,  1.0f,  0 },
+    { 1.0f,  1.0f,  1 },
+    { 1.0f,  0.75f, 1 },
+    { 0.85f, 0.75f, 2 },
+    { 0.75f, 0.5f,  2 },
+    { 0.6f,  0.5f,  2 },
+    { 0.5f,  0.5f,  2 },
+};
+
+// leaves room for the swap and the overlay at 60hz
+f32 const Frame_Governor_Default_Budget_Milliseconds = 14.0f;
+
+f32 const Frame_Governor_Raise_Ratio   = 0.7f;
+f32 const Frame_Governor_Drop_Seconds  = 0.25f;
+f32 const Frame_Governor_Raise_Seconds = 2.0f;
+
+// covers the frames the profiler resolves late
+f32 const Frame_Governor_Settle_Seconds = 0.5f;
+
+struct Frame_Governor {
+    f32 budget_milliseconds;
+
+    // smoothed over the resolved frames
+    f32 frame_milliseconds;
+
+    // index into Quality_Levels, stays 0 while disabled
+    u32 level;
+    bool is_enabled;
+
+    f32 over_budget_seconds;
+    f32 under_budget_seconds;
+    f32 settle_seconds;
+
+    u32 resolved_frame_count;
+    u32 change_count;
+};
+
+void init_frame_governor(Frame_Governor *governor, f32 budget_milliseconds = Frame_Governor_Default_Budget_Milliseconds) {
+    *governor = {};
+    governor->budget_milliseconds = budget_milliseconds;
+    governor->is_enabled = true;
+}
+
+inline Quality_Level get_quality_level(Frame_Governor const *governor) {
+    return Quality_Levels[governor->level];
+}
+
+void set_frame_governor_enabled(Frame_Governor *governor, bool is_enabled) {
+    governor->is_enabled = is_enabled;
+    governor->level = 0;
+    governor->over_budget_seconds  = 0;
+    governor->under_budget_seconds = 0;
+    governor->settle_seconds       = Frame_Governor_Settle_Seconds;
+}
+
+// call once per frame after begin_profile_frame.
+// the frame time is the longer of the cpu and gpu durations of the outermost profile scope.
+// the cpu records a frame while the gpu draws the previous one, so the slower of both limits the frame rate,
+// which is what the budget is for. the wait for the swap is outside the scope and not counted
+void update_frame_governor(Frame_Governor *governor, Frame_Profiler const *profiler, f32 delta_seconds) {
+    governor->settle_seconds = max(governor->settle_seconds - delta_seconds, 0.0f);
+
+    if (!profiler->pass_count || (profiler->resolved_frame_count == governor->resolved_frame_count))
+        return;
+
+    governor->resolved_frame_count = profiler->resolved_frame_count;
+
+    auto frame = profiler->passes;
+    f32 milliseconds = frame->last_cpu_milliseconds;
+    if (frame->has_last_gpu_time)
+        milliseconds = max(milliseconds, frame->last_gpu_milliseconds);
+
+    if (governor->frame_milliseconds)
+        governor->frame_milliseconds += (milliseconds - governor->frame_milliseconds) * 0.2f;
+    else
+        governor->frame_milliseconds = milliseconds;
+
+    if (!governor->is_enabled || (governor->settle_seconds > 0))
+        return;
+
+    if (governor->frame_milliseconds > governor->budget_milliseconds) {
+        governor->over_budget_seconds += delta_seconds;
+        governor->under_budget_seconds = 0;
+    }
+    else if (governor->frame_milliseconds < governor->budget_milliseconds * Frame_Governor_Raise_Ratio) {
+        governor->under_budget_seconds += delta_seconds;
+        governor->over_budget_seconds = 0;
+    }
+    else {
+        governor->over_budget_seconds  = 0;
+        governor->under_budget_seconds = 0;
+    }
+
+    u32 level = governor->level;
+    if ((governor->over_budget_seconds >= Frame_Governor_Drop_Seconds) && (level + 1 < ARRAY_COUNT(Quality_Levels)))
+        level++;
+    else if ((governor->under_budget_seconds >= Frame_Governor_Raise_Seconds) && (level > 0))
+        level--;
+
+    if (level != governor->level) {
+        governor->level = level;
+        governor->over_budget_seconds  = 0;
+        governor->under_budget_seconds = 0;
+        governor->settle_seconds = Frame_Governor_Settle_Seconds;
+        governor->change_count++;
+    }
+}
+
+// width and height times scale, at least 1 pixel
+inline Pixel_Dimensions scale_dimensions(Pixel_Dimensions size, f32 scale) {
+    Pixel_Dimensions result;
+    result.width  = max(cast_v(s32, size.width * scale + 0.5f), 1);
+    result.height = max(cast_v(s32, size.height * scale + 0.5f), 1);
+
+    return result;
+}
+
+#endif // FRAME_GOVERNOR_H
@@ -0,0 +1,173 @@
+#if !defined FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+// simulation and render submission of consecutive frames overlap.
+// the main thread submits frame N from a snapshot of the game state (player, light and camera),
+// while a job simulates frame N + 1 into the other snapshot from the input of frame N.
+// end_pipeline_frame waits for that job before the main loop returns, so no job runs while the platform may reload the code,
+// and the next begin_pipeline_frame swaps the snapshots.
+// the simulation only reads its input and the previous snapshot and only writes the next one, so it needs no locks.
+// debug draw and ui are not thread safe, so what the simulation would draw is left in the snapshot.
+// input reaches the screen one frame later than without the pipeline.
+
+#include "jobs.h"
+
+struct Frame_Snapshot {
+    mat4x3f player_to_world;
+
+    f32 light_animation_time;
+    vec3f light_position;
+
+    // the frame is rendered from the camera the simulation saw
+    mat4x3f camera_to_world;
+    mat4x3f world_to_camera;
+    mat4f camera_to_clip;
+
+    // while the player turns towards its move direction
+    bool is_turning;
+    vec3f move_direction;
+    f32 turn_cos_alpha;
+};
+
+struct Simulation_Input {
+    f32 delta_seconds;
+
+    // the light keeps its position, so the shadow cache is used
+    bool pauses_light;
+
+    // false while the debug camera has the controls
+    bool moves_player;
+    bool move_forward;
+    bool move_back;
+    bool move_left;
+    bool move_right;
+
+    mat4x3f camera_to_world;
+    mat4x3f world_to_camera;
+    mat4f camera_to_clip;
+};
+
+struct Frame_Pipeline {
+    Frame_Snapshot snapshots[2];
+
+    // the main thread renders this one, the simulation job writes the other
+    u32 render_index;
+
+    Simulation_Input input;
+    bool is_simulating;
+    u32 volatile pending_count;
+};
+
+void init_frame_pipeline(Frame_Pipeline *pipeline) {
+    *pipeline = {};
+    pipeline->snapshots[0].player_to_world = MAT4X3_IDENTITY;
+}
+
+void simulate_frame(Frame_Snapshot *next, Frame_Snapshot const *previous, Simulation_Input const *input) {
+    *next = *previous;
+
+    next->camera_to_world = input->camera_to_world;
+    next->world_to_camera = input->world_to_camera;
+    next->camera_to_clip  = input->camera_to_clip;
+
+    if (!input->pauses_light)
+        next->light_animation_time = previous->light_animation_time + input->delta_seconds;
+
+    next->light_position = { 2 * sin(next->light_animation_time), 25, 5 };
+
+    next->is_turning = false;
+
+    if (!input->moves_player)
+        return;
+
+    vec3f direction = {};
+    if (input->move_forward)
+        direction.z += -1.0f;
+
+    if (input->move_back)
+        direction.z += 1.0f;
+
+    if (input->move_left)
+        direction.x += -1.0f;
+
+    if (input->move_right)
+        direction.x += 1.0f;
+
+    direction = normalize_or_zero(direction);
+
+    auto player = &next->player_to_world;
+
+    if (squared_length(direction) > 0.0f)
+    {
+        mat4x3f camera_direction_to_world;
+        camera_direction_to_world.forward = normalize(cross(input->camera_to_world.right, VEC3_Y_AXIS));
+        camera_direction_to_world.right   = normalize(cross(VEC3_Y_AXIS, camera_direction_to_world.forward));
+        camera_direction_to_world.up      = normalize(cross(input->camera_to_world.forward, input->camera_to_world.right));
+        camera_direction_to_world.translation = {};
+
+        direction = transform_direction(camera_direction_to_world, direction);
+
+        f32 cos_alpha = dot(player->forward, direction);
+
+        if (cos_alpha < 1.0) {
+            next->is_turning     = true;
+            next->move_direction = direction;
+            next->turn_cos_alpha = cos_alpha;
+
+            f32 alpha = acos(cos_alpha);
+
+            if (abs(alpha) <= input->delta_seconds * Pi32 * 2.0f) {
+                player->forward = direction;
+            }
+            else {
+                alpha = input->delta_seconds * Pi32 * 2.0f;
+
+                if (dot(player->right, direction) < 0)
+                    alpha *= -1;
+
+                auto rot = make_transform(make_quat(VEC3_Y_AXIS, alpha));
+                player->forward = normalize(transform_direction(rot, player->forward));
+            }
+            player->right = cross(player->up, player->forward);
+        }
+    }
+
+    player->translation += direction * input->delta_seconds * 20.0f;
+}
+
+void simulation_job(Job_Worker *worker, void *data) {
+    auto pipeline = cast_p(Frame_Pipeline, data);
+    simulate_frame(pipeline->snapshots + (1 - pipeline->render_index), pipeline->snapshots + pipeline->render_index, &pipeline->input);
+}
+
+// swaps to the snapshot simulated during the last frame and starts the simulation of the next frame with input.
+// the returned snapshot stays unchanged until the next call.
+// the first frame shows the initial state, it has nothing simulated ahead
+Frame_Snapshot const * begin_pipeline_frame(Frame_Pipeline *pipeline, Job_System *jobs, Simulation_Input const *input) {
+    if (pipeline->is_simulating) {
+        assert(!atomic_read(&pipeline->pending_count));
+        pipeline->render_index = 1 - pipeline->render_index;
+    }
+    else {
+        Simulation_Input first_input = *input;
+        first_input.delta_seconds = 0;
+        first_input.moves_player  = false;
+
+        Frame_Snapshot initial = pipeline->snapshots[pipeline->render_index];
+        simulate_frame(pipeline->snapshots + pipeline->render_index, &initial, &first_input);
+    }
+
+    // published to the job by push_job
+    pipeline->input = *input;
+    pipeline->is_simulating = true;
+    push_job(jobs, simulation_job, pipeline, &pipeline->pending_count);
+
+    return pipeline->snapshots + pipeline->render_index;
+}
+
+// waits for the simulation of the next frame, call before the main loop returns
+void end_pipeline_frame(Frame_Pipeline *pipeline, Job_System *jobs) {
+    wait_for_jobs(jobs, &pipeline->pending_count);
+}
+
+#endif // FRAME_PIPELINE_H
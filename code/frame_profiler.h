@@ -0,0 +1,247 @@
+#if !defined FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+// cpu and gpu time of nested scopes per frame.
+// cpu time comes from get_clock_ticks, gpu time from GL_TIMESTAMP queries at the begin and end of each scope.
+// query results are read Frame_Profiler_Latency frames later, so the profiler never waits on the gpu,
+// frames whose results are not ready by then lose their gpu times.
+// resolved frames update rolling averages per scope for the debug overlay,
+// and during a capture they are written as chrome trace events (chrome://tracing, ui.perfetto.dev).
+
+#include <stdio.h>
+
+u32 const Frame_Profiler_Latency         = 4;
+u32 const Frame_Profiler_Max_Scope_Count = 64;
+u32 const Frame_Profiler_Capture_Frame_Count = 120;
+
+// returned for scopes past Frame_Profiler_Max_Scope_Count, which are not recorded
+u32 const Profile_Scope_Invalid = 0xFFFFFFFF;
+
+struct Profile_Scope {
+    string name;
+    u32 depth;
+
+    u64 cpu_begin_ticks;
+    u64 cpu_end_ticks;
+};
+
+struct Profile_Frame {
+    Profile_Scope scopes[Frame_Profiler_Max_Scope_Count];
+    u32 scope_count;
+
+    // begin and end timestamp per scope
+    GLuint query_objects[Frame_Profiler_Max_Scope_Count * 2];
+};
+
+// rolling averages of a scope and its times in the last resolved frame, in milliseconds
+struct Profile_Pass {
+    string name;
+    u32 depth;
+    f32 cpu_milliseconds;
+    f32 gpu_milliseconds;
+
+    f32 last_cpu_milliseconds;
+    f32 last_gpu_milliseconds;
+    bool has_last_gpu_time;
+};
+
+struct Frame_Profiler {
+    Profile_Frame frames[Frame_Profiler_Latency];
+    u32 frame_index;
+    u32 frame_count;
+
+    u32 open_scopes[Frame_Profiler_Max_Scope_Count];
+    u32 open_scope_count;
+
+    // in the order of the last resolved frame
+    Profile_Pass passes[Frame_Profiler_Max_Scope_Count];
+    u32 pass_count;
+    u32 resolved_frame_count;
+
+    // cpu and gpu time at init, trace timestamps are relative to them
+    u64 base_cpu_ticks;
+    s64 base_gpu_nanoseconds;
+
+    Platform_API *platform_api;
+    Memory_Allocator *allocator;
+
+    string capture_path;
+    u8_array capture;
+    u32 capture_frame_count;
+    u32 capture_event_count;
+    bool is_capturing;
+};
+
+void init_frame_profiler(Frame_Profiler *profiler, Platform_API *platform_api, Memory_Allocator *allocator) {
+    *profiler = {};
+    profiler->platform_api = platform_api;
+    profiler->allocator    = allocator;
+
+    for (u32 i = 0; i < Frame_Profiler_Latency; i++)
+        glGenQueries(ARRAY_COUNT(profiler->frames[i].query_objects), profiler->frames[i].query_objects);
+
+    profiler->base_cpu_ticks = get_clock_ticks();
+    glGetInteger64v(GL_TIMESTAMP, &profiler->base_gpu_nanoseconds);
+}
+
+// returns the scope index for end_profile_scope
+u32 begin_profile_scope(Frame_Profiler *profiler, string name) {
+    auto frame = profiler->frames + profiler->frame_index;
+
+    if (frame->scope_count >= Frame_Profiler_Max_Scope_Count)
+        return Profile_Scope_Invalid;
+
+    u32 scope_index = frame->scope_count++;
+    auto scope = frame->scopes + scope_index;
+    scope->name  = name;
+    scope->depth = profiler->open_scope_count;
+
+    assert(profiler->open_scope_count < ARRAY_COUNT(profiler->open_scopes));
+    profiler->open_scopes[profiler->open_scope_count++] = scope_index;
+
+    glQueryCounter(frame->query_objects[scope_index * 2], GL_TIMESTAMP);
+    scope->cpu_begin_ticks = get_clock_ticks();
+
+    return scope_index;
+}
+
+void end_profile_scope(Frame_Profiler *profiler, u32 scope_index) {
+    if (scope_index == Profile_Scope_Invalid)
+        return;
+
+    auto frame = profiler->frames + profiler->frame_index;
+
+    assert(profiler->open_scope_count && (profiler->open_scopes[profiler->open_scope_count - 1] == scope_index));
+    profiler->open_scope_count--;
+
+    frame->scopes[scope_index].cpu_end_ticks = get_clock_ticks();
+    glQueryCounter(frame->query_objects[scope_index * 2 + 1], GL_TIMESTAMP);
+}
+
+#define PROFILE_SCOPE_CONCAT2(a, b) a ## b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT2(a, b)
+
+// times the rest of the enclosing block
+#define PROFILE_SCOPE(profiler, name) \
+    u32 PROFILE_SCOPE_CONCAT(profile_scope_, __LINE__) = begin_profile_scope(profiler, name); \
+    defer { end_profile_scope(profiler, PROFILE_SCOPE_CONCAT(profile_scope_, __LINE__)); }
+
+void append_trace_event(Frame_Profiler *profiler, char const *category, u32 thread_id, string name, f64 begin_microseconds, f64 duration_microseconds) {
+    char event[256];
+    s32 event_count = snprintf(event, sizeof(event), "%s{\"name\":\"%.*s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                               profiler->capture_event_count ? ",\n" : "",
+                               cast_v(s32, name.count), cast_p(char const, name.data), category, thread_id, begin_microseconds, duration_microseconds);
+
+    event_count = min(event_count, cast_v(s32, sizeof(event) - 1));
+    memcpy(TRACK_GROW(profiler->allocator, &profiler->capture, event_count), event, event_count);
+    profiler->capture_event_count++;
+}
+
+void append_trace_text(Frame_Profiler *profiler, char const *text) {
+    u32 count = cast_v(u32, strlen(text));
+    memcpy(TRACK_GROW(profiler->allocator, &profiler->capture, count), text, count);
+}
+
+// records the next Frame_Profiler_Capture_Frame_Count resolved frames, written to path when done
+void begin_profile_capture(Frame_Profiler *profiler, string path) {
+    if (profiler->is_capturing)
+        return;
+
+    profiler->capture_path = path;
+    profiler->capture_frame_count = 0;
+    profiler->capture_event_count = 0;
+    profiler->is_capturing = true;
+
+    append_trace_text(profiler, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}},\n"
+                                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}");
+
+    // the metadata events above already need a separator
+    profiler->capture_event_count = 1;
+}
+
+void resolve_profile_frame(Frame_Profiler *profiler, Profile_Frame *frame) {
+    if (!frame->scope_count)
+        return;
+
+    // the end of the outermost scope is the last query of the frame
+    GLint is_available = 0;
+    glGetQueryObjectiv(frame->query_objects[1], GL_QUERY_RESULT_AVAILABLE, &is_available);
+    bool has_gpu_times = (is_available != 0);
+
+    if (profiler->pass_count != frame->scope_count)
+        profiler->pass_count = 0;
+
+    for (u32 i = 0; i < frame->scope_count; i++) {
+        auto scope = frame->scopes + i;
+        auto pass  = profiler->passes + i;
+
+        f64 cpu_seconds = get_clock_seconds(scope->cpu_end_ticks - scope->cpu_begin_ticks);
+
+        GLuint64 gpu_begin = 0;
+        GLuint64 gpu_end   = 0;
+        if (has_gpu_times) {
+            glGetQueryObjectui64v(frame->query_objects[i * 2], GL_QUERY_RESULT, &gpu_begin);
+            glGetQueryObjectui64v(frame->query_objects[i * 2 + 1], GL_QUERY_RESULT, &gpu_end);
+        }
+
+        f32 gpu_milliseconds = (gpu_end - gpu_begin) * 1e-6f;
+
+        // the passes changed, for example after the reflection probes start or stop rendering faces
+        if ((i >= profiler->pass_count) || (pass->name.data != scope->name.data) || (pass->depth != scope->depth)) {
+            pass->name  = scope->name;
+            pass->depth = scope->depth;
+            pass->cpu_milliseconds = cpu_seconds * 1000.0f;
+            pass->gpu_milliseconds = gpu_milliseconds;
+        }
+        else {
+            pass->cpu_milliseconds += (cpu_seconds * 1000.0f - pass->cpu_milliseconds) * 0.05f;
+
+            if (has_gpu_times)
+                pass->gpu_milliseconds += (gpu_milliseconds - pass->gpu_milliseconds) * 0.05f;
+        }
+
+        pass->last_cpu_milliseconds = cpu_seconds * 1000.0f;
+        pass->last_gpu_milliseconds = gpu_milliseconds;
+        pass->has_last_gpu_time     = has_gpu_times;
+
+        if (profiler->is_capturing) {
+            f64 cpu_begin = get_clock_seconds(scope->cpu_begin_ticks - profiler->base_cpu_ticks) * 1e6;
+            append_trace_event(profiler, "cpu", 1, scope->name, cpu_begin, cpu_seconds * 1e6);
+
+            if (has_gpu_times)
+                append_trace_event(profiler, "gpu", 2, scope->name, (cast_v(s64, gpu_begin) - profiler->base_gpu_nanoseconds) * 1e-3, (gpu_end - gpu_begin) * 1e-3);
+        }
+    }
+
+    profiler->pass_count = frame->scope_count;
+    profiler->resolved_frame_count++;
+
+    if (profiler->is_capturing && (++profiler->capture_frame_count == Frame_Profiler_Capture_Frame_Count)) {
+        append_trace_text(profiler, "\n]}\n");
+        profiler->platform_api->write_entire_file(profiler->capture_path, profiler->capture);
+
+        TRACK_FREE_ARRAY(profiler->allocator, &profiler->capture);
+        profiler->is_capturing = false;
+    }
+}
+
+// resolves the frame recorded Frame_Profiler_Latency frames ago and opens the frame's outermost scope
+void begin_profile_frame(Frame_Profiler *profiler) {
+    profiler->frame_index = (profiler->frame_index + 1) % Frame_Profiler_Latency;
+    profiler->frame_count++;
+
+    auto frame = profiler->frames + profiler->frame_index;
+    resolve_profile_frame(profiler, frame);
+
+    frame->scope_count = 0;
+    profiler->open_scope_count = 0;
+
+    begin_profile_scope(profiler, S("frame"));
+}
+
+void end_profile_frame(Frame_Profiler *profiler) {
+    end_profile_scope(profiler, 0);
+}
+
+#endif // FRAME_PROFILER_H
@@ -0,0 +1,338 @@
+#if !defined JOBS_H
+#define JOBS_H
+
+// a small worker pool for loading and cpu heavy work.
+// jobs are pushed by the main thread only, round robin into one queue per worker.
+// a worker takes from its own queue first and steals from the others once it runs dry,
+// so a long job only holds up its own worker.
+// jobs pushed with a pending count form a group, wait_for_jobs returns once the group is done
+// and runs queued jobs on the waiting thread meanwhile, so it counts as one more core.
+// the done semaphore is signaled once per finished group, per finished job without one and when the last pushed job is done,
+// not per job, and the waits drain what is left of it, so a later wait does not wake for groups that are long done.
+// every worker owns a linear arena for the scratch memory of its jobs, so jobs never touch the shared allocators.
+// run_job resets it after every job, results that outlive their job go to allocate_pages.
+// arena_push only asserts, a job that learns its scratch size from its input checks arena_can_push first.
+// stop_job_threads and start_job_threads join and restart the workers while queues and arenas stay,
+// for code that may be unloaded between calls.
+
+#include "demo_platform.h"
+#include "memory_stats.h"
+
+u32 const Job_Max_Worker_Count = 16;
+
+// per worker
+u32 const Job_Queue_Capacity = 64;
+
+struct Job_Arena {
+    u8 *base;
+    u32 capacity;
+    u32 used;
+};
+
+struct Job_Worker;
+typedef void (*Job_Function)(Job_Worker *worker, void *data);
+
+struct Job {
+    Job_Function function;
+    void *data;
+
+    // of the group, 0 if the job has none
+    u32 volatile *pending_count;
+};
+
+// the main thread pushes, every thread takes with a compare exchange on taken_count
+struct Job_Queue {
+    Job jobs[Job_Queue_Capacity];
+    u32 volatile pushed_count;
+    u32 volatile taken_count;
+};
+
+struct Job_System;
+
+struct Job_Worker {
+    Job_System *system;
+    Thread_Handle thread;
+    Job_Arena arena;
+    u32 index;
+};
+
+struct Job_System {
+    Job_Queue queues[Job_Max_Worker_Count];
+    u32 next_queue;
+
+    u32 volatile pushed_count;
+    u32 volatile done_count;
+    u32 volatile is_stopping;
+
+    Semaphore_Handle work_semaphore;
+
+    // only the main thread waits on it
+    Semaphore_Handle done_semaphore;
+
+    // the last one stands for the main thread while it helps in wait_for_jobs and wait_for_all_jobs
+    Job_Worker workers[Job_Max_Worker_Count + 1];
+    u32 worker_count;
+
+    u8_array arena_memory;
+};
+
+u8 * arena_push(Job_Arena *arena, u32 size, u32 alignment = 16) {
+    u32 offset = (arena->used + alignment - 1) & ~(alignment - 1);
+    assert(offset + size <= arena->capacity);
+
+    arena->used = offset + size;
+
+    return arena->base + offset;
+}
+
+bool arena_can_push(Job_Arena const *arena, u32 size, u32 alignment = 16) {
+    u32 offset = (arena->used + alignment - 1) & ~(alignment - 1);
+    return (offset <= arena->capacity) && (size <= arena->capacity - offset);
+}
+
+#define ARENA_PUSH_ARRAY(arena, type, count) cast_p(type, arena_push(arena, sizeof(type) * (count), alignof(type)))
+
+// starts with first_queue, then steals from the following ones
+bool take_job(Job_System *system, u32 first_queue, Job *job) {
+    for (u32 i = 0; i < system->worker_count; i++) {
+        auto queue = system->queues + (first_queue + i) % system->worker_count;
+
+        while (true) {
+            u32 taken_count = atomic_read(&queue->taken_count);
+            if (taken_count == atomic_read(&queue->pushed_count))
+                break;
+
+            // the slot is not reused before taken_count moved past it, so a failed exchange only retries
+            *job = queue->jobs[taken_count % Job_Queue_Capacity];
+
+            if (atomic_compare_exchange(&queue->taken_count, taken_count, taken_count + 1))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void run_job(Job_Worker *worker, Job const *job) {
+    auto system = worker->system;
+
+    u32 arena_mark = worker->arena.used;
+    job->function(worker, job->data);
+    worker->arena.used = arena_mark;
+
+    // the counts first, so a waiter woken by the done semaphore sees them.
+    // done_count before the group, so once a group is done its jobs are counted as well.
+    // only the main thread pushes and it does not while it waits in wait_for_all_jobs,
+    // so the job that reaches pushed_count is the last one and wakes it
+    bool is_all_done = (atomic_increment(&system->done_count) == atomic_read(&system->pushed_count));
+    bool is_group_done = !job->pending_count || !atomic_decrement(job->pending_count);
+
+    if (is_group_done || is_all_done)
+        signal_semaphore(&system->done_semaphore);
+}
+
+THREAD_FUNCTION_DEC(job_worker_thread) {
+    auto worker = cast_p(Job_Worker, data);
+    auto system = worker->system;
+
+    while (true) {
+        wait_for_semaphore(&system->work_semaphore);
+
+        if (atomic_read(&system->is_stopping))
+            break;
+
+        // every push signals once, so a wake up may find its job already stolen
+        Job job;
+        while (take_job(system, worker->index, &job))
+            run_job(worker, &job);
+    }
+
+    return 0;
+}
+
+// pending_count is incremented now and decremented once the job is done, see wait_for_jobs
+void push_job(Job_System *system, Job_Function function, void *data, u32 volatile *pending_count = 0) {
+    auto queue = system->queues + system->next_queue;
+    system->next_queue = (system->next_queue + 1) % system->worker_count;
+
+    assert(queue->pushed_count - atomic_read(&queue->taken_count) < Job_Queue_Capacity);
+
+    if (pending_count)
+        atomic_increment(pending_count);
+
+    auto job = queue->jobs + (queue->pushed_count % Job_Queue_Capacity);
+    job->function      = function;
+    job->data          = data;
+    job->pending_count = pending_count;
+
+    // publishes the job before the workers are woken up
+    atomic_increment(&queue->pushed_count);
+    atomic_increment(&system->pushed_count);
+    signal_semaphore(&system->work_semaphore);
+}
+
+// blocks until one more job without a group has finished since the last call.
+// the other waits drain the semaphore, so they are not mixed with this one on a system
+void wait_for_next_done_job(Job_System *system) {
+    wait_for_semaphore(&system->done_semaphore);
+}
+
+// the conditions of all waits are checked after every wake up, so a signal of an earlier group is not needed anymore
+void drain_done_semaphore(Job_System *system) {
+    while (try_wait_for_semaphore(&system->done_semaphore));
+}
+
+// runs queued jobs of any group until the group of pending_count is done
+void wait_for_jobs(Job_System *system, u32 volatile *pending_count) {
+    auto helper = system->workers + system->worker_count;
+
+    while (atomic_read(pending_count)) {
+        Job job;
+        if (take_job(system, 0, &job))
+            run_job(helper, &job);
+        else
+            wait_for_semaphore(&system->done_semaphore);
+    }
+
+    drain_done_semaphore(system);
+}
+
+void wait_for_all_jobs(Job_System *system) {
+    auto helper = system->workers + system->worker_count;
+
+    // the job that reaches pushed_count signals
+    while (atomic_read(&system->done_count) != system->pushed_count) {
+        Job job;
+        if (take_job(system, 0, &job))
+            run_job(helper, &job);
+        else
+            wait_for_semaphore(&system->done_semaphore);
+    }
+
+    drain_done_semaphore(system);
+}
+
+// after stop_job_threads
+void start_job_threads(Job_System *system) {
+    atomic_write(&system->is_stopping, 0);
+
+    for (u32 i = 0; i < system->worker_count; i++) {
+        bool ok = start_thread(&system->workers[i].thread, job_worker_thread, system->workers + i);
+        assert(ok);
+    }
+}
+
+// runs the queued jobs on the calling thread, then joins the workers
+void stop_job_threads(Job_System *system) {
+    wait_for_all_jobs(system);
+
+    atomic_write(&system->is_stopping, 1);
+    signal_semaphore(&system->work_semaphore, system->worker_count);
+
+    for (u32 i = 0; i < system->worker_count; i++)
+        join_thread(&system->workers[i].thread);
+}
+
+// worker_count 0 uses one worker per processor
+void start_job_system(Job_System *system, Memory_Allocator *allocator, u32 worker_count, u32 arena_size_per_worker) {
+    *system = {};
+
+    if (!worker_count)
+        worker_count = get_processor_count();
+
+    system->worker_count = min(max(worker_count, 1u), Job_Max_Worker_Count);
+
+    init_semaphore(&system->work_semaphore);
+    init_semaphore(&system->done_semaphore);
+
+    u8 *arena_base = TRACK_GROW(allocator, &system->arena_memory, (system->worker_count + 1) * arena_size_per_worker);
+
+    for (u32 i = 0; i <= system->worker_count; i++) {
+        auto worker = system->workers + i;
+        worker->system = system;
+        worker->index  = i;
+        worker->arena.base     = arena_base + i * arena_size_per_worker;
+        worker->arena.capacity = arena_size_per_worker;
+    }
+
+    start_job_threads(system);
+}
+
+void stop_job_system(Job_System *system, Memory_Allocator *allocator) {
+    stop_job_threads(system);
+
+    free_semaphore(&system->work_semaphore);
+    free_semaphore(&system->done_semaphore);
+
+    TRACK_FREE_ARRAY(allocator, &system->arena_memory);
+    *system = {};
+}
+
+#if defined STRESS_TEST_JOB_SYSTEM
+
+#include "report.h"
+
+struct Job_Stress_Test {
+    u32 volatile run_count;
+};
+
+void stress_test_job(Job_Worker *worker, void *data) {
+    auto test = cast_p(Job_Stress_Test, data);
+
+    // uneven work, so jobs finish in changing orders and workers get preempted between the counts of run_job
+    u32 spin_count = ((atomic_increment(&test->run_count) * 2654435761u) >> 20) & 1023;
+    for (u32 volatile i = 0; i < spin_count; i++);
+}
+
+// restarts the workers between rounds of multi job groups, like the dll build does every main loop.
+// a lost wake up hangs in wait_for_jobs or stop_job_threads, wrong counts are written to job_system_stress_test.txt
+void stress_test_job_system(Platform_API *platform_api, Memory_Allocator *allocator) {
+    u32 const Round_Count = 2000;
+    u32 const Group_Sizes[] = { 1, 7, 20 };
+
+    Job_System system;
+    start_job_system(&system, allocator, 0, 4 << 10);
+
+    Job_Stress_Test test = {};
+    u32 expected_run_count = 0;
+    u32 wrong_round_count = 0;
+
+    u64 start = get_clock_ticks();
+
+    for (u32 round = 0; round < Round_Count; round++) {
+        u32 volatile pending_counts[ARRAY_COUNT(Group_Sizes)] = {};
+
+        for (u32 group = 0; group < ARRAY_COUNT(Group_Sizes); group++) {
+            for (u32 i = 0; i < Group_Sizes[group]; i++)
+                push_job(&system, stress_test_job, &test, pending_counts + group);
+
+            expected_run_count += Group_Sizes[group];
+        }
+
+        // one group waited for on its own, the others only through stop_job_threads
+        wait_for_jobs(&system, pending_counts + (round % ARRAY_COUNT(Group_Sizes)));
+        stop_job_threads(&system);
+
+        bool is_wrong = (atomic_read(&test.run_count) != expected_run_count);
+        for (u32 group = 0; group < ARRAY_COUNT(Group_Sizes); group++)
+            is_wrong |= (atomic_read(pending_counts + group) != 0);
+
+        wrong_round_count += is_wrong;
+
+        start_job_threads(&system);
+    }
+
+    f64 seconds = get_clock_seconds(get_clock_ticks() - start);
+
+    char report_buffer[256];
+    auto report = make_report(report_buffer, sizeof(report_buffer));
+    report_write(&report, "job system stress test, %u workers\n%u rounds, %u jobs, %.3f ms per round\n%u rounds with wrong counts\n",
+                 system.worker_count, Round_Count, expected_run_count, seconds * 1000 / Round_Count, wrong_round_count);
+    write_report(&report, platform_api, S("job_system_stress_test.txt"));
+
+    stop_job_system(&system, allocator);
+}
+
+#endif // STRESS_TEST_JOB_SYSTEM
+
+#endif // JOBS_H
@@ -0,0 +1,460 @@
+#if !defined LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+// clustered forward lighting for many point lights.
+// the main view's frustum is split into Light_Cluster_Count_X x Y screen tiles
+// and Light_Cluster_Count_Z depth slices, which grow exponentially from Light_Cluster_Near_Depth to Light_Cluster_Far_Depth.
+// every depth slice is a job: it keeps the lights overlapping its depth range
+// and tests them against the view space boxes of its clusters, 4 at a time (see assign_lights_to_cluster).
+// the lights, the light indices of every cluster and per cluster first index and count
+// go to texture buffers in the frame's part of a Uniform_Ring,
+// a fragment with CLUSTERED_LIGHTS (data/shaders/scene.shader.txt) only loops over its cluster's lights.
+// camera space looks along -z, depths are positive distances along the view direction.
+
+#include "jobs.h"
+#include "uniform_ring.h"
+#include "transform_batch.h"
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && (_M_IX86_FP >= 2))
+#   define LIGHT_CLUSTERS_SSE2
+#   include <emmintrin.h>
+#endif
+
+// mirrored in data/shaders/scene.shader.txt
+u32 const Light_Cluster_Count_X = 16;
+u32 const Light_Cluster_Count_Y = 9;
+u32 const Light_Cluster_Count_Z = 24;
+u32 const Light_Cluster_Count   = Light_Cluster_Count_X * Light_Cluster_Count_Y * Light_Cluster_Count_Z;
+
+// the first slice starts at the camera, the last one ends at the far depth
+f32 const Light_Cluster_Near_Depth = 1.0f;
+f32 const Light_Cluster_Far_Depth  = 500.0f;
+
+// indices are u16 and every slice writes to its own part of the index list,
+// lights past a full slice are dropped from its clusters
+u32 const Light_Cluster_Max_Light_Count = 4096;
+u32 const Light_Cluster_Max_Slice_Index_Count = 16384;
+
+// a light's radius ends where its attenuated color falls below this
+f32 const Light_Cluster_Cutoff = 1.0f / 256;
+
+// 2 GL_RGBA32F texels, see scene.shader.txt
+struct Point_Light_Data {
+    vec4f position_radius;
+    vec4f color_attenuation;
+};
+
+struct Light_Cluster_Slice {
+    // of the lights overlapping the slice, in view space, padded to a multiple of 4
+    f32 *x;
+    f32 *y;
+    f32 *z;
+    f32 *squared_radius;
+    u16 *light_indices;
+    u32 light_count;
+
+    u16 *cluster_indices;
+    u32 index_count;
+    u32 dropped_count;
+
+    // first index in cluster_indices and count per cluster
+    u32 *cluster_firsts;
+    u32 *cluster_counts;
+};
+
+struct Light_Clusters {
+    u8_array memory;
+
+    // of the frame, in world space
+    Point_Light_Data *lights;
+    u32 light_count;
+
+    // the lights' positions as structure of arrays, for transform_points
+    f32 *world_x;
+    f32 *world_y;
+    f32 *world_z;
+    f32 *radius;
+
+    // see build_light_clusters
+    f32 *view_x;
+    f32 *view_y;
+    f32 *view_z;
+
+    Light_Cluster_Slice slices[Light_Cluster_Count_Z];
+
+    // view space at depth 1
+    f32 tile_width;
+    f32 tile_height;
+
+    // render size of the view, for the fragments' tiles
+    Pixel_Dimensions viewport_size;
+
+    GLuint light_texture_object;
+    GLuint grid_texture_object;
+    GLuint index_texture_object;
+
+    // of the last build, for the debug overlay
+    u32 index_count;
+    u32 dropped_count;
+    u32 max_cluster_light_count;
+};
+
+struct Light_Cluster_Uniforms {
+    GLint lights;
+    GLint grid;
+    GLint indices;
+    GLint scale;
+};
+
+// ring space one frame's upload takes
+u32 get_light_clusters_upload_size() {
+    return Light_Cluster_Max_Light_Count * sizeof(Point_Light_Data) + Light_Cluster_Count * 2 * sizeof(u32) + Light_Cluster_Count_Z * Light_Cluster_Max_Slice_Index_Count * sizeof(u16);
+}
+
+void init_light_clusters(Light_Clusters *clusters, Memory_Allocator *allocator) {
+    *clusters = {};
+
+    u32 padded_count = align_up(Light_Cluster_Max_Light_Count, 4);
+    u32 clusters_per_slice = Light_Cluster_Count_X * Light_Cluster_Count_Y;
+
+    u32 lights_size = Light_Cluster_Max_Light_Count * sizeof(Point_Light_Data);
+    u32 view_size   = 7 * padded_count * sizeof(f32);
+    u32 slice_size  = padded_count * (4 * sizeof(f32) + sizeof(u16)) + Light_Cluster_Max_Slice_Index_Count * sizeof(u16) + clusters_per_slice * 2 * sizeof(u32);
+
+    u8 *base = TRACK_GROW(allocator, &clusters->memory, lights_size + view_size + Light_Cluster_Count_Z * slice_size + 16);
+    base = cast_p(u8, (cast_v(size_t, base) + 15) & ~cast_v(size_t, 15));
+
+    clusters->lights = cast_p(Point_Light_Data, base);
+    base += lights_size;
+
+    clusters->world_x = cast_p(f32, base);
+    clusters->world_y = clusters->world_x + padded_count;
+    clusters->world_z = clusters->world_y + padded_count;
+    clusters->radius  = clusters->world_z + padded_count;
+    clusters->view_x  = clusters->radius + padded_count;
+    clusters->view_y  = clusters->view_x + padded_count;
+    clusters->view_z  = clusters->view_y + padded_count;
+    base += view_size;
+
+    for (u32 i = 0; i < Light_Cluster_Count_Z; i++) {
+        auto slice = clusters->slices + i;
+
+        slice->x              = cast_p(f32, base);
+        slice->y              = slice->x + padded_count;
+        slice->z              = slice->y + padded_count;
+        slice->squared_radius = slice->z + padded_count;
+        slice->cluster_firsts = cast_p(u32, slice->squared_radius + padded_count);
+        slice->cluster_counts = slice->cluster_firsts + clusters_per_slice;
+        slice->light_indices  = cast_p(u16, slice->cluster_counts + clusters_per_slice);
+        slice->cluster_indices = slice->light_indices + padded_count;
+
+        base += slice_size;
+    }
+
+    glGenTextures(1, &clusters->light_texture_object);
+    glGenTextures(1, &clusters->grid_texture_object);
+    glGenTextures(1, &clusters->index_texture_object);
+}
+
+void begin_light_clusters(Light_Clusters *clusters) {
+    clusters->light_count = 0;
+}
+
+// radiance falls off with 1 / (1 + attenuation * squared distance)
+void add_point_light(Light_Clusters *clusters, vec3f position, vec3f color, f32 attenuation) {
+    if (clusters->light_count >= Light_Cluster_Max_Light_Count)
+        return;
+
+    f32 max_color = max(max(color.x, color.y), color.z);
+    f32 radius = sqrtf(max(max_color / Light_Cluster_Cutoff - 1.0f, 0.0f) / attenuation);
+
+    u32 index = clusters->light_count++;
+
+    auto light = clusters->lights + index;
+    light->position_radius   = make_vec4(position.x, position.y, position.z, radius);
+    light->color_attenuation = make_vec4(color.x, color.y, color.z, attenuation);
+
+    clusters->world_x[index] = position.x;
+    clusters->world_y[index] = position.y;
+    clusters->world_z[index] = position.z;
+    clusters->radius[index]  = radius;
+}
+
+f32 get_light_cluster_slice_depth(u32 slice) {
+    if (slice == 0)
+        return 0.0f;
+
+    return Light_Cluster_Near_Depth * powf(Light_Cluster_Far_Depth / Light_Cluster_Near_Depth, cast_v(f32, slice) / Light_Cluster_Count_Z);
+}
+
+// the view space box of a cluster, which holds its tile's edges at the near and far depth of its slice
+struct Light_Cluster_Box {
+    f32 min_x, min_y, min_z;
+    f32 max_x, max_y, max_z;
+};
+
+Light_Cluster_Box get_light_cluster_box(Light_Clusters const *clusters, u32 x, u32 y, f32 near_depth, f32 far_depth) {
+    // tile edges at depth 1
+    f32 left   = (x * clusters->tile_width) - Light_Cluster_Count_X * clusters->tile_width * 0.5f;
+    f32 right  = left + clusters->tile_width;
+    f32 bottom = (y * clusters->tile_height) - Light_Cluster_Count_Y * clusters->tile_height * 0.5f;
+    f32 top    = bottom + clusters->tile_height;
+
+    Light_Cluster_Box box;
+    box.min_x = min(left * near_depth, left * far_depth);
+    box.max_x = max(right * near_depth, right * far_depth);
+    box.min_y = min(bottom * near_depth, bottom * far_depth);
+    box.max_y = max(top * near_depth, top * far_depth);
+    box.min_z = near_depth;
+    box.max_z = far_depth;
+
+    return box;
+}
+
+// writes the lights of the slice that touch the box to cluster_indices, up to capacity.
+// returns how many touch it, which may be more than capacity
+u32 assign_lights_to_cluster_scalar(Light_Cluster_Slice const *slice, Light_Cluster_Box box, u16 *cluster_indices, u32 capacity) {
+    u32 count = 0;
+
+    for (u32 i = 0; i < slice->light_count; i++) {
+        f32 dx = max(box.min_x - slice->x[i], 0.0f) + max(slice->x[i] - box.max_x, 0.0f);
+        f32 dy = max(box.min_y - slice->y[i], 0.0f) + max(slice->y[i] - box.max_y, 0.0f);
+        f32 dz = max(box.min_z - slice->z[i], 0.0f) + max(slice->z[i] - box.max_z, 0.0f);
+
+        if (dx * dx + dy * dy + dz * dz <= slice->squared_radius[i]) {
+            if (count < capacity)
+                cluster_indices[count] = slice->light_indices[i];
+
+            count++;
+        }
+    }
+
+    return count;
+}
+
+#if defined LIGHT_CLUSTERS_SSE2
+
+// same operation order as the scalar version, the padding lanes have a negative squared radius
+u32 assign_lights_to_cluster_sse2(Light_Cluster_Slice const *slice, Light_Cluster_Box box, u16 *cluster_indices, u32 capacity) {
+    u32 count = 0;
+
+    __m128 min_x = _mm_set1_ps(box.min_x);
+    __m128 min_y = _mm_set1_ps(box.min_y);
+    __m128 min_z = _mm_set1_ps(box.min_z);
+    __m128 max_x = _mm_set1_ps(box.max_x);
+    __m128 max_y = _mm_set1_ps(box.max_y);
+    __m128 max_z = _mm_set1_ps(box.max_z);
+    __m128 zero  = _mm_setzero_ps();
+
+    for (u32 i = 0; i < slice->light_count; i += 4) {
+        __m128 x = _mm_load_ps(slice->x + i);
+        __m128 y = _mm_load_ps(slice->y + i);
+        __m128 z = _mm_load_ps(slice->z + i);
+
+        __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_x, x), zero), _mm_max_ps(_mm_sub_ps(x, max_x), zero));
+        __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_y, y), zero), _mm_max_ps(_mm_sub_ps(y, max_y), zero));
+        __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(min_z, z), zero), _mm_max_ps(_mm_sub_ps(z, max_z), zero));
+
+        __m128 squared_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        u32 mask = _mm_movemask_ps(_mm_cmple_ps(squared_distance, _mm_load_ps(slice->squared_radius + i)));
+
+        for (u32 lane = 0; lane < 4; lane++) {
+            if (!((mask >> lane) & 1))
+                continue;
+
+            if (count < capacity)
+                cluster_indices[count] = slice->light_indices[i + lane];
+
+            count++;
+        }
+    }
+
+    return count;
+}
+
+#endif
+
+u32 assign_lights_to_cluster(Light_Cluster_Slice const *slice, Light_Cluster_Box box, u16 *cluster_indices, u32 capacity) {
+#if defined LIGHT_CLUSTERS_SSE2
+    return assign_lights_to_cluster_sse2(slice, box, cluster_indices, capacity);
+#else
+    return assign_lights_to_cluster_scalar(slice, box, cluster_indices, capacity);
+#endif
+}
+
+// keeps the lights overlapping the slice's depth range, then fills its clusters
+void build_light_cluster_slice(Light_Clusters *clusters, u32 slice_index) {
+    auto slice = clusters->slices + slice_index;
+
+    f32 near_depth = get_light_cluster_slice_depth(slice_index);
+    f32 far_depth  = get_light_cluster_slice_depth(slice_index + 1);
+
+    slice->light_count = 0;
+    for (u32 i = 0; i < clusters->light_count; i++) {
+        f32 z = clusters->view_z[i];
+        f32 radius = clusters->radius[i];
+
+        if ((z + radius < near_depth) || (z - radius > far_depth))
+            continue;
+
+        u32 index = slice->light_count++;
+        slice->x[index] = clusters->view_x[i];
+        slice->y[index] = clusters->view_y[i];
+        slice->z[index] = z;
+        slice->squared_radius[index] = radius * radius;
+        slice->light_indices[index]  = cast_v(u16, i);
+    }
+
+    for (u32 i = slice->light_count; i < align_up(slice->light_count, 4); i++) {
+        slice->x[i] = 0;
+        slice->y[i] = 0;
+        slice->z[i] = 0;
+        slice->squared_radius[i] = -1.0f;
+        slice->light_indices[i]  = 0;
+    }
+
+    slice->index_count   = 0;
+    slice->dropped_count = 0;
+
+    for (u32 y = 0; y < Light_Cluster_Count_Y; y++) {
+        for (u32 x = 0; x < Light_Cluster_Count_X; x++) {
+            u32 cluster = y * Light_Cluster_Count_X + x;
+            auto box = get_light_cluster_box(clusters, x, y, near_depth, far_depth);
+
+            u32 capacity = Light_Cluster_Max_Slice_Index_Count - slice->index_count;
+            u32 touch_count = slice->light_count ? assign_lights_to_cluster(slice, box, slice->cluster_indices + slice->index_count, capacity) : 0;
+
+            u32 count = min(touch_count, capacity);
+            slice->dropped_count += touch_count - count;
+
+            slice->cluster_firsts[cluster] = slice->index_count;
+            slice->cluster_counts[cluster] = count;
+            slice->index_count += count;
+        }
+    }
+}
+
+struct Light_Cluster_Slice_Job {
+    Light_Clusters *clusters;
+    u32 slice_index;
+};
+
+void light_cluster_slice_job(Job_Worker *worker, void *data) {
+    auto job = cast_p(Light_Cluster_Slice_Job, data);
+    build_light_cluster_slice(job->clusters, job->slice_index);
+}
+
+// assigns the lights added since begin_light_clusters to the clusters of the view,
+// camera_to_clip has to be a symmetric perspective projection
+void build_light_clusters(Light_Clusters *clusters, mat4x3f world_to_camera, mat4f camera_to_clip, Pixel_Dimensions viewport_size, Job_System *jobs = 0) {
+    clusters->viewport_size = viewport_size;
+
+    clusters->tile_width  = 2.0f / (camera_to_clip.columns[0].x * Light_Cluster_Count_X);
+    clusters->tile_height = 2.0f / (camera_to_clip.columns[1].y * Light_Cluster_Count_Y);
+
+    // with its z row negated, the view space z of a light is its depth
+    mat4x3f world_to_depth = world_to_camera;
+    for (u32 i = 0; i < 4; i++)
+        world_to_depth.columns[i].z = -world_to_depth.columns[i].z;
+
+    Point_Array world_positions = { clusters->world_x, clusters->world_y, clusters->world_z, clusters->light_count };
+    Point_Array view_positions  = { clusters->view_x, clusters->view_y, clusters->view_z };
+    transform_points(&view_positions, world_to_depth, &world_positions);
+
+    if (!jobs || (jobs->worker_count < 2)) {
+        for (u32 i = 0; i < Light_Cluster_Count_Z; i++)
+            build_light_cluster_slice(clusters, i);
+    }
+    else {
+        u32 volatile pending_count = 0;
+
+        Light_Cluster_Slice_Job slice_jobs[Light_Cluster_Count_Z];
+        for (u32 i = 0; i < Light_Cluster_Count_Z; i++) {
+            slice_jobs[i] = { clusters, i };
+            push_job(jobs, light_cluster_slice_job, slice_jobs + i, &pending_count);
+        }
+
+        wait_for_jobs(jobs, &pending_count);
+    }
+
+    clusters->index_count   = 0;
+    clusters->dropped_count = 0;
+    clusters->max_cluster_light_count = 0;
+
+    for (u32 i = 0; i < Light_Cluster_Count_Z; i++) {
+        auto slice = clusters->slices + i;
+        clusters->index_count   += slice->index_count;
+        clusters->dropped_count += slice->dropped_count;
+
+        for (u32 j = 0; j < Light_Cluster_Count_X * Light_Cluster_Count_Y; j++)
+            clusters->max_cluster_light_count = max(clusters->max_cluster_light_count, slice->cluster_counts[j]);
+    }
+}
+
+// never an empty range, texture buffers need storage
+Uniform_Range push_texture_buffer_range(Uniform_Ring *ring, u32 size, GLuint texture_object, GLenum internal_format) {
+    auto range = push_uniform_range(ring, max(size, 16u));
+
+    glBindTexture(GL_TEXTURE_BUFFER, texture_object);
+    glTexBufferRange(GL_TEXTURE_BUFFER, internal_format, range.buffer_object, range.offset, range.size);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    return range;
+}
+
+// writes lights, per cluster first index and count and the index list to the frame's part of ring
+void upload_light_clusters(Light_Clusters *clusters, Uniform_Ring *ring) {
+    auto light_range = push_texture_buffer_range(ring, clusters->light_count * sizeof(Point_Light_Data), clusters->light_texture_object, GL_RGBA32F);
+    memcpy(light_range.data, clusters->lights, clusters->light_count * sizeof(Point_Light_Data));
+    flush_uniform_range(ring, light_range);
+
+    auto grid_range  = push_texture_buffer_range(ring, Light_Cluster_Count * 2 * sizeof(u32), clusters->grid_texture_object, GL_RG32UI);
+    auto index_range = push_texture_buffer_range(ring, clusters->index_count * sizeof(u16), clusters->index_texture_object, GL_R16UI);
+
+    auto grid    = cast_p(u32, grid_range.data);
+    auto indices = cast_p(u16, index_range.data);
+
+    // slices are concatenated in order, so cluster firsts move by the indices of the slices before
+    u32 clusters_per_slice = Light_Cluster_Count_X * Light_Cluster_Count_Y;
+    u32 index_offset = 0;
+
+    for (u32 i = 0; i < Light_Cluster_Count_Z; i++) {
+        auto slice = clusters->slices + i;
+
+        for (u32 j = 0; j < clusters_per_slice; j++) {
+            grid[(i * clusters_per_slice + j) * 2 + 0] = index_offset + slice->cluster_firsts[j];
+            grid[(i * clusters_per_slice + j) * 2 + 1] = slice->cluster_counts[j];
+        }
+
+        memcpy(indices + index_offset, slice->cluster_indices, slice->index_count * sizeof(u16));
+        index_offset += slice->index_count;
+    }
+
+    flush_uniform_range(ring, grid_range);
+    flush_uniform_range(ring, index_range);
+}
+
+// the program with CLUSTERED_LIGHTS has to be bound, uses 3 texture slots from texture_slot on, returns the next free one
+u32 bind_light_clusters(Light_Clusters const *clusters, Light_Cluster_Uniforms const *uniforms, u32 texture_slot) {
+    auto viewport_size = clusters->viewport_size;
+
+    glUniform1i(uniforms->lights, texture_slot);
+    glActiveTexture(GL_TEXTURE0 + texture_slot++);
+    glBindTexture(GL_TEXTURE_BUFFER, clusters->light_texture_object);
+
+    glUniform1i(uniforms->grid, texture_slot);
+    glActiveTexture(GL_TEXTURE0 + texture_slot++);
+    glBindTexture(GL_TEXTURE_BUFFER, clusters->grid_texture_object);
+
+    glUniform1i(uniforms->indices, texture_slot);
+    glActiveTexture(GL_TEXTURE0 + texture_slot++);
+    glBindTexture(GL_TEXTURE_BUFFER, clusters->index_texture_object);
+
+    // slice = log(depth) * z + w, the first slice also takes everything closer than the near depth
+    f32 depth_scale = Light_Cluster_Count_Z / logf(Light_Cluster_Far_Depth / Light_Cluster_Near_Depth);
+    glUniform4f(uniforms->scale, cast_v(f32, Light_Cluster_Count_X) / viewport_size.width, cast_v(f32, Light_Cluster_Count_Y) / viewport_size.height, depth_scale, -logf(Light_Cluster_Near_Depth) * depth_scale);
+
+    return texture_slot;
+}
+
+#endif // LIGHT_CLUSTERS_H
@@ -1,44 +1,243 @@
 
 #define DEBUG_EDITOR
 
+// tallies allocations per call site and allocator for the debug overlay and memory_stats.txt, written with M and on quit
+#if defined DEBUG
+#define MEMORY_STATS
+#endif
+
+// writes mesh_load_benchmark.txt at startup, comparing make_mesh on the .glm files with loading the cooked .glmb files
+// and the acmr and vertex size of the cook optimizations
+//#define BENCHMARK_MESH_LOADING
+
+// writes texture_compression_benchmark.txt at startup, comparing the scalar and simd block compressors
+//#define BENCHMARK_TEXTURE_COMPRESSION
+
+// writes frustum_culling_benchmark.txt at startup, comparing the scalar and simd culling kernels
+//#define BENCHMARK_FRUSTUM_CULLING
+
+// writes transform_batch_benchmark.txt at startup, comparing the scalar and simd transform kernels at several batch sizes
+//#define BENCHMARK_TRANSFORM_BATCH
+
+// pauses the light and writes shadow_cache_benchmark.txt after a few hundred frames with the shadow cache,
+// comparing the gpu time and depths of the cached shadow map with one of all casters drawn directly
+//#define BENCHMARK_SHADOW_CACHE
+
+// adds this many static cubes to the scene
+//#define STRESS_TEST_SCENE_OBJECT_COUNT 100000
+
+// adds this many small point lights circling over the ground,
+// lit through the light clusters of the main view, probe faces only see the lights of Scene_Lighting
+//#define STRESS_TEST_POINT_LIGHT_COUNT 1024
+
+// writes job_system_stress_test.txt at startup, restarting the workers between rounds of job groups
+//#define STRESS_TEST_JOB_SYSTEM
+
+// the win32 platform loads the demo as a dll and reloads it when it changes (live code editing, see build.bat).
+// no thread may run its code while it is unloaded, so the workers of frame_jobs only run during application_main_loop there
+#if defined WIN32_EXPORT
+#define FRAME_JOBS_PER_MAIN_LOOP
+#endif
+
 #include <default.h>
 #include <mesh.h>
 #include <tga.h>
 
+#include "jobs.h"
+#include "frame_pipeline.h"
+#include "mesh_cook.h"
+#include "texture_load.h"
+#include "spherical_harmonics.h"
+#include "reflection_probes.h"
+#include "shader_program.h"
+#include "uniform_ring.h"
+#include "frame_profiler.h"
+#include "frame_governor.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "light_clusters.h"
+#include "debug_draw.h"
+#include "random.h"
+
 u32 const Main_Window_ID = 0;
 
+// data/shaders/scene.shader.txt
+struct Scene_Shader {
+    GLuint program_object;
+    
+    union {
+        struct {
+            struct {
+                GLint map;
+                GLint world_to_shadow;
+            } Shadow;
+            
+            struct {
+                GLint map;
+                GLint level_of_detail_count;
+                GLint irradiance;
+            } Environment;
+            
+            GLint Reflection_Probe_Maps;
+            GLint Reflection_Probe_Level_Of_Detail_Count;
+            Light_Cluster_Uniforms Light_Clusters;
+            GLint View_Index;
+            GLint First_Layer;
+            Instance_Uniforms Instancing;
+        } uniform;
+        
+        GLint uniforms[sizeof(uniform) / sizeof(GLint)];
+    };
+};
+
+// reflection probe faces and the main view
+u32 const Default_Camera_Upload_Count = Reflection_Probe_Max_Faces_Per_Frame + 1;
+
+// one face of a reflection probe, or all 6 in one layered pass
+struct Reflection_Probe_Pass {
+    u32 first_face;
+    u32 face_count;
+    u32 view;
+};
+
+// allowed lod error in pixels relative to the main view, shadows are filtered and reflections are blurred by roughness
+f32 const Shadow_Lod_Bias          = 2.0f;
+f32 const Reflection_Probe_Lod_Bias = 4.0f;
+
+u32 const Reflection_Probe_Resolution = 256;
+
+// config.bin and the memory stats site orders of one frame (overlay, M and quit), with room to spare
+u32 const Frame_Arena_Size = 4 << 10;
+
+#if defined BENCHMARK_SHADOW_CACHE
+u32 const Shadow_Cache_Benchmark_Frame_Count = 300;
+
+// of the shadow map read back at once
+u32 const Shadow_Cache_Benchmark_Row_Count = 16;
+#endif
+
 struct State : Default_State {
-    Mesh pawn_mesh;
-    Mesh sphere_mesh;
-    Mesh cube_mesh;
-    //Mesh inverse_cube_mesh;
-    Mesh clip_background_quad_mesh;
+    Gpu_Mesh pawn_mesh;
+    Gpu_Mesh sphere_mesh;
+    Gpu_Mesh cube_mesh;
+    //Gpu_Mesh inverse_cube_mesh;
+    Gpu_Mesh clip_background_quad_mesh;
+    
+    Scene scene;
+    u32 pawn_object;
+    
+    // sized for every scene object, refilled every frame
+    Render_Queue render_queue;
+    
+    // for per frame work, like large scene transform updates, culling and the simulation of the next frame
+    Job_System frame_jobs;
+    
+    // temporaries of one frame, all freed at the start of the next application_main_loop
+    Job_Arena frame_arena;
+    u8_array frame_arena_memory;
+    bool memory_stats_key_was_active;
+    
+    // player, light and camera, the frame is rendered from the snapshot of the pipeline
+    Frame_Pipeline pipeline;
+    
     Frame_Buffer shadow_map_frame_buffer;
     
+    // depth of the static casters, copied to the shadow map every frame before the dynamic casters are drawn.
+    // while the light, a static item or the shadow map resolution changes every frame, all casters are drawn directly
+    // and the cache is only rendered again once they stayed the same for a frame.
+    // the light moves every frame unless P pauses it
+    struct {
+        Frame_Buffer frame_buffer;
+        mat4f world_to_shadow;
+        u32 static_version;
+        bool is_valid;
+        u32 update_count;
+        u32 hit_count;
+        
+        // the part of the shadow map it was rendered to, see Quality_Level
+        Pixel_Dimensions size;
+    } shadow_cache;
+    bool is_light_paused;
+    bool light_pause_key_was_active;
+    
+#if defined BENCHMARK_SHADOW_CACHE
+    // all casters drawn directly, see benchmark_shadow_cache
+    struct {
+        Frame_Buffer frame_buffer;
+        GLuint query_objects[3];
+        u8_array depth_rows[2];
+        
+        u32 frame_count;
+        Pixel_Dimensions size;
+        u64 cached_gpu_nanoseconds;
+        u64 direct_gpu_nanoseconds;
+        u64 different_texel_count;
+        f32 max_depth_difference;
+    } shadow_cache_benchmark;
+#endif
+    
+    // point lights of the main view
+    Light_Clusters light_clusters;
+    
+    // the main view blends them, their faces reflect the sky
+    Reflection_Probes reflection_probes;
+    bool probe_budget_key_was_active;
+    bool probe_layering_key_was_active;
+    
+    // drawn from the render queue, the main view's scene shader has REFLECTION_PROBES if cube map arrays are supported
+    Scene_Shader scene_shader;
+    Scene_Shader probe_scene_shader;
+    Scene_Shader depth_scene_shader;
+    
+    // whole reflection probes, 0 without layered rendering
+    Scene_Shader layered_probe_scene_shader;
+    
     struct {
         GLuint program_object;
         
         union {
             struct {
-                struct {
-                    GLint world_to_environment;
-                    GLint map;
-                } Environment;
-                
-                GLint Object_To_World;
+                GLint skybox_cube_map;
+                GLint First_Layer;
             } uniform;
             
             GLint uniforms[sizeof(uniform) / sizeof(GLint)];
         };
-        
-        vec3f position;
-        u32 level_of_detail_count;
-    } environment_probe;
+    } layered_sky_shader;
     
+    Instance_Buffer instance_buffer;
+    
+    // camera and lighting blocks, instances and visible lists of the frame
+    Uniform_Ring uniform_ring;
+    
+    // mooselib's blocks, -1 if its binding points were not found and its own buffers are used.
+    // the camera block layout is mooselib's, so upload_camera_block writes one of these buffers per upload,
+    // which are recycled with the frames of the uniform ring
+    s32 default_lighting_binding;
+    s32 default_camera_binding;
+    GLuint default_camera_buffer_objects[Uniform_Ring_Frame_Count][Default_Camera_Upload_Count];
+    
+    // per pass timings for the debug overlay, T writes a chrome trace of the next frames
+    Frame_Profiler profiler;
+    bool trace_key_was_active;
+    
+    // lowers render resolutions to stay in the frame budget, G toggles it
+    Frame_Governor governor;
+    bool governor_key_was_active;
+    
+    // the main view renders into its lower left part while the governor lowers its resolution,
+    // then it is scaled up to the window
     struct {
-        GLuint texture_object;
-        Pixel_Dimensions resolution;
-    } environment_map;
+        GLuint frame_buffer_object;
+        GLuint color_render_buffer_object;
+        GLuint depth_render_buffer_object;
+        Pixel_Dimensions size;
+    } main_view_target;
+    
+#if defined DEBUG_EDITOR
+    // lines are only collected while state->debug.is_active
+    Debug_Draw debug_draw;
+#endif
     
     struct {
         GLuint program_object;
@@ -54,18 +253,157 @@ struct State : Default_State {
         };
     } skybox_shader;
     
-    Frame_Buffer render_to_texture_frame_buffer;
-    
     GLuint skybox_cube_map_object;
     
-    struct {
-        mat4x3 to_world;
-    } player;
+    // mip levels below the first, for rough reflections of the sky
+    u32 skybox_level_of_detail_count;
+    
+    // diffuse lighting of the probe faces and where no probe reaches
+    SH_Irradiance skybox_irradiance;
 };
 
+bool load_scene_shader(Scene_Shader *shader, Platform_API *platform_api, Memory_Allocator *allocator, string defines, bool with_geometry_shader = false) {
+    shader->program_object = load_program(platform_api, allocator, ARRAY_WITH_COUNT(shader->uniforms), S("shaders/scene.shader.txt"),
+                                          defines,
+                                          S("Shadow.map, Shadow.world_to_shadow, Environment.map, Environment.level_of_detail_count, Environment.irradiance, Reflection_Probe_Maps, Reflection_Probe_Level_Of_Detail_Count, Light_Clusters.lights, Light_Clusters.grid, Light_Clusters.indices, Light_Clusters.scale, View_Index, First_Layer, Instances, Visible_Instances, Instance_Offset"),
+                                          with_geometry_shader);
+    
+    return (shader->program_object != 0);
+}
+
+// a 3 x 3 grid over the ground, the corners are static.
+// boxes overlap by their blend distance, so neighbours cross fade and no sky shows between them
+void build_reflection_probes(State *state) {
+    f32 cell_size = 100.0f / 3;
+    f32 blend_distance = 4.0f;
+    
+    for (u32 z = 0; z < 3; z++) {
+        for (u32 x = 0; x < 3; x++) {
+            vec3f center = vec3f{ (x - 1.0f) * cell_size, 3.0f, (z - 1.0f) * cell_size };
+            f32 half_width = cell_size * 0.5f + blend_distance;
+            
+            vec3f influence_min = vec3f{ center.x - half_width, -1.0f, center.z - half_width };
+            vec3f influence_max = vec3f{ center.x + half_width, 20.0f, center.z + half_width };
+            
+            u32 flags = ((x != 1) && (z != 1)) ? Reflection_Probe_Static : 0;
+            add_reflection_probe(&state->reflection_probes, center, influence_min, influence_max, blend_distance, flags);
+        }
+    }
+}
+
+#if defined STRESS_TEST_POINT_LIGHT_COUNT
+
+// small colored lights circling over the ground
+void add_demo_point_lights(Light_Clusters *clusters, f32 animation_time) {
+    Random random = { 54321 };
+    
+    for (u32 i = 0; i < STRESS_TEST_POINT_LIGHT_COUNT; i++) {
+        f32 values[5];
+        random_units(&random, ARRAY_WITH_COUNT(values));
+        
+        f32 angle = animation_time * (0.5f + values[3]) + values[4] * 2 * Pi32;
+        vec3f position = vec3f{ values[0] * 96.0f - 48.0f, 0.5f + values[1] * 2.0f, values[2] * 96.0f - 48.0f } + vec3f{ cos(angle), 0, sin(angle) } * 2.0f;
+        
+        f32 hue = values[4] * 2 * Pi32;
+        vec3f color = vec3f{ 0.5f + 0.5f * cos(hue), 0.5f + 0.5f * cos(hue - Pi32 * 2 / 3), 0.5f + 0.5f * cos(hue - Pi32 * 4 / 3) } * 0.5f;
+        
+        add_point_light(clusters, position, color, 4.0f);
+    }
+}
+
+#endif
+
+// the player, the ground and a ring of cubes and spheres around the origin
+void build_scene(State *state) {
+    u32 object_count = 2 + 1 + 16;
+    
+#if defined STRESS_TEST_SCENE_OBJECT_COUNT
+    object_count += STRESS_TEST_SCENE_OBJECT_COUNT;
+#endif
+    
+    auto scene = &state->scene;
+    init_scene(scene, &state->persistent_memory.allocator, object_count, 32);
+    
+    auto gold = vec4f{1.00, 0.71, 0.29, 1.00 };
+    
+    // pawn
+    {
+        Draw_Material material;
+        material.gloss          = 0.3f;
+        material.metalness      = 0.0f;
+        material.specular_color = vec4f{1, 1, 0, 1};
+        material.diffuse_color  = vec4f{1, 0, 0, 1};
+        
+        state->pawn_object = add_scene_object(scene, Scene_No_Parent, &state->pawn_mesh, add_scene_material(scene, material), MAT4X3_IDENTITY);
+    }
+    
+    // ground
+    {
+        Draw_Material material;
+        material.gloss          = 0.3f;
+        material.metalness      = 0.0f;
+        material.specular_color = gold;
+        material.diffuse_color  = vec4f{0.4, 0.4, 0.4, 1};
+        
+        f32 thickness = 0.2f;
+        
+        add_scene_object(scene, Scene_No_Parent, &state->cube_mesh, add_scene_material(scene, material), make_transform(QUAT_IDENTITY, vec3f{0, -thickness * 0.5f, 0}, { 100, thickness, 100 }), Scene_Object_Static);
+    }
+    
+    // cubes and spheres, children of the ring
+    {
+        u32 ring = add_scene_object(scene, Scene_No_Parent, 0, 0, MAT4X3_IDENTITY, Scene_Object_Static);
+        
+        u32 n = 16;
+        for (u32 i = 0; i < n; i++) {
+            f32 diffuse = i / cast_v(f32, n);
+            
+            Draw_Material material;
+            material.gloss          = 0.3f;
+            material.metalness      = 1.0f;
+            material.specular_color = gold;
+            material.diffuse_color  = make_vec4_scale(diffuse);
+            
+            auto t = make_transform(make_quat(VEC3_Y_AXIS, 2 * Pi32 * i / n), {});
+            t.translation = transform_point(t, vec3f{ 10, 3, 0 });
+            
+            Gpu_Mesh *mesh = ((i % 2) == 0) ? &state->cube_mesh : &state->sphere_mesh;
+            add_scene_object(scene, ring, mesh, add_scene_material(scene, material), t, Scene_Object_Static);
+        }
+    }
+    
+#if defined STRESS_TEST_SCENE_OBJECT_COUNT
+    {
+        u32 material_indices[8];
+        for (u32 i = 0; i < ARRAY_COUNT(material_indices); i++) {
+            Draw_Material material;
+            material.gloss          = i / 8.0f;
+            material.metalness      = (i % 2) ? 1.0f : 0.0f;
+            material.specular_color = gold;
+            material.diffuse_color  = vec4f{ (i & 1) ? 0.8f : 0.2f, (i & 2) ? 0.8f : 0.2f, (i & 4) ? 0.8f : 0.2f, 1 };
+            
+            material_indices[i] = add_scene_material(scene, material);
+        }
+        
+        Random random = { 12345 };
+        for (u32 i = 0; i < STRESS_TEST_SCENE_OBJECT_COUNT; i++) {
+            f32 values[3];
+            random_units(&random, ARRAY_WITH_COUNT(values));
+            
+            auto t = make_transform(make_quat(VEC3_Y_AXIS, values[2] * 2 * Pi32), vec3f{ values[0] * 1000.0f - 500.0f, 0.25f, values[1] * 1000.0f - 500.0f }, { 0.5f, 0.5f, 0.5f });
+            add_scene_object(scene, Scene_No_Parent, &state->cube_mesh, material_indices[i % ARRAY_COUNT(material_indices)], t, Scene_Object_Static);
+        }
+    }
+#endif
+}
+
 APP_INIT_DEC(application_init) {
     State *state;
     DEFAULT_STATE_INIT(State, state, platform_api);
+    
+    register_memory_allocator(&global_memory_stats, &state->persistent_memory.allocator, S("persistent"));
+    register_memory_allocator(&global_memory_stats, &state->transient_memory.allocator, S("transient"));
+    
     load_default_shader(state, platform_api, true, true);
     
     // load config:
@@ -73,9 +411,9 @@ APP_INIT_DEC(application_init) {
     // - camera state
     // - debug camera state
     {
-        auto config = platform_api->read_entire_file(S("config.bin"), &state->transient_memory.allocator);
+        auto config = TRACK_READ_ENTIRE_FILE(platform_api, S("config.bin"), &state->transient_memory.allocator);
         if (config.count) {
-            defer { free_array(&state->transient_memory.allocator, &config); };
+            defer { TRACK_FREE_ARRAY(&state->transient_memory.allocator, &config); };
             
             auto it = config;
             state->main_window_area = *next_item(&it, Pixel_Rectangle);
@@ -87,121 +425,386 @@ APP_INIT_DEC(application_init) {
         }
     }
     
-    // load assets
-    {
-        auto source = platform_api->read_entire_file(S("meshs/chibi.glm"), &state->transient_memory.allocator);
-        defer { free_array(&state->transient_memory.allocator, &source); };
-        
-        state->pawn_mesh = make_mesh(source, &state->persistent_memory.allocator);
-    }
+    // start loading assets
+    // file reads, .glm cooking and tga decoding run on the workers,
+    // the main thread sets up gl state meanwhile and uploads the results as they come in
     
-    {
-        auto source = platform_api->read_entire_file(S("meshs/sphere.glm"), &state->transient_memory.allocator);
-        defer { free_array(&state->transient_memory.allocator, &source); };
-        
-        state->sphere_mesh = make_mesh(source, &state->persistent_memory.allocator);
+    // the cooked skybox is a single mapping, only without it the 6 tga faces are decoded
+    Mapped_File skybox_cooked_file;
+    bool has_cooked_skybox = map_cooked_cube_map(&skybox_cooked_file, S("Daylight Box_Pieces/Daylight Box.glcm"));
+    
+    // 4 meshs and maybe 6 skybox faces
+    u32 asset_job_count = 4 + (has_cooked_skybox ? 0 : 6);
+    
+    // the arenas are scratch of .glm cooking, the decoded images and cooked meshs go to pages of their own
+    Job_System jobs;
+    start_job_system(&jobs, &state->transient_memory.allocator, min(get_processor_count(), asset_job_count), 2 << 20);
+    
+    string glm_paths[] = {
+        S("meshs/chibi.glm"),
+        S("meshs/sphere.glm"),
+        S("meshs/cube.glm"),
+        S("meshs/clip_background_quad.glm"),
+    };
+    
+    // cooked .glmb files are mapped and uploaded directly, the text .glm is only parsed if they are missing
+    string cooked_paths[] = {
+        S("meshs/chibi.glmb"),
+        S("meshs/sphere.glmb"),
+        S("meshs/cube.glmb"),
+        S("meshs/clip_background_quad.glmb"),
+    };
+    
+    Gpu_Mesh *meshs[] = {
+        &state->pawn_mesh,
+        &state->sphere_mesh,
+        &state->cube_mesh,
+        &state->clip_background_quad_mesh,
+    };
+    
+    // the sky shaders read the quad's positions as clip space, so they stay floats
+    u32 cook_flags[] = {
+        Mesh_Cook_Default_Flags,
+        Mesh_Cook_Default_Flags,
+        Mesh_Cook_Default_Flags,
+        Mesh_Cook_Optimize_Order,
+    };
+    
+    Mesh_Load_Job mesh_jobs[ARRAY_COUNT(meshs)];
+    for (u32 i = 0; i < ARRAY_COUNT(meshs); i++)
+        push_mesh_load_job(&jobs, mesh_jobs + i, glm_paths[i], cooked_paths[i], cook_flags[i]);
+    
+    // in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+    string skybox_paths[] = {
+        S("Daylight Box_Pieces/Daylight Box_Right.tga"),
+        S("Daylight Box_Pieces/Daylight Box_Left.tga"),
+        S("Daylight Box_Pieces/Daylight Box_Top.tga"),
+        S("Daylight Box_Pieces/Daylight Box_Bottom.tga"),
+        S("Daylight Box_Pieces/Daylight Box_Front.tga"),
+        S("Daylight Box_Pieces/Daylight Box_Back.tga"),
+    };
+    
+    Tga_Load_Job skybox_jobs[ARRAY_COUNT(skybox_paths)] = {};
+    if (!has_cooked_skybox) {
+        for (u32 i = 0; i < ARRAY_COUNT(skybox_paths); i++)
+            push_tga_load_job(&jobs, skybox_jobs + i, skybox_paths[i]);
     }
     
+    init_frame_pipeline(&state->pipeline);
+    
+    state->shadow_map_frame_buffer = make_frame_buffer({ 1024, 1024 });
+    state->shadow_cache.frame_buffer = make_frame_buffer(state->shadow_map_frame_buffer.size);
+    
+#if defined BENCHMARK_SHADOW_CACHE
     {
-        auto source = platform_api->read_entire_file(S("meshs/cube.glm"), &state->transient_memory.allocator);
-        defer { free_array(&state->transient_memory.allocator, &source); };
+        auto benchmark = &state->shadow_cache_benchmark;
+        benchmark->frame_buffer = make_frame_buffer(state->shadow_map_frame_buffer.size);
+        glGenQueries(ARRAY_COUNT(benchmark->query_objects), benchmark->query_objects);
         
-        state->cube_mesh = make_mesh(source, &state->persistent_memory.allocator);
+        for (u32 i = 0; i < ARRAY_COUNT(benchmark->depth_rows); i++)
+            TRACK_GROW(&state->persistent_memory.allocator, benchmark->depth_rows + i, state->shadow_map_frame_buffer.size.width * Shadow_Cache_Benchmark_Row_Count * sizeof(f32));
+        
+        // a moving light never uses the cache
+        state->is_light_paused = true;
     }
+#endif
+    
+    init_frame_profiler(&state->profiler, platform_api, &state->persistent_memory.allocator);
+    init_frame_governor(&state->governor);
     
     {
-        auto source = platform_api->read_entire_file(S("meshs/clip_background_quad.glm"), &state->transient_memory.allocator);
-        defer { free_array(&state->transient_memory.allocator, &source); };
+        bool ok = init_debug_draw(&state->debug_draw, platform_api, &state->persistent_memory.allocator, &state->transient_memory.allocator);
+        assert(ok);
         
-        state->clip_background_quad_mesh = make_mesh(source, &state->persistent_memory.allocator);
+        // origin
+        debug_draw_transform(&state->debug_draw, MAT4X3_IDENTITY, Debug_Draw_Forever);
     }
     
-    state->player.to_world = MAT4X3_IDENTITY;
+    state->frame_arena.base     = TRACK_GROW(&state->persistent_memory.allocator, &state->frame_arena_memory, Frame_Arena_Size);
+    state->frame_arena.capacity = Frame_Arena_Size;
     
-    state->shadow_map_frame_buffer = make_frame_buffer({ 1024, 1024 });
+    build_scene(state);
+    init_render_queue(&state->render_queue, &state->persistent_memory.allocator, max(state->scene.capacity, 1u));
+    init_light_clusters(&state->light_clusters, &state->persistent_memory.allocator);
+    start_job_system(&state->frame_jobs, &state->persistent_memory.allocator, 0, 64 << 10);
     
+    // instances and visible lists of every scene object, the light clusters, plus the camera and lighting blocks
     {
-        glGenTextures(1, &state->environment_map.texture_object);
+        u32 frame_capacity = state->scene.capacity * (sizeof(Instance_Data) + Render_Queue_Max_View_Count * sizeof(u32)) + get_light_clusters_upload_size() + (64 << 10);
         
-        glBindTexture(GL_TEXTURE_CUBE_MAP, state->environment_map.texture_object);
+#if defined DEBUG_EDITOR
+        frame_capacity += 2 * Debug_Draw_Max_Vertex_Count * sizeof(Debug_Draw_Vertex);
+#endif
         
-        state->environment_map.resolution = { 1024, 1024 };
-        for (u32 i = 0; i < 6; i++)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 
-                         0, GL_RGB, state->environment_map.resolution.width, state->environment_map.resolution.height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
-        }
-        
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);  
+        bool ok = init_uniform_ring(&state->uniform_ring, &state->persistent_memory.allocator, frame_capacity);
+        assert(ok);
         
-        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        state->default_lighting_binding = find_uniform_buffer_binding(state->light_uniform_buffer_object);
+        state->default_camera_binding   = find_uniform_buffer_binding(state->camera_uniform_buffer_object);
         
-        s32 level_base;
-        glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, &level_base);
+        if (state->default_camera_binding >= 0) {
+            GLint camera_block_size;
+            glBindBuffer(GL_UNIFORM_BUFFER, state->camera_uniform_buffer_object);
+            glGetBufferParameteriv(GL_UNIFORM_BUFFER, GL_BUFFER_SIZE, &camera_block_size);
+            
+            glGenBuffers(Uniform_Ring_Frame_Count * Default_Camera_Upload_Count, state->default_camera_buffer_objects[0]);
+            for (u32 i = 0; i < Uniform_Ring_Frame_Count * Default_Camera_Upload_Count; i++) {
+                glBindBuffer(GL_UNIFORM_BUFFER, state->default_camera_buffer_objects[0][i]);
+                glBufferData(GL_UNIFORM_BUFFER, camera_block_size, 0, GL_DYNAMIC_DRAW);
+            }
+            
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+    }
+    
+    bool has_reflection_probes = init_reflection_probes(&state->reflection_probes, Reflection_Probe_Resolution);
+    if (has_reflection_probes)
+        build_reflection_probes(state);
+    
+    load_scene_shader(&state->probe_scene_shader, platform_api, &state->transient_memory.allocator, EMPTY_STRING);
+    load_scene_shader(&state->depth_scene_shader, platform_api, &state->transient_memory.allocator, S("#define DEPTH_ONLY\n"));
+    assert(state->probe_scene_shader.program_object && state->depth_scene_shader.program_object);
+    
+    // whole probes render in one layered pass if the frame buffer and both geometry shaders work
+    if (state->reflection_probes.layered_frame_buffer_object) {
+        load_scene_shader(&state->layered_probe_scene_shader, platform_api, &state->transient_memory.allocator, S("#define LAYERED\n"), true);
         
-        s32 level_max;
-        glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, &level_max);
+        state->layered_sky_shader.program_object = load_program(platform_api, &state->transient_memory.allocator, ARRAY_WITH_COUNT(state->layered_sky_shader.uniforms), S("shaders/layered_sky.shader.txt"),
+                                                                EMPTY_STRING,
+                                                                S("skybox_cube_map, First_Layer"),
+                                                                true);
         
-        u32 max_size = state->environment_map.resolution.width;
-        u32 p = level_base + (bit_count_of(max_size) - 1);
-        u32 q = min(p, level_max);
-        state->environment_probe.level_of_detail_count = q;
+        state->reflection_probes.use_layered_rendering = state->layered_probe_scene_shader.program_object && state->layered_sky_shader.program_object;
     }
     
-    state->render_to_texture_frame_buffer = make_frame_buffer(state->environment_map.resolution, false);
+    if (has_reflection_probes)
+        load_scene_shader(&state->scene_shader, platform_api, &state->transient_memory.allocator, S("#define REFLECTION_PROBES\n#define CLUSTERED_LIGHTS\n"));
+    
+    // without cube map arrays everything reflects the sky
+    if (!state->scene_shader.program_object)
+        load_scene_shader(&state->scene_shader, platform_api, &state->transient_memory.allocator, S("#define CLUSTERED_LIGHTS\n"));
     
-    state->environment_probe.program_object = load_shader(state, platform_api, ARRAY_WITH_COUNT(state->environment_probe.uniforms), S(MOOSELIB_PATH "/shaders/debug_environment_map.shader.txt"),
-                                                          EMPTY_STRING,
-                                                          S("Environment.world_to_environment, Environment.map, Object_To_World"));
-    state->environment_probe.position = vec3f{0, 10, 0};
+    if (!state->scene_shader.program_object)
+        state->scene_shader = state->probe_scene_shader;
+    
+    init_instance_buffer(&state->instance_buffer);
     
     state->skybox_shader.program_object = load_shader(state, platform_api, ARRAY_WITH_COUNT(state->skybox_shader.uniforms), S(MOOSELIB_PATH "/shaders/skybox.shader.txt"),
                                                       EMPTY_STRING,
                                                       S("skybox_cube_map, Object_To_World, Clip_To_World"));
     
+    // upload assets
     {
         glGenTextures(1, &state->skybox_cube_map_object);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, state->skybox_cube_map_object);
         
-        Texture skybox_side;
-        bool ok = tga_load_texture(&skybox_side, S("Daylight Box_Pieces/Daylight Box_Right.tga"), platform_api->read_entire_file, &state->transient_memory.allocator, state->skybox_cube_map_object, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X);
-        assert(ok);
-        
-        ok = tga_load_texture(&skybox_side, S("Daylight Box_Pieces/Daylight Box_Left.tga"), platform_api->read_entire_file, &state->transient_memory.allocator, state->skybox_cube_map_object, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_NEGATIVE_X);
-        assert(ok);
+        if (has_cooked_skybox) {
+            bool ok = upload_cooked_cube_map(state->skybox_cube_map_object, skybox_cooked_file.data, &state->skybox_irradiance);
+            assert(ok);
+            
+            unmap_file(&skybox_cooked_file);
+        }
         
-        ok = tga_load_texture(&skybox_side, S("Daylight Box_Pieces/Daylight Box_Top.tga"), platform_api->read_entire_file, &state->transient_memory.allocator, state->skybox_cube_map_object, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_Y);
-        assert(ok);
+        bool is_mesh_done[ARRAY_COUNT(mesh_jobs)] = {};
+        u32 done_count = 0;
         
-        ok = tga_load_texture(&skybox_side, S("Daylight Box_Pieces/Daylight Box_Bottom.tga"), platform_api->read_entire_file, &state->transient_memory.allocator, state->skybox_cube_map_object, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y);
-        assert(ok);
+        while (done_count < asset_job_count) {
+            wait_for_next_done_job(&jobs);
+            
+            done_count = 0;
+            
+            for (u32 i = 0; i < ARRAY_COUNT(mesh_jobs); i++) {
+                if (!is_mesh_done[i] && atomic_read(&mesh_jobs[i].is_done)) {
+                    bool ok = finish_mesh_load_job(meshs[i], mesh_jobs + i, platform_api);
+                    assert(ok);
+                    
+                    is_mesh_done[i] = true;
+                }
+                
+                done_count += is_mesh_done[i];
+            }
+            
+            // skybox faces are uploaded together, once all are decoded
+            if (!has_cooked_skybox) {
+                for (u32 i = 0; i < ARRAY_COUNT(skybox_jobs); i++)
+                    done_count += atomic_read(&skybox_jobs[i].is_done);
+            }
+        }
         
-        ok = tga_load_texture(&skybox_side, S("Daylight Box_Pieces/Daylight Box_Front.tga"), platform_api->read_entire_file, &state->transient_memory.allocator, state->skybox_cube_map_object, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_Z);
-        assert(ok);
+        // authoring fallback: cook the decoded faces with their mip chain, debug builds write the .glcm
+        if (!has_cooked_skybox) {
+            Decoded_Image faces[6];
+            bool all_faces_decoded = true;
+            for (u32 i = 0; i < 6; i++) {
+                faces[i] = skybox_jobs[i].image;
+                all_faces_decoded &= skybox_jobs[i].ok;
+            }
+            
+            u8_array cooked = {};
+            if (all_faces_decoded)
+                cooked = cook_cube_map(faces, &state->transient_memory.allocator, has_gl_extension("GL_EXT_texture_compression_s3tc"));
+            
+            for (u32 i = 0; i < ARRAY_COUNT(skybox_jobs); i++)
+                free_tga_load_job(skybox_jobs + i);
+            
+            if (cooked.count) {
+                bool ok = upload_cooked_cube_map(state->skybox_cube_map_object, cooked, &state->skybox_irradiance);
+                assert(ok);
+                
+#if defined DEBUG
+                platform_api->write_entire_file(S("Daylight Box_Pieces/Daylight Box.glcm"), cooked);
+#endif
+                
+                TRACK_FREE_ARRAY(&state->transient_memory.allocator, &cooked);
+            }
+            else {
+                // fall back to mooselib's loader for faces tga_decode does not handle
+                for (u32 i = 0; i < 6; i++) {
+                    Texture skybox_side;
+                    bool ok = tga_load_texture(&skybox_side, skybox_paths[i], platform_api->read_entire_file, &state->transient_memory.allocator, state->skybox_cube_map_object, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+                    assert(ok);
+                }
+                
+                glBindTexture(GL_TEXTURE_CUBE_MAP, state->skybox_cube_map_object);
+                glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+                
+                // no cpu copy of the faces, read back a small level once
+                u32 level = 0;
+                s32 size;
+                glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &size);
+                
+                while (cast_v(u32, size) > Cooked_Cube_Map_Irradiance_Max_Size) {
+                    size = max(size / 2, 1);
+                    level++;
+                }
+                
+                bool ok = read_cube_map_irradiance(&state->skybox_irradiance, state->skybox_cube_map_object, level, size);
+                assert(ok);
+            }
+        }
         
-        ok = tga_load_texture(&skybox_side, S("Daylight Box_Pieces/Daylight Box_Back.tga"), platform_api->read_entire_file, &state->transient_memory.allocator, state->skybox_cube_map_object, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
-        assert(ok);
+        stop_job_system(&jobs, &state->transient_memory.allocator);
         
+        glBindTexture(GL_TEXTURE_CUBE_MAP, state->skybox_cube_map_object);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
         
-        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        // the cooked mip chain may end above 1x1, see GL_TEXTURE_MAX_LEVEL in upload_cooked_cube_map
+        {
+            s32 size, max_level;
+            glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &size);
+            glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, &max_level);
+            
+            state->skybox_level_of_detail_count = min(bit_count_of(size) - 1, cast_v(u32, max_level));
+        }
+        
+        // until the first read back of each probe arrives
+        for (u32 i = 0; i < state->reflection_probes.count; i++)
+            state->reflection_probes.probes[i].irradiance = state->skybox_irradiance;
     }
     
+#if defined BENCHMARK_MESH_LOADING
+    benchmark_mesh_loading(platform_api, &state->transient_memory.allocator, glm_paths, cooked_paths, cook_flags, ARRAY_COUNT(glm_paths));
+#endif
+    
+#if defined BENCHMARK_TEXTURE_COMPRESSION
+    benchmark_texture_compression(platform_api, &state->transient_memory.allocator, skybox_paths, ARRAY_COUNT(skybox_paths));
+#endif
+    
+#if defined BENCHMARK_FRUSTUM_CULLING
+    benchmark_frustum_culling(platform_api, &state->transient_memory.allocator);
+#endif
+    
+#if defined BENCHMARK_TRANSFORM_BATCH
+    benchmark_transform_batch(platform_api, &state->transient_memory.allocator);
+#endif
+    
+#if defined STRESS_TEST_JOB_SYSTEM
+    stress_test_job_system(platform_api, &state->transient_memory.allocator);
+#endif
+    
+#if defined FRAME_JOBS_PER_MAIN_LOOP
+    stop_job_threads(&state->frame_jobs);
+#endif
+    
     return state;
 }
 
-void draw_object_to_world_transform(mat4x3 object_to_world) {
-    draw_line(object_to_world.translation, object_to_world.translation + object_to_world.columns[0], make_rgba32(1, 0, 0));
-    draw_line(object_to_world.translation, object_to_world.translation + object_to_world.columns[1], make_rgba32(0, 1, 0));
-    draw_line(object_to_world.translation, object_to_world.translation + object_to_world.columns[2], make_rgba32(0, 0, 1));
+// face_index in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+mat4x3f make_world_to_cube_face(vec3f eye, u32 face_index) {
+    mat4x3f world_to_probe;
+    
+    switch (GL_TEXTURE_CUBE_MAP_POSITIVE_X + face_index) {
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_X: {
+            world_to_probe = make_look_at({}, VEC3_X_AXIS, -VEC3_Y_AXIS);
+        } break;
+        
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_X: {
+            world_to_probe = make_look_at({}, -VEC3_X_AXIS, -VEC3_Y_AXIS);
+        } break;
+        
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_Y: {
+            world_to_probe = make_look_at({}, VEC3_Y_AXIS, VEC3_Z_AXIS);
+        } break;
+        
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y: {
+            world_to_probe = make_look_at({}, -VEC3_Y_AXIS, -VEC3_Z_AXIS);
+        } break;
+        
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_Z: {
+            world_to_probe = make_look_at({}, VEC3_Z_AXIS, -VEC3_Y_AXIS);
+        } break;
+        
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z: {
+            world_to_probe = make_look_at({}, -VEC3_Z_AXIS, -VEC3_Y_AXIS);
+        } break;
+    }
+    
+    world_to_probe.translation = eye;
+    
+    return make_inverse_unscaled_transform(world_to_probe);
+}
+
+// shadow map lookups, when the shadow map was rendered to its lower left part of scale times its size.
+// the texture coordinate x * 0.5 + 0.5 becomes (x * 0.5 + 0.5) * scale, and like that for y
+mat4f scale_shadow_lookup(mat4f world_to_shadow, f32 scale) {
+    for (u32 i = 0; i < 4; i++) {
+        auto column = world_to_shadow.columns + i;
+        column->x = column->x * scale + column->w * (scale - 1.0f);
+        column->y = column->y * scale + column->w * (scale - 1.0f);
+    }
+    
+    return world_to_shadow;
+}
+
+// allocated on first use and again when the window size changes
+void update_main_view_target(State *state, Pixel_Dimensions size) {
+    auto target = &state->main_view_target;
+    
+    if (target->frame_buffer_object && (target->size.width == size.width) && (target->size.height == size.height))
+        return;
+    
+    if (!target->frame_buffer_object) {
+        glGenFramebuffers(1, &target->frame_buffer_object);
+        glGenRenderbuffers(1, &target->color_render_buffer_object);
+        glGenRenderbuffers(1, &target->depth_render_buffer_object);
+    }
+    
+    glBindRenderbuffer(GL_RENDERBUFFER, target->color_render_buffer_object);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.width, size.height);
+    
+    glBindRenderbuffer(GL_RENDERBUFFER, target->depth_render_buffer_object);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.width, size.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, target->frame_buffer_object);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->color_render_buffer_object);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depth_render_buffer_object);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    target->size = size;
 }
 
 void render_sky(State *state, mat4x3f world_to_camera, mat4f camera_to_clip) {
@@ -216,119 +819,167 @@ void render_sky(State *state, mat4x3f world_to_camera, mat4f camera_to_clip) {
     
     glUniformMatrix4fv(state->skybox_shader.uniform.Clip_To_World, 1, GL_FALSE, clip_to_world);
     
-    draw(state->clip_background_quad_mesh.batch, 0);
+    draw(state->clip_background_quad_mesh);
 }
 
-void render_scene(State *state, bool override_program = false, GLint object_to_world_uniform = -1) {
+// into the 6 layers from first_layer on, with the matrices of the bound Scene_Camera block
+void render_layered_sky(State *state, u32 first_layer) {
+    glUseProgram(state->layered_sky_shader.program_object);
     
-    if (!override_program) {
-        glUseProgram(state->default_shader.program_object);
-        object_to_world_uniform = state->default_shader.uniform.Object_To_World;
-        
-        u32 texture_slot = 0;
-        glUniform1i(state->default_shader.uniform.Material.diffuse_map, texture_slot);
-        glActiveTexture(GL_TEXTURE0 + texture_slot++);
-        glBindTexture(GL_TEXTURE_2D, state->blank_texture.object);
-        
-        glUniform1i(state->default_shader.uniform.Material.normal_map, texture_slot);
-        glActiveTexture(GL_TEXTURE0 + texture_slot++);
-        glBindTexture(GL_TEXTURE_2D, state->blank_normal_map.object);
-        
-        glUniform1i(state->default_shader.uniform.Shadow.map, texture_slot);
-        glActiveTexture(GL_TEXTURE0 + texture_slot++);
-        glBindTexture(GL_TEXTURE_2D, state->shadow_map_frame_buffer.depth_attachment_texture_object);
-        
-        glUniform1i(state->default_shader.uniform.Environment.map, texture_slot);
-        glActiveTexture(GL_TEXTURE0 + texture_slot++);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, state->environment_map.texture_object);
-        
-        glUniform1i(state->default_shader.uniform.Environment.level_of_detail_count, state->environment_probe.level_of_detail_count);
+    glUniform1i(state->layered_sky_shader.uniform.skybox_cube_map, 0);
+    glUniform1i(state->layered_sky_shader.uniform.First_Layer, first_layer);
+    
+    glActiveTexture(GL_TEXTURE0 + 0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, state->skybox_cube_map_object);
+    
+    draw(state->clip_background_quad_mesh);
+}
+
+// upload_index < Default_Camera_Upload_Count, each is used once per frame
+void upload_default_camera(State *state, u32 upload_index, mat4x3f world_to_camera, mat4f camera_to_clip, vec3f camera_world_position) {
+    if (state->default_camera_binding < 0) {
+        upload_camera_block(state->camera_uniform_buffer_object, world_to_camera, camera_to_clip, camera_world_position);
+        return;
     }
     
-    // render pawn
-    {
-        if (!override_program) {
-            glUniform1f(state->default_shader.uniform.Material.gloss, 0.3f);
-            glUniform1f(state->default_shader.uniform.Material.metalness, 0.0f);
-            glUniform4fv(state->default_shader.uniform.Material.specular_color, 1, vec4f{1, 1, 0, 1});
-            glUniform4fv(state->default_shader.uniform.Material.diffuse_color, 1, vec4f{1, 0, 0, 1});
-        }
+    GLuint buffer_object = state->default_camera_buffer_objects[state->uniform_ring.frame_index][upload_index];
+    upload_camera_block(buffer_object, world_to_camera, camera_to_clip, camera_world_position);
+    glBindBufferBase(GL_UNIFORM_BUFFER, state->default_camera_binding, buffer_object);
+}
+
+void render_queue_with_scene_shader(State *state, Render_Queue const *queue, u32 view_index, Scene_Shader const *shader, Uniform_Range camera, mat4f world_to_shadow, GLuint environment_map_object, SH_Irradiance const *irradiance) {
+    bind_uniform_range(camera, Scene_Camera_Binding);
+    
+    glUseProgram(shader->program_object);
+    
+    glUniformMatrix4fv(shader->uniform.Shadow.world_to_shadow, 1, GL_FALSE, world_to_shadow);
+    glUniform1i(shader->uniform.View_Index, 0);
+    
+    u32 texture_slot = 0;
+    glUniform1i(shader->uniform.Shadow.map, texture_slot);
+    glActiveTexture(GL_TEXTURE0 + texture_slot++);
+    glBindTexture(GL_TEXTURE_2D, state->shadow_map_frame_buffer.depth_attachment_texture_object);
+    
+    glUniform1i(shader->uniform.Environment.map, texture_slot);
+    glActiveTexture(GL_TEXTURE0 + texture_slot++);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, environment_map_object);
+    
+    glUniform1i(shader->uniform.Environment.level_of_detail_count, state->skybox_level_of_detail_count);
+    glUniform4fv(shader->uniform.Environment.irradiance, SH_Coefficient_Count, irradiance->coefficients[0].values);
+    
+    // only REFLECTION_PROBES has them, the probes themselves are in the Scene_Reflection_Probes block
+    if (shader->uniform.Reflection_Probe_Maps >= 0) {
+        glUniform1i(shader->uniform.Reflection_Probe_Maps, texture_slot);
+        glActiveTexture(GL_TEXTURE0 + texture_slot++);
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, state->reflection_probes.texture_object);
         
-        glUniformMatrix4x3fv(object_to_world_uniform, 1, GL_FALSE, state->player.to_world);
-        draw(state->pawn_mesh.batch, 0);
+        glUniform1i(shader->uniform.Reflection_Probe_Level_Of_Detail_Count, get_reflection_probe_level_count(&state->reflection_probes));
     }
     
-    auto gold = vec4f{1.00, 0.71, 0.29, 1.00 };
+    if (shader->uniform.Light_Clusters.grid >= 0)
+        texture_slot = bind_light_clusters(&state->light_clusters, &shader->uniform.Light_Clusters, texture_slot);
     
-    // render ground
-    {
-        if (!override_program) {
-            glUniform1f(state->default_shader.uniform.Material.gloss, 0.3f);
-            glUniform1f(state->default_shader.uniform.Material.metalness, 0.0f);
-            glUniform4fv(state->default_shader.uniform.Material.specular_color, 1, gold);
-            glUniform4fv(state->default_shader.uniform.Material.diffuse_color, 1, vec4f{0.4, 0.4, 0.4, 1});
-        }
+    draw_render_queue(queue, view_index, &state->instance_buffer, &shader->uniform.Instancing, texture_slot);
+}
+
+#if defined BENCHMARK_SHADOW_CACHE
+
+#include "report.h"
+
+// called right after the shadow map was built from the cache, with the depth shader and the shadow camera still bound.
+// draws the cached path again for its time, then all casters into the benchmark frame buffer, and compares that with the shadow map
+void benchmark_shadow_cache(State *state, Platform_API *platform_api, Render_Queue const *queue, u32 dynamic_view, u32 all_view, Pixel_Dimensions shadow_size, s32 copy_width, s32 copy_height) {
+    auto benchmark = &state->shadow_cache_benchmark;
+    if (benchmark->frame_count >= Shadow_Cache_Benchmark_Frame_Count)
+        return;
+    
+    auto target = &benchmark->frame_buffer;
+    
+    glQueryCounter(benchmark->query_objects[0], GL_TIMESTAMP);
+    
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, state->shadow_cache.frame_buffer.object);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->object);
+    glBlitFramebuffer(0, 0, copy_width, copy_height, 0, 0, copy_width, copy_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, target->object);
+    glViewport(0, 0, shadow_size.width, shadow_size.height);
+    draw_render_queue(queue, dynamic_view, &state->instance_buffer, &state->depth_scene_shader.uniform.Instancing, 0);
+    
+    glQueryCounter(benchmark->query_objects[1], GL_TIMESTAMP);
+    
+    bind_frame_buffer(*target);
+    glViewport(0, 0, shadow_size.width, shadow_size.height);
+    draw_render_queue(queue, all_view, &state->instance_buffer, &state->depth_scene_shader.uniform.Instancing, 0);
+    
+    glQueryCounter(benchmark->query_objects[2], GL_TIMESTAMP);
+    
+    // waits for the gpu, the benchmark frames are slower
+    GLuint64 nanoseconds[ARRAY_COUNT(benchmark->query_objects)];
+    for (u32 i = 0; i < ARRAY_COUNT(benchmark->query_objects); i++)
+        glGetQueryObjectui64v(benchmark->query_objects[i], GL_QUERY_RESULT, nanoseconds + i);
+    
+    benchmark->cached_gpu_nanoseconds += nanoseconds[1] - nanoseconds[0];
+    benchmark->direct_gpu_nanoseconds += nanoseconds[2] - nanoseconds[1];
+    
+    // a few rows at a time, the shadow map of the frame against all casters drawn directly
+    auto cached_depths = cast_p(f32, benchmark->depth_rows[0].data);
+    auto direct_depths = cast_p(f32, benchmark->depth_rows[1].data);
+    
+    for (s32 y = 0; y < shadow_size.height; y += Shadow_Cache_Benchmark_Row_Count) {
+        s32 row_count = min(shadow_size.height - y, cast_v(s32, Shadow_Cache_Benchmark_Row_Count));
         
-        f32 thickness = 0.2f;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, state->shadow_map_frame_buffer.object);
+        glReadPixels(0, y, shadow_size.width, row_count, GL_DEPTH_COMPONENT, GL_FLOAT, cached_depths);
         
-        glUniformMatrix4x3fv(object_to_world_uniform, 1, GL_FALSE, make_transform(QUAT_IDENTITY, vec3f{0, -thickness * 0.5f, 0}, { 100, thickness, 100 }));
-        draw(state->cube_mesh.batch, 0);
-    }
-    
-    // render cubes and spheres
-    {
-        u32 n = 16;
-        for (u32 i = 0; i < n; i++) {
-            if (!override_program) {
-                glUniform1f(state->default_shader.uniform.Material.gloss, 0.3f);
-                glUniform1f(state->default_shader.uniform.Material.metalness, 1.0f);
-                glUniform4fv(state->default_shader.uniform.Material.specular_color, 1, gold);
-                
-                f32 diffuse = i / cast_v(f32, n);
-                
-                glUniform4fv(state->default_shader.uniform.Material.diffuse_color, 1, make_vec4_scale(diffuse));
-            }
-            
-            auto t = make_transform(make_quat(VEC3_Y_AXIS, 2 * Pi32 * i / n), {});
-            t.translation = transform_point(t, vec3f{ 10, 3, 0 });
-            
-            glUniformMatrix4x3fv(object_to_world_uniform, 1, GL_FALSE, t);
-            
-            if ((i % 2) == 0)
-                draw(state->cube_mesh.batch, 0);
-            else
-                draw(state->sphere_mesh.batch, 0);
-        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target->object);
+        glReadPixels(0, y, shadow_size.width, row_count, GL_DEPTH_COMPONENT, GL_FLOAT, direct_depths);
         
-    }
-    
-    // render environment probe for debugging
-    {
-        if (!override_program) {
-            glUseProgram(state->environment_probe.program_object);
-            
-            glUniformMatrix4x3fv(state->environment_probe.uniform.Environment.world_to_environment, 1, GL_FALSE, make_inverse_unscaled_transform(make_transform(QUAT_IDENTITY, state->environment_probe.position)));
+        for (s32 i = 0; i < shadow_size.width * row_count; i++) {
+            f32 difference = abs(cached_depths[i] - direct_depths[i]);
             
-            glUniform1i(state->environment_probe.uniform.Environment.map, 0);
-            glActiveTexture(GL_TEXTURE0 + 0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, state->environment_map.texture_object);
-            
-            object_to_world_uniform = state->environment_probe.uniform.Object_To_World;
-            
-            glUniformMatrix4x3fv(object_to_world_uniform, 1, GL_FALSE, make_transform(QUAT_IDENTITY, state->environment_probe.position));
-            
-            draw(state->sphere_mesh.batch, 0);
+            if (difference > 0.0f) {
+                benchmark->different_texel_count++;
+                benchmark->max_depth_difference = max(benchmark->max_depth_difference, difference);
+            }
         }
     }
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    benchmark->size = shadow_size;
+    benchmark->frame_count++;
+    
+    if (benchmark->frame_count < Shadow_Cache_Benchmark_Frame_Count)
+        return;
+    
+    char report_buffer[512];
+    auto report = make_report(report_buffer, sizeof(report_buffer));
+    report_write(&report, "shadow cache benchmark, light paused, %u frames with the cache, last at %dx%d\n", benchmark->frame_count, benchmark->size.width, benchmark->size.height);
+    report_write(&report, "cached, copy and dynamic casters: %.3f ms gpu\n", benchmark->cached_gpu_nanoseconds / (1000000.0 * benchmark->frame_count));
+    report_write(&report, "direct, all casters:              %.3f ms gpu\n", benchmark->direct_gpu_nanoseconds / (1000000.0 * benchmark->frame_count));
+    report_write(&report, "%llu texels differ between both, max depth difference %g\n", cast_v(unsigned long long, benchmark->different_texel_count), benchmark->max_depth_difference);
+    write_report(&report, platform_api, S("shadow_cache_benchmark.txt"));
 }
 
+#endif
+
 APP_MAIN_LOOP_DEC(application_main_loop) {
     auto state = cast_p(State, app_data_ptr);
     auto ui = &state->ui;
-    auto transient_allocator = &state->transient_memory.allocator;
+    
+    begin_memory_frame(&global_memory_stats, state->frame_arena.used, state->frame_arena.capacity);
+    state->frame_arena.used = 0;
+    
+#if defined FRAME_JOBS_PER_MAIN_LOOP
+    // joined last, after every job of the frame is done
+    start_job_threads(&state->frame_jobs);
+    defer { stop_job_threads(&state->frame_jobs); };
+#endif
     
     bool do_quit = !default_init_frame(state, input, platform_api, &delta_seconds);
     
+    begin_debug_draw_frame(&state->debug_draw, state->debug.is_active, delta_seconds);
+    
     {
         Platform_Window window = platform_api->display_window(platform_api, Main_Window_ID, S("mooselib demo"), &state->main_window_area, true, state->main_window_is_fullscreen, 0.0f);
         
@@ -336,256 +987,675 @@ APP_MAIN_LOOP_DEC(application_main_loop) {
         
         if (do_quit) {
             // save congif (see init)
-            u8_array config = {};
-            *grow_item(transient_allocator, &config, Pixel_Rectangle) = state->main_window_area;
+            u8_array config;
+            config.count = sizeof(Pixel_Rectangle) + 2 * sizeof(mat4x3f);
+            config.data  = ARENA_PUSH_ARRAY(&state->frame_arena, u8, config.count);
+            
+            auto it = config;
+            *next_item(&it, Pixel_Rectangle) = state->main_window_area;
             
             if (state->debug.is_active)
-                *grow_item(transient_allocator, &config, mat4x3f) = state->debug.backup_camera_to_world;
+                *next_item(&it, mat4x3f) = state->debug.backup_camera_to_world;
             else
-                *grow_item(transient_allocator, &config, mat4x3f) = state->camera.to_world;
+                *next_item(&it, mat4x3f) = state->camera.to_world;
             
-            *grow_item(transient_allocator, &config, mat4x3f) = state->debug.camera.to_world;
+            *next_item(&it, mat4x3f) = state->debug.camera.to_world;
             
             platform_api->write_entire_file(S("config.bin"), config);
             
+#if defined MEMORY_STATS
+            write_memory_stats(&global_memory_stats, platform_api, S("memory_stats.txt"), ARENA_PUSH_ARRAY(&state->frame_arena, u32, Memory_Stats_Max_Site_Count));
+#endif
+            
             return Platform_Main_Loop_Quit;
         }
         default_debug_camera(state, input, window, delta_seconds);
         
+        auto profiler = &state->profiler;
+        begin_profile_frame(profiler);
+        defer { end_profile_frame(profiler); };
+        
+        // simulates the next frame on frame_jobs, while this one is submitted
+        Frame_Snapshot const *frame;
+        {
+            Simulation_Input simulation_input;
+            simulation_input.delta_seconds   = delta_seconds;
+            simulation_input.pauses_light    = state->is_light_paused;
+            simulation_input.moves_player    = !state->debug.is_active || state->debug.use_game_controls;
+            simulation_input.move_forward    = input->keys['W'].is_active;
+            simulation_input.move_back       = input->keys['S'].is_active;
+            simulation_input.move_left       = input->keys['A'].is_active;
+            simulation_input.move_right      = input->keys['D'].is_active;
+            simulation_input.camera_to_world = state->camera.to_world;
+            simulation_input.world_to_camera = state->camera.world_to_camera;
+            simulation_input.camera_to_clip  = state->camera.to_clip_projection;
+            
+            frame = begin_pipeline_frame(&state->pipeline, &state->frame_jobs, &simulation_input);
+        }
+        
+        // the simulation overlaps this frame's submission only
+        defer {
+            PROFILE_SCOPE(profiler, S("simulation wait"));
+            end_pipeline_frame(&state->pipeline, &state->frame_jobs);
+        };
+        
+        // every upload of the frame goes to its part of the uniform ring,
+        // the fence follows default_window_end, which still draws with the camera block
+        begin_uniform_ring_frame(&state->uniform_ring);
+        defer { end_uniform_ring_frame(&state->uniform_ring); };
+        
         vec4f clear_color = vec4f{ 0.0, 0.5, 0.5, 1.0 };
         default_window_begin(state, window, clear_color);
         defer { default_window_end(state); };
         
         
-        // update player position
+        if (frame->is_turning) {
+            auto player = frame->player_to_world;
+            ui_write(ui, 5, ui->center_y, S("cos(alpha): %, alpha: %"), f(frame->turn_cos_alpha), f(acos(frame->turn_cos_alpha)));
+            
+            debug_draw_line(&state->debug_draw, player.translation + VEC3_Y_AXIS, player.translation + frame->move_direction * 3 + VEC3_Y_AXIS, vec4f{1, 1, 1, 1});
+            debug_draw_line(&state->debug_draw, player.translation + VEC3_Y_AXIS, player.translation + player.right * 5 + VEC3_Y_AXIS, vec4f{1, 0, 0, 1});
+            debug_draw_line(&state->debug_draw, player.translation + VEC3_Y_AXIS, player.translation + player.forward * 5 + VEC3_Y_AXIS, vec4f{0, 0, 1, 1});
+        }
         
-        if (!state->debug.is_active || state->debug.use_game_controls) {
-            vec3f direction = {};
-            if (input->keys['W'].is_active)
-                direction.z += -1.0f;
+        if (state->debug.is_active) {
+            auto cursor = ui_text(ui, 0, ui->height - 12, S("DEBUG\n"));
             
-            if (input->keys['S'].is_active)
-                direction.z += 1.0f;
+            if (state->debug.use_game_controls)
+                ui_text(ui, &cursor, S("Controling Game\n"));
+            else
+                ui_text(ui, &cursor, S("Controling Debug Camera\n"));
             
-            if (input->keys['A'].is_active)
-                direction.x += -1.0f;
+            ui_write(ui, &cursor, S("FPS: %\n"), f(1 / delta_seconds));
             
-            if (input->keys['D'].is_active)
-                direction.x += 1.0f;
+            {
+                auto probes = &state->reflection_probes;
+                ui_write(ui, &cursor, S("Reflection Probes: %, % of % due faces rendered, budget % (B)\n"), u(probes->count), u(probes->rendered_face_count), u(probes->due_face_count), u(probes->faces_per_frame));
+                
+                if (probes->use_layered_rendering)
+                    ui_text(ui, &cursor, S("Reflection Probes: whole probes layered (L)\n"));
+                else
+                    ui_text(ui, &cursor, S("Reflection Probes: per face (L)\n"));
+            }
+            
+            
+            ui_write(ui, &cursor, S("Reflection Probe Draw Calls: %\n"), u(state->reflection_probes.draw_call_count));
+            ui_write(ui, &cursor, S("Uniform Ring Waits: %\n"), u(state->uniform_ring.wait_count));
+            ui_write(ui, &cursor, S("Shadow Cache: % updates, % hits\n"), u(state->shadow_cache.update_count), u(state->shadow_cache.hit_count));
+            
+            if (state->is_light_paused)
+                ui_text(ui, &cursor, S("Light: paused (P)\n"));
+            else
+                ui_text(ui, &cursor, S("Light: moving (P)\n"));
+            
+            ui_write(ui, &cursor, S("Irradiance Read Backs: %\n"), u(state->reflection_probes.irradiance_readback.completed_count));
+            {
+                auto clusters = &state->light_clusters;
+                ui_write(ui, &cursor, S("Point Lights: %, % cluster indices, at most % per cluster, % dropped\n"), u(clusters->light_count), u(clusters->index_count), u(clusters->max_cluster_light_count), u(clusters->dropped_count));
+            }
             
-            direction = normalize_or_zero(direction);
+            ui_write(ui, &cursor, S("Scene Objects: %, Transforms Updated: %\n"), u(state->scene.count), u(state->scene.updated_count));
+            ui_write(ui, &cursor, S("Program Binaries: % loaded, % compiled, % rejected\n"), u(global_program_binary_cache_stats.loaded_count), u(global_program_binary_cache_stats.compiled_count), u(global_program_binary_cache_stats.rejected_count));
             
-            if (squared_length(direction) > 0.0f)
             {
-                mat4x3f camera_direction_to_world;
-                camera_direction_to_world.forward = normalize(cross(state->camera.to_world.right, VEC3_Y_AXIS));
-                camera_direction_to_world.right   = normalize(cross(VEC3_Y_AXIS, camera_direction_to_world.forward));
-                camera_direction_to_world.up      = normalize(cross(state->camera.to_world.forward, state->camera.to_world.right));
-                camera_direction_to_world.translation = {};
+                auto governor = &state->governor;
+                auto quality = get_quality_level(governor);
                 
-                direction = transform_direction(camera_direction_to_world, direction);
+                if (governor->is_enabled)
+                    ui_write(ui, &cursor, S("Governor: level %, % ms of % ms, % changes (G)\n"), u(governor->level), f(governor->frame_milliseconds), f(governor->budget_milliseconds), u(governor->change_count));
+                else
+                    ui_write(ui, &cursor, S("Governor: off, % ms (G)\n"), f(governor->frame_milliseconds));
                 
-                f32 cos_alpha = dot(state->player.to_world.forward, direction);
+                ui_write(ui, &cursor, S("Resolution Scale: main %, shadow map %, reflection probes %\n"), f(quality.main_view_scale), f(quality.shadow_map_scale), f(1.0f / (1 << state->reflection_probes.level)));
+            }
+            
+#if defined MEMORY_STATS
+            {
+                auto stats = &global_memory_stats;
+                ui_text(ui, &cursor, S("\nMemory (M: write memory_stats.txt)\n"));
                 
-                if (cos_alpha < 1.0) {
-                    
-                    f32 alpha = acos(cos_alpha);
+                for (u32 i = 0; i < stats->allocator_count; i++) {
+                    auto allocator_stats = stats->allocators + i;
                     
-                    ui_write(ui, 5, ui->center_y, S("cos(alpha): %, alpha: %"), f(cos_alpha), f(alpha));
-                    
-                    draw_line(state->player.to_world.translation + VEC3_Y_AXIS, state->player.to_world.translation + direction * 3 + VEC3_Y_AXIS, make_rgba32(1));
+                    ui_text(ui, &cursor, allocator_stats->name);
+                    ui_write(ui, &cursor, S(": % KB live, peak % KB at startup, % KB last frame, % allocations last frame, % grow copies\n"),
+                             u(cast_v(u32, allocator_stats->live_byte_count >> 10)), u(cast_v(u32, allocator_stats->startup_peak_byte_count >> 10)), u(cast_v(u32, allocator_stats->last_frame_peak_byte_count >> 10)),
+                             u(allocator_stats->last_frame_allocation_count), u(allocator_stats->grow_copy_count));
+                }
+                
+                ui_write(ui, &cursor, S("Frame Arena: % of % bytes, at most % bytes\n"), u(stats->last_frame_arena_used), u(stats->frame_arena_capacity), u(stats->max_frame_arena_used));
+                
+                // the largest sites
+                auto site_indices = ARENA_PUSH_ARRAY(&state->frame_arena, u32, Memory_Stats_Max_Site_Count);
+                u32 site_count = min(get_memory_sites_by_size(stats, site_indices), 4u);
+                
+                for (u32 i = 0; i < site_count; i++) {
+                    auto site = stats->sites + site_indices[i];
                     
-                    if (abs(alpha) <= delta_seconds * Pi32 * 2.0f) {
-                        state->player.to_world.forward = direction;
-                    }
-                    else {
-                        alpha = delta_seconds * Pi32 * 2.0f;
-                        
-                        if (dot(state->player.to_world.right, direction) < 0)
-                            alpha *= -1;
-                        
-                        auto rot = make_transform(make_quat(VEC3_Y_AXIS, alpha));
-                        state->player.to_world.forward = normalize(transform_direction(rot, state->player.to_world.forward));
-                    }
-                    state->player.to_world.right = cross(state->player.to_world.up, state->player.to_world.forward);
+                    string file_name;
+                    file_name.data  = cast_p(u8, get_memory_site_file_name(site));
+                    file_name.count = cast_v(u32, strlen(get_memory_site_file_name(site)));
                     
-                    draw_line(state->player.to_world.translation + VEC3_Y_AXIS, state->player.to_world.translation + state->player.to_world.right * 5 + VEC3_Y_AXIS, make_rgba32(1, 0, 0));
-                    draw_line(state->player.to_world.translation + VEC3_Y_AXIS, state->player.to_world.translation + state->player.to_world.forward * 5 + VEC3_Y_AXIS, make_rgba32(0, 0, 1));
+                    ui_text(ui, &cursor, S("  "));
+                    ui_text(ui, &cursor, file_name);
+                    ui_write(ui, &cursor, S(":%: % KB in % allocations\n"), u(site->line), u(cast_v(u32, site->allocated_byte_count >> 10)), u(site->allocation_count));
                 }
             }
             
-            state->player.to_world.translation += direction * delta_seconds * 20.0f;
+#endif
+            
+#if defined DEBUG_EDITOR
+            ui_write(ui, &cursor, S("Debug Lines: %, Dropped: %\n"), u(state->debug_draw.frame_vertex_count / 2 + state->debug_draw.persistent_line_count), u(state->debug_draw.dropped_line_count));
+#endif
+            
+            if (profiler->is_capturing)
+                ui_text(ui, &cursor, S("\nPasses (writing frame_trace.json)\n"));
+            else
+                ui_text(ui, &cursor, S("\nPasses (T: write trace)\n"));
+            
+            for (u32 i = 0; i < profiler->pass_count; i++) {
+                auto pass = profiler->passes + i;
+                
+                for (u32 depth = 0; depth < pass->depth; depth++)
+                    ui_text(ui, &cursor, S("  "));
+                
+                ui_text(ui, &cursor, pass->name);
+                ui_write(ui, &cursor, S(": cpu % ms, gpu % ms\n"), f(pass->cpu_milliseconds), f(pass->gpu_milliseconds));
+            }
         }
         
-        // draw origin
-        draw_object_to_world_transform(MAT4X3_IDENTITY);
+        // write a chrome trace
+        {
+            bool is_active = input->keys['T'].is_active;
+            
+            if (is_active && !state->trace_key_was_active)
+                begin_profile_capture(profiler, S("frame_trace.json"));
+            
+            state->trace_key_was_active = is_active;
+        }
         
-        if (state->debug.is_active) {
-            auto cursor = ui_text(ui, 0, ui->height - 12, S("DEBUG\n"));
+        // dynamic resolution on or off
+        {
+            bool is_active = input->keys['G'].is_active;
             
-            if (state->debug.use_game_controls)
-                ui_text(ui, &cursor, S("Controling Game\n"));
-            else
-                ui_text(ui, &cursor, S("Controling Debug Camera\n"));
+            if (is_active && !state->governor_key_was_active)
+                set_frame_governor_enabled(&state->governor, !state->governor.is_enabled);
             
-            ui_write(ui, &cursor, S("FPS: %\n"), f(1 / delta_seconds));
+            state->governor_key_was_active = is_active;
+        }
+        
+        update_frame_governor(&state->governor, profiler, delta_seconds);
+        
+#if defined MEMORY_STATS
+        // write memory_stats.txt
+        {
+            bool is_active = input->keys['M'].is_active;
+            
+            if (is_active && !state->memory_stats_key_was_active)
+                write_memory_stats(&global_memory_stats, platform_api, S("memory_stats.txt"), ARENA_PUSH_ARRAY(&state->frame_arena, u32, Memory_Stats_Max_Site_Count));
+            
+            state->memory_stats_key_was_active = is_active;
         }
+#endif
         
-        static f32 light_animation_time = 0;
-        light_animation_time += delta_seconds;
-        vec3f light_pos = { 2 * sin(light_animation_time), 25, 5 };
+        // switch the reflection probe face budget between the default and the most one frame can render
+        {
+            bool is_active = input->keys['B'].is_active;
+            
+            if (is_active && !state->probe_budget_key_was_active) {
+                auto probes = &state->reflection_probes;
+                probes->faces_per_frame = (probes->faces_per_frame == Reflection_Probe_Default_Faces_Per_Frame) ? Reflection_Probe_Max_Faces_Per_Frame : Reflection_Probe_Default_Faces_Per_Frame;
+            }
+            
+            state->probe_budget_key_was_active = is_active;
+        }
+        
+        // switch between layered and per face rendering of whole reflection probes
+        {
+            bool is_active = input->keys['L'].is_active;
+            
+            if (is_active && !state->probe_layering_key_was_active && state->layered_sky_shader.program_object) {
+                auto probes = &state->reflection_probes;
+                probes->use_layered_rendering = !probes->use_layered_rendering && state->layered_probe_scene_shader.program_object;
+            }
+            
+            state->probe_layering_key_was_active = is_active;
+        }
+        
+        // pause or continue the light animation, a paused light uses the shadow cache.
+        // takes effect with the next simulated frame
+        {
+            bool is_active = input->keys['P'].is_active;
+            
+            if (is_active && !state->light_pause_key_was_active)
+                state->is_light_paused = !state->is_light_paused;
+            
+            state->light_pause_key_was_active = is_active;
+        }
+        
+        vec3f light_pos = frame->light_position;
         f32 light_k = .005f;
-        draw_circle(light_pos, 1.0f, state->camera.to_world.forward, make_rgba32(1));
         
         // upload lights
         {
-            glBindBuffer(GL_UNIFORM_BUFFER, state->light_uniform_buffer_object);
-            auto light_block = cast_p(Lighting_Uniform_Block, glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY));
+            PROFILE_SCOPE(profiler, S("light upload"));
+            
+            Lighting_Uniform_Block light_block = {};
             
-            light_block->global_ambient_color = make_vec4(0.2f, 0.2f, 0.2f) *0;
+            light_block.global_ambient_color = make_vec4(0.2f, 0.2f, 0.2f) *0;
             
             f32 global_attenuation = 0.3f;
-            light_block->parameters[0] = normalize_or_zero(make_vec4(1.0f, -1.0f, 0.0f));
-            light_block->colors[0] = make_vec4(1.0f, 1.0f, 1.0f) * global_attenuation;
-            light_block->directional_light_count = 1;
+            light_block.parameters[0] = normalize_or_zero(make_vec4(1.0f, -1.0f, 0.0f));
+            light_block.colors[0] = make_vec4(1.0f, 1.0f, 1.0f) * global_attenuation;
+            light_block.directional_light_count = 1;
             
-            draw_circle(vec3f{0, 20, 0}, .5f, state->camera.to_world.forward, make_rgba32(light_block->colors[0]));
-            draw_line(vec3f{0, 20, 0}, vec3f{0, 20, 0} + make_vec3_cut(light_block->parameters[0]) * 5, make_rgba32(light_block->colors[0]));
+            debug_draw_circle(&state->debug_draw, vec3f{0, 20, 0}, .5f, frame->camera_to_world.forward, light_block.colors[0]);
+            debug_draw_line(&state->debug_draw, vec3f{0, 20, 0}, vec3f{0, 20, 0} + make_vec3_cut(light_block.parameters[0]) * 5, light_block.colors[0]);
             
-            light_block->point_light_count = 1;
-            light_block->parameters[1] = make_vec4(light_pos.x, light_pos.y, light_pos.z, light_k);
-            light_block->colors[1] = make_vec4(1.0f, 1.0f, 1.0f, 1.0f);
+            light_block.point_light_count = 1;
+            light_block.parameters[1] = make_vec4(light_pos.x, light_pos.y, light_pos.z, light_k);
+            light_block.colors[1] = make_vec4(1.0f, 1.0f, 1.0f, 1.0f);
             
-            draw_circle(light_pos, 1.0f, state->camera.to_world.forward, make_rgba32(light_block->colors[0]));
+            debug_draw_circle(&state->debug_draw, light_pos, 1.0f, frame->camera_to_world.forward, light_block.colors[0]);
             
-            glUnmapBuffer(GL_UNIFORM_BUFFER);
-            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            if (state->default_lighting_binding >= 0) {
+                bind_uniform_range(push_uniform_data(&state->uniform_ring, &light_block, sizeof(light_block)), state->default_lighting_binding);
+            }
+            else {
+                glBindBuffer(GL_UNIFORM_BUFFER, state->light_uniform_buffer_object);
+                glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(light_block), &light_block);
+                glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            }
+            
+            // same lights for the demo shaders
+            Scene_Lighting_Block scene_lighting = {};
+            scene_lighting.global_ambient_color    = light_block.global_ambient_color;
+            scene_lighting.directional_light_count = light_block.directional_light_count;
+            scene_lighting.point_light_count       = light_block.point_light_count;
+            
+            for (u32 i = 0; i < scene_lighting.directional_light_count + scene_lighting.point_light_count; i++) {
+                scene_lighting.parameters[i] = light_block.parameters[i];
+                scene_lighting.colors[i]     = light_block.colors[i];
+            }
+            
+            bind_uniform_range(push_uniform_data(&state->uniform_ring, &scene_lighting, sizeof(scene_lighting)), Scene_Lighting_Binding);
+            
+            begin_light_clusters(&state->light_clusters);
+            
+#if defined STRESS_TEST_POINT_LIGHT_COUNT
+            add_demo_point_lights(&state->light_clusters, frame->light_animation_time);
+#endif
         }
         
-        // update shadow map
-        mat4f world_to_shadow;
+        // collect and sort the scene once for all passes
+        auto queue = &state->render_queue;
+        begin_render_queue(queue);
+        
         {
-            glClearColor(1.0, 1.0, 1.0, 1.0);
-            glDisable(GL_SCISSOR_TEST);
-            bind_frame_buffer(state->shadow_map_frame_buffer);
-            
-            glUseProgram(state->shadow_map_shader.program_object);
+            PROFILE_SCOPE(profiler, S("scene update"));
             
-            // shadow referes to clip space of the shadow map
-            
-            // light camera renders a squared canvas
-            auto light_to_shadow = make_perspective_fov_projection(Pi32 * 0.5f, 1.0f);
+            set_scene_object_transform(&state->scene, state->pawn_object, frame->player_to_world);
+            update_scene_transforms(&state->scene, &state->frame_jobs);
             
+            queue_scene_objects(&state->scene, queue);
+        }
+        
+        sort_render_queue(queue);
+        
+        // shadow referes to clip space of the shadow map
+        // light camera renders a squared canvas
+        auto light_to_shadow = make_perspective_fov_projection(Pi32 * 0.5f, 1.0f);
+        mat4f world_to_shadow;
+        {
             // light looks down
             auto light_to_world = make_transform(make_quat(VEC3_X_AXIS, Pi32 * -.5f), light_pos);
             auto world_to_light = make_inverse_unscaled_transform(light_to_world);
             
             world_to_shadow = light_to_shadow * world_to_light;
             
-            glUniformMatrix4fv(state->shadow_map_shader.World_To_Shadow_Map, 1, GL_FALSE, world_to_shadow);
+            debug_draw_transform(&state->debug_draw, light_to_world);
+        }
+        
+        // faces of the reflection probes due this frame, all use the same projection
+        auto probe_to_clip = make_perspective_fov_projection(Pi32 * .5f, 1.0f);
+        Reflection_Probe_Face probe_faces[Reflection_Probe_Max_Faces_Per_Frame];
+        mat4x3f world_to_probe_faces[Reflection_Probe_Max_Faces_Per_Frame];
+        u32 probe_face_count;
+        Reflection_Probe_Pass probe_passes[Reflection_Probe_Max_Faces_Per_Frame];
+        u32 probe_pass_count = 0;
+        {
+            vec3f camera_position = frame->camera_to_world.translation;
+            probe_face_count = schedule_reflection_probe_faces(&state->reflection_probes, queue, state->scene.static_version, camera_position, delta_seconds, probe_faces);
             
-            draw_object_to_world_transform(light_to_world);
+            for (u32 i = 0; i < probe_face_count; i++) {
+                auto probe = state->reflection_probes.probes + probe_faces[i].probe;
+                world_to_probe_faces[i] = make_world_to_cube_face(probe->position, probe_faces[i].face);
+            }
             
-            render_scene(state, true, state->shadow_map_shader.Object_To_World);
+            for (u32 i = 0; i < probe_face_count; ) {
+                u32 face_count = 1;
+                if (state->reflection_probes.use_layered_rendering && is_whole_reflection_probe(probe_faces, probe_face_count, i))
+                    face_count = 6;
+                
+                probe_passes[probe_pass_count++] = { i, face_count };
+                i += face_count;
+            }
             
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+#if defined DEBUG_EDITOR
+            // influence boxes, red while faces are due, yellow while static and green otherwise
+            for (u32 i = 0; i < state->reflection_probes.count; i++) {
+                auto probe = state->reflection_probes.probes + i;
+                
+                vec4f color;
+                if (probe->due_faces)
+                    color = vec4f{1, 0, 0, 1};
+                else if (probe->flags & Reflection_Probe_Static)
+                    color = vec4f{1, 1, 0, 1};
+                else
+                    color = vec4f{0, 1, 0, 1};
+                
+                debug_draw_box(&state->debug_draw, probe->influence_min, probe->influence_max, color);
+            }
+#endif
+        }
+        
+        auto world_to_main_clip = frame->camera_to_clip * frame->world_to_camera;
+        
+        // render resolutions of this frame, the targets keep their size and passes render to their lower left part
+        auto quality = get_quality_level(&state->governor);
+        auto shadow_size = scale_dimensions(state->shadow_map_frame_buffer.size, quality.shadow_map_scale);
+        auto main_size   = scale_dimensions(state->main_window_area.size, quality.main_view_scale);
+        bool is_main_view_scaled = (main_size.width != state->main_window_area.size.width) || (main_size.height != state->main_window_area.size.height);
+        
+        {
+            u32 level = min(quality.reflection_probe_level, state->reflection_probes.level_count - 1);
+            if (level != state->reflection_probes.level)
+                set_reflection_probe_level(&state->reflection_probes, level);
+        }
+        
+        s32 probe_size = max(state->reflection_probes.resolution.width >> state->reflection_probes.level, 1);
+        
+        // for sampling, rendering the shadow map still uses world_to_shadow
+        auto world_to_shadow_lookup = scale_shadow_lookup(world_to_shadow, cast_v(f32, shadow_size.width) / state->shadow_map_frame_buffer.size.width);
+        
+        auto shadow_cache = &state->shadow_cache;
+        bool use_shadow_cache = (shadow_cache->static_version == state->scene.static_version) && !memcmp(&shadow_cache->world_to_shadow, &world_to_shadow, sizeof(world_to_shadow)) &&
+            (shadow_cache->size.width == shadow_size.width) && (shadow_cache->size.height == shadow_size.height);
+        bool update_shadow_cache = use_shadow_cache && !shadow_cache->is_valid;
+        
+        // cull every view before anything is drawn, so all visible lists are uploaded at once.
+        // views are built in parallel on frame_jobs, see upload_render_queue
+        u32 static_shadow_view = 0;
+        u32 shadow_view; // the dynamic casters, or all of them without the cache
+#if defined BENCHMARK_SHADOW_CACHE
+        u32 benchmark_shadow_view = 0;
+#endif
+        u32 main_view;
+        {
+            PROFILE_SCOPE(profiler, S("culling"));
+            
+            Frustum frustum = make_frustum(world_to_shadow);
+            auto shadow_lods = make_lod_selection(light_pos, light_to_shadow, shadow_size.height, Shadow_Lod_Bias);
+            
+            if (update_shadow_cache)
+                static_shadow_view = add_render_view(queue, &frustum, &shadow_lods, Draw_Item_Static, Draw_Item_Static);
+            
+            if (use_shadow_cache)
+                shadow_view = add_render_view(queue, &frustum, &shadow_lods, Draw_Item_Static, 0);
+            else
+                shadow_view = add_render_view(queue, &frustum, &shadow_lods);
+            
+#if defined BENCHMARK_SHADOW_CACHE
+            if (use_shadow_cache && !update_shadow_cache)
+                benchmark_shadow_view = add_render_view(queue, &frustum, &shadow_lods);
+#endif
+            
+            for (u32 i = 0; i < probe_pass_count; i++) {
+                auto pass = probe_passes + i;
+                auto probe = state->reflection_probes.probes + probe_faces[pass->first_face].probe;
+                auto probe_lods = make_lod_selection(probe->position, probe_to_clip, probe_size, Reflection_Probe_Lod_Bias);
+                
+                // static probes are not updated when dynamic items move, so they only capture static ones
+                u32 flags = (probe->flags & Reflection_Probe_Static) ? Draw_Item_Static : 0;
+                
+                // a whole probe sees everywhere, the geometry shader skips the faces a triangle misses
+                if (pass->face_count == 6) {
+                    pass->view = add_render_view(queue, 0, &probe_lods, flags, flags);
+                }
+                else {
+                    frustum = make_frustum(probe_to_clip * world_to_probe_faces[pass->first_face]);
+                    pass->view = add_render_view(queue, &frustum, &probe_lods, flags, flags);
+                }
+            }
+            
+            frustum = make_frustum(world_to_main_clip);
+            auto main_lods = make_lod_selection(frame->camera_to_world.translation, frame->camera_to_clip, main_size.height);
+            main_view = add_render_view(queue, &frustum, &main_lods);
+            
+            upload_render_queue(queue, &state->instance_buffer, &state->uniform_ring, &state->frame_jobs);
+        }
+        
+        {
+            PROFILE_SCOPE(profiler, S("light clusters"));
+            
+            build_light_clusters(&state->light_clusters, frame->world_to_camera, frame->camera_to_clip, main_size, &state->frame_jobs);
+            upload_light_clusters(&state->light_clusters, &state->uniform_ring);
+        }
+        
+        if (state->debug.is_active) {
+            ui_write(ui, 0, ui->height - 96, S("Visible: shadow %, main % of %\n"), u(queue->views[shadow_view].visible_count), u(queue->views[main_view].visible_count), u(queue->item_count));
+            
+            u32 probe_index_count = 0;
+            for (u32 i = 0; i < probe_pass_count; i++)
+                probe_index_count += queue->views[probe_passes[i].view].index_count;
+            
+            ui_write(ui, 0, ui->height - 108, S("Indices: shadow %, reflection probes %, main %\n"), u(queue->views[shadow_view].index_count), u(probe_index_count), u(queue->views[main_view].index_count));
         }
         
-        // update environment_map
+        // update shadow map
         {
-            glUseProgram(state->default_shader.program_object);
-            glUniformMatrix4fv(state->default_shader.uniform.Shadow.world_to_shadow, 1, GL_FALSE, world_to_shadow);
+            PROFILE_SCOPE(profiler, S("shadow map"));
             
-            glBindFramebuffer(GL_FRAMEBUFFER, state->render_to_texture_frame_buffer.object);
-            glViewport(0, 0, state->environment_map.resolution.width, state->environment_map.resolution.height);
+            glClearColor(1.0, 1.0, 1.0, 1.0);
             glDisable(GL_SCISSOR_TEST);
             
-            glClearColor(clear_color.r, clear_color.g, clear_color.b, clear_color.a);
+            Scene_Camera_Block shadow_camera = {};
+            shadow_camera.world_to_clip[0] = world_to_shadow;
+            shadow_camera.world_position   = make_vec4(light_pos.x, light_pos.y, light_pos.z, 1.0f);
+            bind_uniform_range(push_uniform_data(&state->uniform_ring, &shadow_camera, sizeof(shadow_camera)), Scene_Camera_Binding);
             
-            for (u32 i = 0; i < 6; i++)
-            {
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, state->environment_map.texture_object, 0);
+            glUseProgram(state->depth_scene_shader.program_object);
+            glUniform1i(state->depth_scene_shader.uniform.View_Index, 0);
+            
+            auto map = &state->shadow_map_frame_buffer;
+            
+            // only the rendered part and a border texel for the pcf are copied, the border stays at the cleared depth
+            s32 copy_width  = min(shadow_size.width + 1, map->size.width);
+            s32 copy_height = min(shadow_size.height + 1, map->size.height);
+            
+            if (use_shadow_cache && !update_shadow_cache) {
+                // start from the static casters and add the dynamic ones
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, shadow_cache->frame_buffer.object);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, map->object);
+                glBlitFramebuffer(0, 0, copy_width, copy_height, 0, 0, copy_width, copy_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
                 
-                mat4x3f world_to_probe;
+                glBindFramebuffer(GL_FRAMEBUFFER, map->object);
+                glViewport(0, 0, shadow_size.width, shadow_size.height);
                 
-                auto eye = state->environment_probe.position;
+                shadow_cache->hit_count++;
+            }
+            else {
+                bind_frame_buffer(*map);
+                glViewport(0, 0, shadow_size.width, shadow_size.height);
                 
-                switch (GL_TEXTURE_CUBE_MAP_POSITIVE_X + i) {
-                    case GL_TEXTURE_CUBE_MAP_POSITIVE_X: {
-                        world_to_probe = make_look_at({}, VEC3_X_AXIS, -VEC3_Y_AXIS);
-                    } break;
+                // the static casters go to the shadow map directly and are copied to the cache before the dynamic ones are added
+                if (update_shadow_cache) {
+                    draw_render_queue(queue, static_shadow_view, &state->instance_buffer, &state->depth_scene_shader.uniform.Instancing, 0);
                     
-                    case GL_TEXTURE_CUBE_MAP_NEGATIVE_X: {
-                        world_to_probe = make_look_at({}, -VEC3_X_AXIS, -VEC3_Y_AXIS);
-                    } break;
+                    glBindFramebuffer(GL_READ_FRAMEBUFFER, map->object);
+                    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow_cache->frame_buffer.object);
+                    glBlitFramebuffer(0, 0, copy_width, copy_height, 0, 0, copy_width, copy_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
                     
-                    case GL_TEXTURE_CUBE_MAP_POSITIVE_Y: {
-                        world_to_probe = make_look_at({}, VEC3_Y_AXIS, VEC3_Z_AXIS);
-                    } break;
+                    glBindFramebuffer(GL_FRAMEBUFFER, map->object);
                     
-                    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y: {
-                        world_to_probe = make_look_at({}, -VEC3_Y_AXIS, -VEC3_Z_AXIS);
-                    } break;
-                    
-                    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z: {
-                        world_to_probe = make_look_at({}, VEC3_Z_AXIS, -VEC3_Y_AXIS);
-                    } break;
-                    
-                    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z: {
-                        world_to_probe = make_look_at({}, -VEC3_Z_AXIS, -VEC3_Y_AXIS);
-                    } break;
+                    shadow_cache->is_valid = true;
+                    shadow_cache->update_count++;
                 }
+            }
+            
+            draw_render_queue(queue, shadow_view, &state->instance_buffer, &state->depth_scene_shader.uniform.Instancing, 0);
+            
+            // the cache is used once the next frame matches this one
+            if (!use_shadow_cache) {
+                shadow_cache->world_to_shadow = world_to_shadow;
+                shadow_cache->static_version  = state->scene.static_version;
+                shadow_cache->size            = shadow_size;
+                shadow_cache->is_valid        = false;
+            }
+            
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            
+#if defined BENCHMARK_SHADOW_CACHE
+            if (use_shadow_cache && !update_shadow_cache)
+                benchmark_shadow_cache(state, platform_api, queue, shadow_view, benchmark_shadow_view, shadow_size, copy_width, copy_height);
+#endif
+        }
+        
+        // update the due faces of the reflection probes, they reflect the sky
+        if (state->reflection_probes.count) {
+            PROFILE_SCOPE(profiler, S("reflection probes"));
+            
+            global_draw_call_count = 0;
+            
+            glClearColor(clear_color.r, clear_color.g, clear_color.b, clear_color.a);
+            
+            string face_names[] = {
+                S("+x face"), S("-x face"),
+                S("+y face"), S("-y face"),
+                S("+z face"), S("-z face"),
+            };
+            
+            auto clip_to_probe = make_inverse_perspective_projection(probe_to_clip);
+            
+            for (u32 i = 0; i < probe_pass_count; i++) {
+                auto pass = probe_passes[i];
+                auto first_face = probe_faces[pass.first_face];
+                auto probe = state->reflection_probes.probes + first_face.probe;
                 
-                world_to_probe.translation = eye;
-                world_to_probe = make_inverse_unscaled_transform(world_to_probe);
-                
-                auto probe_to_clip = make_perspective_fov_projection(Pi32 * .5f, 1.0f);
-                
-                auto clip_to_probe = make_inverse_perspective_projection(probe_to_clip);
-                auto probe_to_world = make_inverse_unscaled_transform(world_to_probe);
-                
-                vec3f a = get_clip_to_world_point(probe_to_world, clip_to_probe, vec3f{-1, -1, 0});
-                vec3f b = get_clip_to_world_point(probe_to_world, clip_to_probe, vec3f{ 1, -1, 0});
-                vec3f c = get_clip_to_world_point(probe_to_world, clip_to_probe, vec3f{ 1,  1, 0});
-                vec3f d = get_clip_to_world_point(probe_to_world, clip_to_probe, vec3f{-1,  1, 0});
-                
-                // draws one side of the purple cube
-                // just to see if its a correct cube (so the environmap renders prperly in 360°)
-                draw_line(a, b, make_rgba32(1, 0, 1));
-                draw_line(b, c, make_rgba32(1, 0, 1));
-                draw_line(c, d, make_rgba32(1, 0, 1));
-                draw_line(d, a, make_rgba32(1, 0, 1));
-                
-                // override camera
-                upload_camera_block(state->camera_uniform_buffer_object, world_to_probe, probe_to_clip, eye);
+                // a matrix per face of the pass
+                Scene_Camera_Block probe_camera = {};
+                for (u32 j = 0; j < pass.face_count; j++) {
+                    auto world_to_face = world_to_probe_faces[pass.first_face + j];
+                    probe_camera.world_to_clip[j] = probe_to_clip * world_to_face;
+                    probe_camera.clip_to_world[j] = make_inverse_unscaled_transform(world_to_face) * clip_to_probe;
+                }
                 
-                glClear(GL_DEPTH_BUFFER_BIT);
+                probe_camera.world_position = make_vec4(probe->position.x, probe->position.y, probe->position.z, 1.0f);
+                auto camera = push_uniform_data(&state->uniform_ring, &probe_camera, sizeof(probe_camera));
                 
-                render_sky(state, world_to_probe, probe_to_clip);
-                render_scene(state);
+                if (pass.face_count == 6) {
+                    PROFILE_SCOPE(profiler, S("layered probe"));
+                    
+                    u32 first_layer = first_face.probe * 6;
+                    
+                    begin_reflection_probe_layers(&state->reflection_probes, first_face.probe);
+                    
+                    bind_uniform_range(camera, Scene_Camera_Binding);
+                    render_layered_sky(state, first_layer);
+                    
+                    glUseProgram(state->layered_probe_scene_shader.program_object);
+                    glUniform1i(state->layered_probe_scene_shader.uniform.First_Layer, first_layer);
+                    render_queue_with_scene_shader(state, queue, pass.view, &state->layered_probe_scene_shader, camera, world_to_shadow_lookup, state->skybox_cube_map_object, &state->skybox_irradiance);
+                    
+                    for (u32 j = 0; j < 6; j++)
+                        end_reflection_probe_face(&state->reflection_probes, probe_faces[pass.first_face + j]);
+                }
+                else {
+                    PROFILE_SCOPE(profiler, face_names[first_face.face]);
+                    
+                    auto world_to_face = world_to_probe_faces[pass.first_face];
+                    
+                    begin_reflection_probe_face(&state->reflection_probes, first_face);
+                    
+                    upload_default_camera(state, i, world_to_face, probe_to_clip, probe->position);
+                    
+                    render_sky(state, world_to_face, probe_to_clip);
+                    render_queue_with_scene_shader(state, queue, pass.view, &state->probe_scene_shader, camera, world_to_shadow_lookup, state->skybox_cube_map_object, &state->skybox_irradiance);
+                    
+                    end_reflection_probe_face(&state->reflection_probes, first_face);
+                }
             }
             
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            // one read back in flight, the irradiance lags the probe by the frames the gpu is behind
+            {
+                PROFILE_SCOPE(profiler, S("irradiance"));
+                update_reflection_probe_irradiance(&state->reflection_probes);
+            }
             
-            glBindTexture(GL_TEXTURE_CUBE_MAP, state->environment_map.texture_object);
-            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+            state->reflection_probes.draw_call_count = global_draw_call_count;
         }
         
         // render final scene
-        upload_camera_block(state);
-        
         {
-            set_auto_viewport(state->main_window_area.size, state->main_window_area.size, clear_color);
+            PROFILE_SCOPE(profiler, S("final scene"));
             
-            glUseProgram(state->default_shader.program_object);
+            upload_default_camera(state, Reflection_Probe_Max_Faces_Per_Frame, frame->world_to_camera, frame->camera_to_clip, frame->camera_to_world.translation);
             
-            glUniformMatrix4x3fv(state->default_shader.uniform.Environment.world_to_environment, 1, GL_FALSE, make_inverse_unscaled_transform(make_transform(QUAT_IDENTITY, state->environment_probe.position)));
+            if (is_main_view_scaled) {
+                update_main_view_target(state, state->main_window_area.size);
+                
+                glBindFramebuffer(GL_FRAMEBUFFER, state->main_view_target.frame_buffer_object);
+                glViewport(0, 0, main_size.width, main_size.height);
+                glDisable(GL_SCISSOR_TEST);
+                glClearColor(clear_color.r, clear_color.g, clear_color.b, clear_color.a);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+            else {
+                set_auto_viewport(state->main_window_area.size, state->main_window_area.size, clear_color);
+            }
             
-            glUniformMatrix4fv(state->default_shader.uniform.Shadow.world_to_shadow, 1, GL_FALSE, world_to_shadow);
+            Scene_Camera_Block main_camera = {};
+            main_camera.world_to_clip[0] = world_to_main_clip;
+            main_camera.clip_to_world[0] = make_inverse_unscaled_transform(frame->world_to_camera) * make_inverse_perspective_projection(frame->camera_to_clip);
+            main_camera.world_position   = make_vec4(frame->camera_to_world.translation.x, frame->camera_to_world.translation.y, frame->camera_to_world.translation.z, 1.0f);
+            auto camera = push_uniform_data(&state->uniform_ring, &main_camera, sizeof(main_camera));
+            
+            {
+                Frustum frustum = make_frustum(world_to_main_clip);
+                Scene_Reflection_Probes_Block probes_block = {};
+                fill_reflection_probes_block(&probes_block, &state->reflection_probes, &frustum, frame->camera_to_world.translation);
+                bind_uniform_range(push_uniform_data(&state->uniform_ring, &probes_block, sizeof(probes_block)), Scene_Reflection_Probes_Binding);
+            }
             
+            {
+                PROFILE_SCOPE(profiler, S("sky"));
+                render_sky(state, frame->world_to_camera, frame->camera_to_clip);
+            }
             
-            render_sky(state, state->camera.world_to_camera, state->camera.to_clip_projection);
-            render_scene(state);
+            {
+                PROFILE_SCOPE(profiler, S("scene"));
+                render_queue_with_scene_shader(state, queue, main_view, &state->scene_shader, camera, world_to_shadow_lookup, state->skybox_cube_map_object, &state->skybox_irradiance);
+            }
+            
+#if defined DEBUG_EDITOR
+            if (state->debug.is_active) {
+                PROFILE_SCOPE(profiler, S("debug draw"));
+                flush_debug_draw(&state->debug_draw, &state->uniform_ring, world_to_main_clip);
+            }
+#endif
+            
+            // the overlay is drawn afterwards at window resolution
+            if (is_main_view_scaled) {
+                PROFILE_SCOPE(profiler, S("upscale"));
+                
+                auto window_size = state->main_window_area.size;
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, state->main_view_target.frame_buffer_object);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                glBlitFramebuffer(0, 0, main_size.width, main_size.height, 0, 0, window_size.width, window_size.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(0, 0, window_size.width, window_size.height);
+            }
         }
     }
     
@@ -0,0 +1,338 @@
+#if !defined MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+// instrumentation of what the demo allocates through mooselib's allocators.
+// its grow, grow_item, free_array and read_entire_file calls go through the TRACK_ macros below,
+// which tally bytes, counts and grow copies per call site and live bytes and high-water marks per allocator.
+// mooselib does not report what an allocation really takes, so bytes are what the arrays grew by,
+// free_array is assumed to release the whole array and a grow copy is a grow that moved the array's data.
+// the startup high-water mark covers everything before the first begin_memory_frame.
+// without MEMORY_STATS the macros are the plain calls.
+// like the allocators themselves, only the main thread may use them.
+
+#include <stdio.h>
+
+#include "report.h"
+
+u32 const Memory_Stats_Max_Allocator_Count = 4;
+
+// a power of two, sites are found by hash
+u32 const Memory_Stats_Max_Site_Count = 256;
+
+struct Memory_Allocator_Stats {
+    Memory_Allocator *allocator;
+    string name;
+
+    u64 live_byte_count;
+    u64 startup_peak_byte_count;
+    u64 frame_peak_byte_count;
+    u64 max_frame_peak_byte_count;
+
+    u32 allocation_count;
+    u32 grow_copy_count;
+    u64 copied_byte_count;
+
+    u32 frame_allocation_count;
+    u64 frame_allocated_byte_count;
+
+    // of the last finished frame, for the debug overlay
+    u32 last_frame_allocation_count;
+    u64 last_frame_allocated_byte_count;
+    u64 last_frame_peak_byte_count;
+};
+
+struct Memory_Site {
+    char const *file;
+    u32 line;
+    u32 allocator_index;
+
+    u32 allocation_count;
+    u64 allocated_byte_count;
+    u32 free_count;
+    u64 freed_byte_count;
+    u32 grow_copy_count;
+    u64 copied_byte_count;
+};
+
+struct Memory_Stats {
+    // the last one counts allocators that were never registered
+    Memory_Allocator_Stats allocators[Memory_Stats_Max_Allocator_Count + 1];
+    u32 allocator_count;
+
+    // file 0 marks a free slot
+    Memory_Site sites[Memory_Stats_Max_Site_Count];
+    u32 site_count;
+
+    // calls whose site did not fit, they still count for their allocator
+    u32 untracked_site_call_count;
+
+    u32 frame_count;
+
+    // used bytes of the per frame scratch arena, see begin_memory_frame
+    u32 frame_arena_capacity;
+    u32 last_frame_arena_used;
+    u32 max_frame_arena_used;
+};
+
+Memory_Stats global_memory_stats;
+
+struct Memory_Array_Snapshot {
+    void const *data;
+    u64 count;
+    u32 item_size;
+};
+
+template <typename Array>
+Memory_Array_Snapshot get_memory_array_snapshot(Array const *array) {
+    Memory_Array_Snapshot snapshot;
+    snapshot.data      = array->data;
+    snapshot.count     = array->count;
+    snapshot.item_size = sizeof(*array->data);
+
+    return snapshot;
+}
+
+void register_memory_allocator(Memory_Stats *stats, Memory_Allocator *allocator, string name) {
+    assert(stats->allocator_count < Memory_Stats_Max_Allocator_Count);
+
+    auto allocator_stats = stats->allocators + stats->allocator_count++;
+    allocator_stats->allocator = allocator;
+    allocator_stats->name      = name;
+}
+
+u32 get_memory_allocator_index(Memory_Stats *stats, Memory_Allocator *allocator) {
+    for (u32 i = 0; i < stats->allocator_count; i++) {
+        if (stats->allocators[i].allocator == allocator)
+            return i;
+    }
+
+    stats->allocators[Memory_Stats_Max_Allocator_Count].name = S("other");
+
+    return Memory_Stats_Max_Allocator_Count;
+}
+
+// 0 if the table is full
+Memory_Site * get_memory_site(Memory_Stats *stats, char const *file, u32 line, u32 allocator_index) {
+    u32 hash = cast_v(u32, cast_v(size_t, file) >> 3) ^ (line * 2654435761u) ^ (allocator_index * 40503u);
+
+    for (u32 i = 0; i < Memory_Stats_Max_Site_Count; i++) {
+        auto site = stats->sites + ((hash + i) & (Memory_Stats_Max_Site_Count - 1));
+
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+            site->allocator_index = allocator_index;
+            stats->site_count++;
+
+            return site;
+        }
+
+        if ((site->file == file) && (site->line == line) && (site->allocator_index == allocator_index))
+            return site;
+    }
+
+    stats->untracked_site_call_count++;
+
+    return 0;
+}
+
+void track_allocation(Memory_Stats *stats, Memory_Allocator *allocator, u64 byte_count, char const *file, u32 line) {
+    u32 allocator_index = get_memory_allocator_index(stats, allocator);
+    auto allocator_stats = stats->allocators + allocator_index;
+
+    allocator_stats->allocation_count++;
+    allocator_stats->frame_allocation_count++;
+    allocator_stats->frame_allocated_byte_count += byte_count;
+    allocator_stats->live_byte_count += byte_count;
+
+    if (stats->frame_count)
+        allocator_stats->frame_peak_byte_count = max(allocator_stats->frame_peak_byte_count, allocator_stats->live_byte_count);
+    else
+        allocator_stats->startup_peak_byte_count = max(allocator_stats->startup_peak_byte_count, allocator_stats->live_byte_count);
+
+    auto site = get_memory_site(stats, file, line, allocator_index);
+    if (site) {
+        site->allocation_count++;
+        site->allocated_byte_count += byte_count;
+    }
+}
+
+void track_grow(Memory_Stats *stats, Memory_Allocator *allocator, Memory_Array_Snapshot before, Memory_Array_Snapshot after, char const *file, u32 line) {
+    track_allocation(stats, allocator, (after.count - before.count) * after.item_size, file, line);
+
+    if (!before.data || (before.data == after.data))
+        return;
+
+    u64 copied_byte_count = before.count * before.item_size;
+
+    u32 allocator_index = get_memory_allocator_index(stats, allocator);
+    stats->allocators[allocator_index].grow_copy_count++;
+    stats->allocators[allocator_index].copied_byte_count += copied_byte_count;
+
+    auto site = get_memory_site(stats, file, line, allocator_index);
+    if (site) {
+        site->grow_copy_count++;
+        site->copied_byte_count += copied_byte_count;
+    }
+}
+
+void track_free(Memory_Stats *stats, Memory_Allocator *allocator, Memory_Array_Snapshot array, char const *file, u32 line) {
+    if (!array.data)
+        return;
+
+    u64 byte_count = array.count * array.item_size;
+
+    u32 allocator_index = get_memory_allocator_index(stats, allocator);
+    auto allocator_stats = stats->allocators + allocator_index;
+    allocator_stats->live_byte_count -= min(byte_count, allocator_stats->live_byte_count);
+
+    auto site = get_memory_site(stats, file, line, allocator_index);
+    if (site) {
+        site->free_count++;
+        site->freed_byte_count += byte_count;
+    }
+}
+
+u8_array track_read_entire_file(Memory_Stats *stats, Platform_API *platform_api, string path, Memory_Allocator *allocator, char const *file, u32 line) {
+    auto result = platform_api->read_entire_file(path, allocator);
+
+    if (result.data)
+        track_allocation(stats, allocator, result.count, file, line);
+
+    return result;
+}
+
+#if defined MEMORY_STATS
+
+#define TRACK_GROW(allocator, array, item_count) \
+    [&]() { auto memory_before = get_memory_array_snapshot(array); auto memory_result = grow(allocator, array, item_count); track_grow(&global_memory_stats, allocator, memory_before, get_memory_array_snapshot(array), __FILE__, __LINE__); return memory_result; }()
+
+#define TRACK_GROW_ITEM(allocator, array, type) \
+    [&]() { auto memory_before = get_memory_array_snapshot(array); auto memory_result = grow_item(allocator, array, type); track_grow(&global_memory_stats, allocator, memory_before, get_memory_array_snapshot(array), __FILE__, __LINE__); return memory_result; }()
+
+#define TRACK_FREE_ARRAY(allocator, array) \
+    do { track_free(&global_memory_stats, allocator, get_memory_array_snapshot(array), __FILE__, __LINE__); free_array(allocator, array); } while (0)
+
+#define TRACK_READ_ENTIRE_FILE(platform_api, path, allocator) \
+    track_read_entire_file(&global_memory_stats, platform_api, path, allocator, __FILE__, __LINE__)
+
+#else
+
+#define TRACK_GROW(allocator, array, item_count)              grow(allocator, array, item_count)
+#define TRACK_GROW_ITEM(allocator, array, type)               grow_item(allocator, array, type)
+#define TRACK_FREE_ARRAY(allocator, array)                    free_array(allocator, array)
+#define TRACK_READ_ENTIRE_FILE(platform_api, path, allocator) (platform_api)->read_entire_file(path, allocator)
+
+#endif
+
+// at the start of every frame, with how much of the per frame scratch arena the last frame used.
+// the caller resets the arena afterwards
+void begin_memory_frame(Memory_Stats *stats, u32 frame_arena_used, u32 frame_arena_capacity) {
+    stats->frame_arena_capacity = frame_arena_capacity;
+
+    if (stats->frame_count) {
+        stats->last_frame_arena_used = frame_arena_used;
+        stats->max_frame_arena_used  = max(stats->max_frame_arena_used, frame_arena_used);
+    }
+
+    for (u32 i = 0; i <= Memory_Stats_Max_Allocator_Count; i++) {
+        auto allocator_stats = stats->allocators + i;
+
+        if (stats->frame_count) {
+            allocator_stats->last_frame_allocation_count     = allocator_stats->frame_allocation_count;
+            allocator_stats->last_frame_allocated_byte_count = allocator_stats->frame_allocated_byte_count;
+            allocator_stats->last_frame_peak_byte_count      = allocator_stats->frame_peak_byte_count;
+            allocator_stats->max_frame_peak_byte_count       = max(allocator_stats->max_frame_peak_byte_count, allocator_stats->frame_peak_byte_count);
+        }
+
+        allocator_stats->frame_allocation_count     = 0;
+        allocator_stats->frame_allocated_byte_count = 0;
+        allocator_stats->frame_peak_byte_count      = allocator_stats->live_byte_count;
+    }
+
+    stats->frame_count++;
+}
+
+// writes the indices of the used sites to site_indices, by allocated bytes, largest first
+u32 get_memory_sites_by_size(Memory_Stats const *stats, u32 *site_indices) {
+    u32 count = 0;
+
+    for (u32 i = 0; i < Memory_Stats_Max_Site_Count; i++) {
+        if (!stats->sites[i].file)
+            continue;
+
+        u64 byte_count = stats->sites[i].allocated_byte_count;
+
+        u32 j = count++;
+        for (; (j > 0) && (stats->sites[site_indices[j - 1]].allocated_byte_count < byte_count); j--)
+            site_indices[j] = site_indices[j - 1];
+
+        site_indices[j] = i;
+    }
+
+    return count;
+}
+
+// without its directories
+char const * get_memory_site_file_name(Memory_Site const *site) {
+    char const *name = site->file;
+    for (char const *it = site->file; *it; it++) {
+        if ((*it == '/') || (*it == '\\'))
+            name = it + 1;
+    }
+
+    return name;
+}
+
+// a text report of all allocators and sites, site_indices needs room for Memory_Stats_Max_Site_Count
+void write_memory_stats(Memory_Stats const *stats, Platform_API *platform_api, string path, u32 *site_indices) {
+    char report_buffer[32 << 10];
+    auto report = make_report(report_buffer, sizeof(report_buffer));
+
+    report_write(&report, "memory stats after %u frames, in bytes\n\n%-12s %12s %12s %12s %12s %10s %10s %12s\n",
+                 stats->frame_count, "allocator", "live", "startup peak", "frame peak", "max frame", "allocs", "copies", "copied");
+
+    for (u32 i = 0; i <= Memory_Stats_Max_Allocator_Count; i++) {
+        auto allocator_stats = stats->allocators + i;
+        if ((i >= stats->allocator_count) && (i < Memory_Stats_Max_Allocator_Count))
+            continue;
+
+        if ((i == Memory_Stats_Max_Allocator_Count) && !allocator_stats->allocation_count)
+            continue;
+
+        report_write(&report, "%-12.*s %12llu %12llu %12llu %12llu %10u %10u %12llu\n",
+                     cast_v(int, allocator_stats->name.count), cast_p(char const, allocator_stats->name.data),
+                     cast_v(unsigned long long, allocator_stats->live_byte_count), cast_v(unsigned long long, allocator_stats->startup_peak_byte_count),
+                     cast_v(unsigned long long, allocator_stats->last_frame_peak_byte_count), cast_v(unsigned long long, allocator_stats->max_frame_peak_byte_count),
+                     allocator_stats->allocation_count, allocator_stats->grow_copy_count, cast_v(unsigned long long, allocator_stats->copied_byte_count));
+    }
+
+    report_write(&report, "\nframe scratch arena: %u last frame, %u max, %u capacity\n", stats->last_frame_arena_used, stats->max_frame_arena_used, stats->frame_arena_capacity);
+
+    if (stats->untracked_site_call_count)
+        report_write(&report, "%u calls past the site table\n", stats->untracked_site_call_count);
+
+    report_write(&report, "\n%-32s %-12s %10s %14s %8s %14s %8s %12s\n", "site", "allocator", "allocs", "bytes", "frees", "freed", "copies", "copied");
+
+    u32 site_count = get_memory_sites_by_size(stats, site_indices);
+    for (u32 i = 0; i < site_count; i++) {
+        auto site = stats->sites + site_indices[i];
+        auto allocator_name = stats->allocators[site->allocator_index].name;
+
+        char location[64];
+        snprintf(location, sizeof(location), "%s:%u", get_memory_site_file_name(site), site->line);
+
+        report_write(&report, "%-32s %-12.*s %10u %14llu %8u %14llu %8u %12llu\n",
+                     location, cast_v(int, allocator_name.count), cast_p(char const, allocator_name.data),
+                     site->allocation_count, cast_v(unsigned long long, site->allocated_byte_count),
+                     site->free_count, cast_v(unsigned long long, site->freed_byte_count),
+                     site->grow_copy_count, cast_v(unsigned long long, site->copied_byte_count));
+
+        if (report_is_full(&report))
+            break;
+    }
+
+    write_report(&report, platform_api, path);
+}
+
+#endif // MEMORY_STATS_H
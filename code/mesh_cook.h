@@ -0,0 +1,1343 @@
+#if !defined MESH_COOK_H
+#define MESH_COOK_H
+
+// cooked meshs (.glmb)
+// the text .glm format is parsed once by cook_glm and written as a binary blob,
+// which is mapped at startup and handed to glBufferData without any parsing.
+// debug builds (DEBUG) write the .glmb whenever they had to cook the text file, so shipped data is never parsed.
+//
+// blob layout (all sections start at a multiple of Cooked_Mesh_Alignment):
+//   Cooked_Mesh_Header
+//   Cooked_Vertex_Buffer    [vertex_buffer_count]
+//   Cooked_Vertex_Attribute [attribute_count]
+//   Cooked_Draw_Call        [draw_call_count * Gpu_Mesh_Max_Lod_Count], lod i starts at i * draw_call_count
+//   vertex data per vertex buffer (interleaved, see stride)
+//   index data (u16 or u32, see index_type), the indices of lod 0 followed by the ones of the other lods
+//
+// lods are simplified index lists of the same vertices (see glm_build_lods and mesh_simplify.h).
+// glm_optimize then reorders triangles and vertices and quantizes positions and normals (see Mesh_Cook_Flag and mesh_optimize.h)
+
+#include <stdlib.h>
+
+#include "demo_platform.h"
+#include "jobs.h"
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+
+u32 const Cooked_Mesh_Magic     = 'G' | ('L' << 8) | ('M' << 16) | ('B' << 24);
+u32 const Cooked_Mesh_Version   = 4;
+u32 const Cooked_Mesh_Alignment = 64;
+
+u32 const Gpu_Mesh_Max_Vertex_Buffer_Count = 4;
+u32 const Gpu_Mesh_Max_Draw_Call_Count     = 8;
+u32 const Gpu_Mesh_Max_Lod_Count           = 4;
+
+enum Mesh_Cook_Flag {
+    // reorders triangles for the post transform cache and vertices for fetch locality
+    Mesh_Cook_Optimize_Order = 1 << 0,
+
+    // positions become 16 bit normalized relative to the bounds and normals 10_10_10_2 normalized.
+    // shaders read them as before, but draws have to use get_vertex_to_world instead of object_to_world
+    Mesh_Cook_Quantize = 1 << 1,
+};
+
+u32 const Mesh_Cook_Default_Flags = Mesh_Cook_Optimize_Order | Mesh_Cook_Quantize;
+
+struct Cooked_Vertex_Attribute {
+    char name[16];
+    u32 gl_type;
+    u32 length;
+    u32 offset;
+    u32 is_normalized;
+    u32 is_integer;
+};
+
+struct Cooked_Vertex_Buffer {
+    u32 vertex_count;
+    u32 stride;
+    u32 attribute_offset;
+    u32 attribute_count;
+    u32 data_offset;
+    u32 data_size;
+};
+
+struct Cooked_Draw_Call {
+    u32 gl_mode;
+    u32 index_offset;
+    u32 index_count;
+};
+
+struct Cooked_Mesh_Header {
+    u32 magic;
+    u32 version;
+    u32 size;
+
+    u32 vertex_buffer_count;
+    u32 attribute_count;
+    u32 draw_call_count;
+
+    u32 index_count;
+    u32 index_type;
+    u32 index_data_offset;
+    u32 index_data_size;
+
+    // of attribute 0 (the position), for culling
+    f32 bounding_box_min[3];
+    f32 bounding_box_max[3];
+    f32 bounding_sphere_center[3];
+    f32 bounding_sphere_radius;
+
+    // lod 0 is the full mesh, errors are object space distances
+    u32 lod_count;
+    f32 lod_errors[Gpu_Mesh_Max_Lod_Count];
+
+    // Mesh_Cook_Flag, a cooked file with other flags than requested is cooked again
+    u32 cook_flags;
+
+    // object space position = vertex position * position_scale + position_offset
+    f32 position_offset[3];
+    f32 position_scale;
+
+    // of lod 0, before and after glm_optimize
+    f32 acmr_before;
+    f32 acmr_after;
+    u32 vertex_size_before;
+    u32 vertex_size_after;
+};
+
+struct Gpu_Mesh {
+    GLuint vertex_array_object;
+    GLuint vertex_buffer_objects[Gpu_Mesh_Max_Vertex_Buffer_Count];
+    u32 vertex_buffer_count;
+    GLuint index_buffer_object;
+    GLenum index_type;
+
+    // per lod, with the same count in every lod
+    Cooked_Draw_Call draw_calls[Gpu_Mesh_Max_Lod_Count][Gpu_Mesh_Max_Draw_Call_Count];
+    u32 draw_call_count;
+
+    u32 lod_count;
+    f32 lod_errors[Gpu_Mesh_Max_Lod_Count];
+    u32 lod_index_counts[Gpu_Mesh_Max_Lod_Count];
+
+    vec3f bounding_sphere_center;
+    f32 bounding_sphere_radius;
+
+    // dequantization of the positions, see get_vertex_to_world
+    vec3f position_offset;
+    f32 position_scale;
+};
+
+// the transform to draw a mesh with, folds the dequantization of its positions into object_to_world.
+// the scale is uniform, so normals keep their direction
+inline mat4x3f get_vertex_to_world(Gpu_Mesh const *mesh, mat4x3f object_to_world) {
+    mat4x3f result;
+    for (u32 i = 0; i < 3; i++)
+        result.columns[i] = object_to_world.columns[i] * mesh->position_scale;
+
+    result.columns[3] = transform_point(object_to_world, mesh->position_offset);
+
+    return result;
+}
+
+inline u32 align_up(u32 value, u32 alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// byte offset into the bound buffer, as gl expects it
+inline void * buffer_offset(u32 offset) {
+    return cast_p(u8, 0) + offset;
+}
+
+// text parsing
+
+struct Glm_Parser {
+    u8 *it;
+    u8 *end;
+    bool ok;
+};
+
+inline bool glm_is_space(u8 c) {
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+string glm_next_token(Glm_Parser *parser) {
+    while (parser->it < parser->end) {
+        if (glm_is_space(*parser->it)) {
+            parser->it++;
+        }
+        else if (*parser->it == '#') {
+            while ((parser->it < parser->end) && (*parser->it != '\n'))
+                parser->it++;
+        }
+        else {
+            break;
+        }
+    }
+
+    string token = {};
+    token.data = parser->it;
+
+    if ((parser->it < parser->end) && ((*parser->it == '{') || (*parser->it == '}'))) {
+        parser->it++;
+    }
+    else {
+        while ((parser->it < parser->end) && !glm_is_space(*parser->it) && (*parser->it != '{') && (*parser->it != '}') && (*parser->it != '#'))
+            parser->it++;
+    }
+
+    token.count = cast_v(u32, parser->it - token.data);
+
+    if (!token.count)
+        parser->ok = false;
+
+    return token;
+}
+
+string glm_peek_token(Glm_Parser *parser) {
+    Glm_Parser backup = *parser;
+    string token = glm_next_token(parser);
+    *parser = backup;
+
+    return token;
+}
+
+bool glm_token_equals(string token, char const *text) {
+    u32 count = cast_v(u32, strlen(text));
+    return (token.count == count) && (memcmp(token.data, text, count) == 0);
+}
+
+void glm_expect(Glm_Parser *parser, char const *text) {
+    if (!glm_token_equals(glm_next_token(parser), text))
+        parser->ok = false;
+}
+
+f64 glm_parse_number(Glm_Parser *parser) {
+    string token = glm_next_token(parser);
+
+    char buffer[64];
+    if (!parser->ok || !copy_to_c_string(buffer, sizeof(buffer), token)) {
+        parser->ok = false;
+        return 0;
+    }
+
+    char *number_end;
+    f64 value = strtod(buffer, &number_end);
+    if (number_end != buffer + token.count)
+        parser->ok = false;
+
+    return value;
+}
+
+u32 glm_parse_u32(Glm_Parser *parser) {
+    f64 value = glm_parse_number(parser);
+    if ((value < 0) || (value > 0xFFFFFFFF) || (value != cast_v(u32, value)))
+        parser->ok = false;
+
+    return cast_v(u32, value);
+}
+
+struct Glm_Type_Info {
+    char const *name;
+    GLenum gl_type;
+    u32 byte_count;
+    bool is_integer;
+};
+
+Glm_Type_Info const Glm_Types[] = {
+    { "f32", GL_FLOAT,          4, false },
+    { "u8",  GL_UNSIGNED_BYTE,  1, true },
+    { "u16", GL_UNSIGNED_SHORT, 2, true },
+    { "u32", GL_UNSIGNED_INT,   4, true },
+    { "s8",  GL_BYTE,           1, true },
+    { "s16", GL_SHORT,          2, true },
+    { "s32", GL_INT,            4, true },
+};
+
+Glm_Type_Info const * glm_find_type(string token) {
+    for (u32 i = 0; i < ARRAY_COUNT(Glm_Types); i++) {
+        if (glm_token_equals(token, Glm_Types[i].name))
+            return Glm_Types + i;
+    }
+
+    return 0;
+}
+
+struct Glm_Draw_Mode {
+    char const *name;
+    GLenum gl_mode;
+};
+
+Glm_Draw_Mode const Glm_Draw_Modes[] = {
+    { "triangles",      GL_TRIANGLES },
+    { "triangle_strip", GL_TRIANGLE_STRIP },
+    { "lines",          GL_LINES },
+    { "points",         GL_POINTS },
+};
+
+void glm_write_value(u8 *destination, Glm_Type_Info const *type, f64 value) {
+    switch (type->gl_type) {
+        case GL_FLOAT:          *cast_p(f32, destination) = cast_v(f32, value); break;
+        case GL_UNSIGNED_BYTE:  *cast_p(u8,  destination) = cast_v(u8,  value); break;
+        case GL_UNSIGNED_SHORT: *cast_p(u16, destination) = cast_v(u16, value); break;
+        case GL_UNSIGNED_INT:   *cast_p(u32, destination) = cast_v(u32, value); break;
+        case GL_BYTE:           *cast_p(s8,  destination) = cast_v(s8,  value); break;
+        case GL_SHORT:          *cast_p(s16, destination) = cast_v(s16, value); break;
+        case GL_INT:            *cast_p(s32, destination) = cast_v(s32, value); break;
+    }
+}
+
+struct Glm_Layout {
+    Cooked_Mesh_Header      header;
+    Cooked_Vertex_Buffer    vertex_buffers[Gpu_Mesh_Max_Vertex_Buffer_Count];
+    Cooked_Vertex_Attribute attributes[16];
+    Glm_Type_Info const *   attribute_types[16];
+    Cooked_Draw_Call        draw_calls[Gpu_Mesh_Max_Draw_Call_Count * Gpu_Mesh_Max_Lod_Count];
+    u32 max_vertex_count;
+};
+
+// without a blob only the declarations are read and the values are skipped,
+// with a blob the values are written to the offsets computed from the first pass
+bool glm_parse_pass(Glm_Layout *layout, u8_array source, u8 *blob) {
+    Glm_Parser parser = { source.data, source.data + source.count, true };
+
+    auto header = &layout->header;
+    header->attribute_count = 0;
+
+    glm_expect(&parser, "vertex_buffers");
+    header->vertex_buffer_count = glm_parse_u32(&parser);
+    glm_expect(&parser, "{");
+
+    if (header->vertex_buffer_count > Gpu_Mesh_Max_Vertex_Buffer_Count)
+        return false;
+
+    for (u32 buffer_index = 0; parser.ok && (buffer_index < header->vertex_buffer_count); buffer_index++) {
+        auto vertex_buffer = layout->vertex_buffers + buffer_index;
+
+        glm_expect(&parser, "vertex_buffer");
+        vertex_buffer->attribute_offset = header->attribute_count;
+        vertex_buffer->attribute_count  = glm_parse_u32(&parser);
+        vertex_buffer->stride = 0;
+        glm_expect(&parser, "{");
+
+        if (header->attribute_count + vertex_buffer->attribute_count > ARRAY_COUNT(layout->attributes))
+            return false;
+
+        for (u32 i = 0; parser.ok && (i < vertex_buffer->attribute_count); i++) {
+            auto attribute = layout->attributes + header->attribute_count;
+            *attribute = {};
+
+            string name = glm_next_token(&parser);
+            if (!copy_to_c_string(attribute->name, sizeof(attribute->name), name))
+                return false;
+
+            attribute->length = glm_parse_u32(&parser);
+
+            auto type = glm_find_type(glm_next_token(&parser));
+            if (!type || (attribute->length == 0) || (attribute->length > 4))
+                return false;
+
+            // the two trailing flags of an attribute declaration
+            attribute->is_normalized = glm_parse_u32(&parser);
+            glm_parse_u32(&parser);
+
+            attribute->gl_type    = type->gl_type;
+            attribute->is_integer = type->is_integer && !attribute->is_normalized;
+            attribute->offset     = vertex_buffer->stride;
+
+            layout->attribute_types[header->attribute_count] = type;
+            vertex_buffer->stride += attribute->length * type->byte_count;
+            header->attribute_count++;
+        }
+
+        glm_expect(&parser, "}");
+        vertex_buffer->vertex_count = glm_parse_u32(&parser);
+        glm_expect(&parser, "{");
+
+        layout->max_vertex_count = max(layout->max_vertex_count, vertex_buffer->vertex_count);
+
+        for (u32 vertex_index = 0; parser.ok && (vertex_index < vertex_buffer->vertex_count); vertex_index++) {
+            for (u32 i = 0; i < vertex_buffer->attribute_count; i++) {
+                u32 attribute_index = vertex_buffer->attribute_offset + i;
+                auto attribute = layout->attributes + attribute_index;
+                auto type = layout->attribute_types[attribute_index];
+
+                // non float values are prefixed with their type and length
+                if (type->gl_type != GL_FLOAT) {
+                    glm_expect(&parser, type->name);
+                    if (glm_parse_u32(&parser) != attribute->length)
+                        parser.ok = false;
+                }
+
+                if (blob) {
+                    u8 *destination = blob + vertex_buffer->data_offset + vertex_index * vertex_buffer->stride + attribute->offset;
+                    for (u32 component = 0; component < attribute->length; component++)
+                        glm_write_value(destination + component * type->byte_count, type, glm_parse_number(&parser));
+                }
+                else {
+                    for (u32 component = 0; component < attribute->length; component++)
+                        glm_next_token(&parser);
+                }
+            }
+        }
+
+        glm_expect(&parser, "}");
+    }
+
+    glm_expect(&parser, "}");
+
+    glm_expect(&parser, "indices");
+    header->index_count = glm_parse_u32(&parser);
+    glm_expect(&parser, "{");
+
+    for (u32 i = 0; parser.ok && (i < header->index_count); i++) {
+        if (blob) {
+            u32 index = glm_parse_u32(&parser);
+            if (index >= layout->max_vertex_count)
+                parser.ok = false;
+
+            if (header->index_type == GL_UNSIGNED_SHORT)
+                cast_p(u16, blob + header->index_data_offset)[i] = cast_v(u16, index);
+            else
+                cast_p(u32, blob + header->index_data_offset)[i] = index;
+        }
+        else {
+            glm_next_token(&parser);
+        }
+    }
+
+    glm_expect(&parser, "}");
+
+    // skeletons are not used by the demo and are not cooked
+    if (glm_token_equals(glm_peek_token(&parser), "bones")) {
+        glm_next_token(&parser);
+        glm_parse_u32(&parser);
+        glm_expect(&parser, "{");
+
+        while (parser.ok && !glm_token_equals(glm_next_token(&parser), "}"));
+    }
+
+    glm_expect(&parser, "draw_calls");
+    header->draw_call_count = glm_parse_u32(&parser);
+    glm_expect(&parser, "{");
+
+    if (header->draw_call_count > Gpu_Mesh_Max_Draw_Call_Count)
+        return false;
+
+    for (u32 i = 0; parser.ok && (i < header->draw_call_count); i++) {
+        auto draw_call = layout->draw_calls + i;
+        string mode = glm_next_token(&parser);
+
+        draw_call->gl_mode = GL_INVALID_ENUM;
+        for (u32 mode_index = 0; mode_index < ARRAY_COUNT(Glm_Draw_Modes); mode_index++) {
+            if (glm_token_equals(mode, Glm_Draw_Modes[mode_index].name))
+                draw_call->gl_mode = Glm_Draw_Modes[mode_index].gl_mode;
+        }
+
+        draw_call->index_offset = glm_parse_u32(&parser);
+        draw_call->index_count  = glm_parse_u32(&parser);
+
+        if ((draw_call->gl_mode == GL_INVALID_ENUM) || (draw_call->index_offset + draw_call->index_count > header->index_count))
+            parser.ok = false;
+    }
+
+    glm_expect(&parser, "}");
+
+    return parser.ok;
+}
+
+// first half of cooking: reads the declarations and computes the blob layout,
+// returns the blob size or 0 if the source is malformed
+u32 glm_measure(Glm_Layout *layout, u8_array source) {
+    *layout = {};
+    if (!glm_parse_pass(layout, source, 0))
+        return 0;
+
+    auto header = &layout->header;
+    header->magic   = Cooked_Mesh_Magic;
+    header->version = Cooked_Mesh_Version;
+
+    u32 index_byte_count;
+    if (layout->max_vertex_count <= 0x10000) {
+        header->index_type = GL_UNSIGNED_SHORT;
+        index_byte_count = sizeof(u16);
+    }
+    else {
+        header->index_type = GL_UNSIGNED_INT;
+        index_byte_count = sizeof(u32);
+    }
+
+    u32 offset = sizeof(Cooked_Mesh_Header);
+    offset += header->vertex_buffer_count * sizeof(Cooked_Vertex_Buffer);
+    offset += header->attribute_count * sizeof(Cooked_Vertex_Attribute);
+    offset += header->draw_call_count * Gpu_Mesh_Max_Lod_Count * sizeof(Cooked_Draw_Call);
+
+    for (u32 i = 0; i < header->vertex_buffer_count; i++) {
+        auto vertex_buffer = layout->vertex_buffers + i;
+
+        offset = align_up(offset, Cooked_Mesh_Alignment);
+        vertex_buffer->data_offset = offset;
+        vertex_buffer->data_size   = vertex_buffer->vertex_count * vertex_buffer->stride;
+        offset += vertex_buffer->data_size;
+    }
+
+    // every lod has at most the indices of lod 0, glm_build_lods shrinks both sizes to what is used
+    offset = align_up(offset, Cooked_Mesh_Alignment);
+    header->index_data_offset = offset;
+    header->index_data_size   = header->index_count * index_byte_count * Gpu_Mesh_Max_Lod_Count;
+    offset += header->index_data_size;
+
+    header->size = align_up(offset, Cooked_Mesh_Alignment);
+
+    return header->size;
+}
+
+// axis aligned box and a sphere around it, tightened to the farthest vertex.
+// attribute 0 is the position, if it is not 3 floats the bounds stay empty
+void glm_compute_bounds(Glm_Layout *layout, u8 *blob) {
+    auto header = &layout->header;
+    auto vertex_buffer = layout->vertex_buffers;
+    auto attribute = layout->attributes;
+
+    if (!header->vertex_buffer_count || !vertex_buffer->attribute_count || (attribute->gl_type != GL_FLOAT) || (attribute->length < 3) || !vertex_buffer->vertex_count)
+        return;
+
+    u8 *positions = blob + vertex_buffer->data_offset + attribute->offset;
+
+    for (u32 axis = 0; axis < 3; axis++) {
+        header->bounding_box_min[axis] =  3.4e38f;
+        header->bounding_box_max[axis] = -3.4e38f;
+    }
+
+    for (u32 i = 0; i < vertex_buffer->vertex_count; i++) {
+        auto position = cast_p(f32, positions + i * vertex_buffer->stride);
+
+        for (u32 axis = 0; axis < 3; axis++) {
+            header->bounding_box_min[axis] = min(header->bounding_box_min[axis], position[axis]);
+            header->bounding_box_max[axis] = max(header->bounding_box_max[axis], position[axis]);
+        }
+    }
+
+    for (u32 axis = 0; axis < 3; axis++)
+        header->bounding_sphere_center[axis] = (header->bounding_box_min[axis] + header->bounding_box_max[axis]) * 0.5f;
+
+    f32 max_squared_distance = 0;
+    for (u32 i = 0; i < vertex_buffer->vertex_count; i++) {
+        auto position = cast_p(f32, positions + i * vertex_buffer->stride);
+
+        f32 squared_distance = 0;
+        for (u32 axis = 0; axis < 3; axis++) {
+            f32 delta = position[axis] - header->bounding_sphere_center[axis];
+            squared_distance += delta * delta;
+        }
+
+        max_squared_distance = max(max_squared_distance, squared_distance);
+    }
+
+    header->bounding_sphere_radius = sqrtf(max_squared_distance);
+}
+
+inline bool glm_has_triangle_positions(Glm_Layout const *layout) {
+    auto header = &layout->header;
+    auto vertex_buffer = layout->vertex_buffers;
+    auto attribute = layout->attributes;
+
+    // indices reach every vertex buffer, so the positions have to cover all of them
+    return header->vertex_buffer_count && vertex_buffer->attribute_count && (attribute->gl_type == GL_FLOAT) && (attribute->length >= 3) && (vertex_buffer->vertex_count == layout->max_vertex_count);
+}
+
+u32 glm_get_largest_triangle_draw_call(Glm_Layout const *layout) {
+    u32 index_count = 0;
+    for (u32 i = 0; i < layout->header.draw_call_count; i++) {
+        if (layout->draw_calls[i].gl_mode == GL_TRIANGLES)
+            index_count = max(index_count, layout->draw_calls[i].index_count);
+    }
+
+    return index_count;
+}
+
+// scratch memory of glm_cook, call after glm_measure
+u32 glm_get_scratch_size(Glm_Layout const *layout) {
+    u32 index_count = glm_get_largest_triangle_draw_call(layout);
+    u32 vertex_count = layout->max_vertex_count;
+
+    u32 lod_size = 0;
+    if (index_count)
+        lod_size = get_simplify_scratch_size(vertex_count, index_count) + 2 * index_count * sizeof(u32) + 32;
+
+    // all lods as u32 indices, stamps or remap, one vertex buffer copy
+    u32 max_vertex_data_size = 0;
+    for (u32 i = 0; i < layout->header.vertex_buffer_count; i++)
+        max_vertex_data_size = max(max_vertex_data_size, layout->vertex_buffers[i].vertex_count * layout->vertex_buffers[i].stride);
+
+    u32 optimize_size = layout->header.index_count * Gpu_Mesh_Max_Lod_Count * sizeof(u32) + 2 * vertex_count * sizeof(u32) + max_vertex_data_size + 64;
+    optimize_size += max(get_vertex_cache_scratch_size(vertex_count, index_count), max_vertex_data_size);
+
+    return max(lod_size, optimize_size);
+}
+
+// lod i + 1 simplifies the triangle draw calls of lod i to half their triangles.
+// stops at Gpu_Mesh_Max_Lod_Count or once a lod saves less than a quarter of the indices,
+// then shrinks header.size to the used part of the blob
+void glm_build_lods(Glm_Layout *layout, u8 *blob, Job_Arena *scratch) {
+    auto header = &layout->header;
+    u32 index_byte_count = (header->index_type == GL_UNSIGNED_SHORT) ? sizeof(u16) : sizeof(u32);
+
+    header->lod_count = 1;
+    header->lod_errors[0] = 0;
+
+    u32 used_index_count = header->index_count;
+    u32 max_index_count  = glm_get_largest_triangle_draw_call(layout);
+
+    if (glm_has_triangle_positions(layout) && max_index_count) {
+        u32 scratch_mark = scratch->used;
+        defer { scratch->used = scratch_mark; };
+
+        auto source     = ARENA_PUSH_ARRAY(scratch, u32, max_index_count);
+        auto simplified = ARENA_PUSH_ARRAY(scratch, u32, max_index_count);
+
+        auto vertex_buffer = layout->vertex_buffers;
+        auto positions = cast_p(f32 const, blob + vertex_buffer->data_offset + layout->attributes[0].offset);
+        u8 *index_data = blob + header->index_data_offset;
+
+        for (u32 lod = 1; lod < Gpu_Mesh_Max_Lod_Count; lod++) {
+            auto previous = layout->draw_calls + (lod - 1) * header->draw_call_count;
+            auto current  = layout->draw_calls + lod * header->draw_call_count;
+
+            u32 lod_index_offset     = used_index_count;
+            u32 previous_index_count = 0;
+            u32 current_index_count  = 0;
+            f32 lod_error = 0;
+
+            for (u32 i = 0; i < header->draw_call_count; i++) {
+                current[i] = previous[i];
+                previous_index_count += previous[i].index_count;
+
+                // other modes draw the same indices in every lod
+                if (previous[i].gl_mode != GL_TRIANGLES) {
+                    current_index_count += previous[i].index_count;
+                    continue;
+                }
+
+                u32 count = previous[i].index_count;
+                for (u32 j = 0; j < count; j++) {
+                    u32 index = previous[i].index_offset + j;
+                    source[j] = (header->index_type == GL_UNSIGNED_SHORT) ? cast_p(u16, index_data)[index] : cast_p(u32, index_data)[index];
+                }
+
+                f32 error;
+                u32 target_count = (count / 6) * 3;
+                u32 simplified_count = simplify_triangles(simplified, source, count, positions, vertex_buffer->stride, vertex_buffer->vertex_count, target_count, &error, scratch);
+
+                current[i].index_offset = used_index_count;
+                current[i].index_count  = simplified_count;
+
+                for (u32 j = 0; j < simplified_count; j++) {
+                    if (header->index_type == GL_UNSIGNED_SHORT)
+                        cast_p(u16, index_data)[used_index_count + j] = cast_v(u16, simplified[j]);
+                    else
+                        cast_p(u32, index_data)[used_index_count + j] = simplified[j];
+                }
+
+                used_index_count    += simplified_count;
+                current_index_count += simplified_count;
+                lod_error = max(lod_error, error);
+            }
+
+            // a lod that keeps more than three quarters of the indices of the previous one is not worth its memory.
+            // its indices are given back and its draw calls cleared, so no draw call past lod_count points at them
+            if (current_index_count * 4 > previous_index_count * 3) {
+                used_index_count = lod_index_offset;
+                memset(current, 0, header->draw_call_count * sizeof(*current));
+                break;
+            }
+
+            // errors of consecutive simplifications add up at most
+            header->lod_errors[lod] = header->lod_errors[lod - 1] + lod_error;
+            header->lod_count++;
+        }
+    }
+
+    // the draw calls past lod_count are zero, the rejected lod's were cleared above
+    header->index_data_size = used_index_count * index_byte_count;
+    header->size = align_up(header->index_data_offset + header->index_data_size, Cooked_Mesh_Alignment);
+}
+
+// post transform cache misses per triangle of the lod 0 triangle draw calls, each starts with an empty cache
+f32 glm_get_acmr(Glm_Layout const *layout, u32 const *indices, u32 *stamps) {
+    u32 miss_count     = 0;
+    u32 triangle_count = 0;
+
+    for (u32 i = 0; i < layout->header.draw_call_count; i++) {
+        auto draw_call = layout->draw_calls + i;
+        if (draw_call->gl_mode != GL_TRIANGLES)
+            continue;
+
+        miss_count     += count_vertex_cache_misses(indices + draw_call->index_offset, draw_call->index_count, layout->max_vertex_count, stamps);
+        triangle_count += draw_call->index_count / 3;
+    }
+
+    return triangle_count ? cast_v(f32, miss_count) / triangle_count : 0.0f;
+}
+
+u32 glm_get_vertex_size(Glm_Layout const *layout) {
+    u32 size = 0;
+    for (u32 i = 0; i < layout->header.vertex_buffer_count; i++)
+        size += layout->vertex_buffers[i].stride;
+
+    return size;
+}
+
+// attribute 0 as 3 normalized shorts relative to the bounds, attributes named normal with 3 floats as normalized 2_10_10_10,
+// other attributes keep their format. attributes start at multiples of 4 bytes.
+// a vertex buffer keeps its layout if the quantized one is not smaller
+void glm_quantize_vertices(Glm_Layout *layout, u8 *blob, Job_Arena *scratch) {
+    auto header = &layout->header;
+
+    // uniform scale, so the dequantization can be folded into the object transform without skewing normals.
+    // position_offset and position_scale stay 0 and 1 unless the positions are quantized
+    f32 half_extent = 0;
+    for (u32 axis = 0; axis < 3; axis++)
+        half_extent = max(half_extent, (header->bounding_box_max[axis] - header->bounding_box_min[axis]) * 0.5f);
+
+    bool can_quantize_position = (header->bounding_sphere_radius > 0) && (half_extent > 0);
+
+    for (u32 buffer_index = 0; buffer_index < header->vertex_buffer_count; buffer_index++) {
+        auto vertex_buffer = layout->vertex_buffers + buffer_index;
+
+        Cooked_Vertex_Attribute quantized[ARRAY_COUNT(layout->attributes)];
+        u32 quantized_stride = 0;
+        bool has_changes = false;
+        bool quantizes_position = false;
+
+        for (u32 i = 0; i < vertex_buffer->attribute_count; i++) {
+            u32 attribute_index = vertex_buffer->attribute_offset + i;
+            auto attribute = layout->attributes + attribute_index;
+            auto result = quantized + i;
+
+            *result = *attribute;
+            u32 byte_count = attribute->length * layout->attribute_types[attribute_index]->byte_count;
+
+            bool is_float3 = (attribute->gl_type == GL_FLOAT) && (attribute->length == 3);
+
+            if ((attribute_index == 0) && is_float3 && can_quantize_position) {
+                result->gl_type = GL_SHORT;
+                result->is_normalized = true;
+                byte_count = 3 * sizeof(s16);
+                has_changes = true;
+                quantizes_position = true;
+            }
+            else if (is_float3 && (strcmp(attribute->name, "normal") == 0)) {
+                // packed types always have 4 components, w is 0
+                result->gl_type = GL_INT_2_10_10_10_REV;
+                result->length = 4;
+                result->is_normalized = true;
+                byte_count = sizeof(u32);
+                has_changes = true;
+            }
+
+            result->offset = align_up(quantized_stride, 4);
+            quantized_stride = result->offset + byte_count;
+        }
+
+        quantized_stride = align_up(quantized_stride, 4);
+
+        if (!has_changes || (quantized_stride >= vertex_buffer->stride))
+            continue;
+
+        if (quantizes_position) {
+            for (u32 axis = 0; axis < 3; axis++)
+                header->position_offset[axis] = header->bounding_sphere_center[axis];
+
+            header->position_scale = half_extent;
+        }
+
+        u32 scratch_mark = scratch->used;
+        defer { scratch->used = scratch_mark; };
+
+        u8 *data = blob + vertex_buffer->data_offset;
+        u8 *source = arena_push(scratch, vertex_buffer->data_size);
+        memcpy(source, data, vertex_buffer->data_size);
+        memset(data, 0, vertex_buffer->data_size);
+
+        for (u32 vertex_index = 0; vertex_index < vertex_buffer->vertex_count; vertex_index++) {
+            u8 const *source_vertex = source + vertex_index * vertex_buffer->stride;
+            u8 *vertex = data + vertex_index * quantized_stride;
+
+            for (u32 i = 0; i < vertex_buffer->attribute_count; i++) {
+                u32 attribute_index = vertex_buffer->attribute_offset + i;
+                auto attribute = layout->attributes + attribute_index;
+                auto values = cast_p(f32 const, source_vertex + attribute->offset);
+                u8 *destination = vertex + quantized[i].offset;
+
+                if ((quantized[i].gl_type == GL_SHORT) && (attribute->gl_type == GL_FLOAT)) {
+                    for (u32 axis = 0; axis < 3; axis++)
+                        cast_p(s16, destination)[axis] = pack_snorm16((values[axis] - header->position_offset[axis]) / half_extent);
+                }
+                else if (quantized[i].gl_type == GL_INT_2_10_10_10_REV) {
+                    *cast_p(u32, destination) = pack_normal_2_10_10_10(values);
+                }
+                else {
+                    memcpy(destination, values, attribute->length * layout->attribute_types[attribute_index]->byte_count);
+                }
+            }
+        }
+
+        memcpy(layout->attributes + vertex_buffer->attribute_offset, quantized, vertex_buffer->attribute_count * sizeof(Cooked_Vertex_Attribute));
+        vertex_buffer->stride    = quantized_stride;
+        vertex_buffer->data_size = vertex_buffer->vertex_count * quantized_stride;
+    }
+}
+
+// call after glm_build_lods, flags are Mesh_Cook_Flag.
+// records the acmr and vertex size before and after, then packs the vertex and index data
+// down into the space quantization freed and shrinks header.size
+void glm_optimize(Glm_Layout *layout, u8 *blob, u32 flags, Job_Arena *scratch) {
+    auto header = &layout->header;
+    header->cook_flags = flags;
+    header->position_scale = 1;
+
+    for (u32 axis = 0; axis < 3; axis++)
+        header->position_offset[axis] = 0;
+
+    u32 index_byte_count = (header->index_type == GL_UNSIGNED_SHORT) ? sizeof(u16) : sizeof(u32);
+    u32 index_count  = header->index_data_size / index_byte_count;
+    u32 vertex_count = layout->max_vertex_count;
+    u8 *index_data   = blob + header->index_data_offset;
+
+    u32 scratch_mark = scratch->used;
+    defer { scratch->used = scratch_mark; };
+
+    // the indices of all lods as u32, written back at the end
+    auto indices = ARENA_PUSH_ARRAY(scratch, u32, index_count);
+    for (u32 i = 0; i < index_count; i++)
+        indices[i] = (header->index_type == GL_UNSIGNED_SHORT) ? cast_p(u16, index_data)[i] : cast_p(u32, index_data)[i];
+
+    auto stamps = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+    header->acmr_before        = glm_get_acmr(layout, indices, stamps);
+    header->vertex_size_before = glm_get_vertex_size(layout);
+
+    if (flags & Mesh_Cook_Optimize_Order) {
+        for (u32 lod = 0; lod < header->lod_count; lod++) {
+            for (u32 i = 0; i < header->draw_call_count; i++) {
+                auto draw_call = layout->draw_calls + lod * header->draw_call_count + i;
+
+                // the other modes share their indices between lods and depend on their order
+                if (draw_call->gl_mode == GL_TRIANGLES)
+                    optimize_vertex_cache(indices + draw_call->index_offset, draw_call->index_count, vertex_count, scratch);
+            }
+        }
+
+        // indices reach into every vertex buffer, so all of them need all vertices to be renumbered
+        bool can_remap = (vertex_count > 0);
+        for (u32 i = 0; i < header->vertex_buffer_count; i++)
+            can_remap &= (layout->vertex_buffers[i].vertex_count == vertex_count);
+
+        if (can_remap) {
+            // lod 0 comes first in the index data and uses every vertex the other lods use
+            auto remap = stamps;
+            get_vertex_fetch_remap(remap, indices, index_count, vertex_count);
+
+            for (u32 i = 0; i < index_count; i++)
+                indices[i] = remap[indices[i]];
+
+            for (u32 buffer_index = 0; buffer_index < header->vertex_buffer_count; buffer_index++) {
+                auto vertex_buffer = layout->vertex_buffers + buffer_index;
+
+                u32 buffer_mark = scratch->used;
+                u8 *data = blob + vertex_buffer->data_offset;
+                u8 *source = arena_push(scratch, vertex_buffer->data_size);
+                memcpy(source, data, vertex_buffer->data_size);
+
+                for (u32 i = 0; i < vertex_count; i++)
+                    memcpy(data + remap[i] * vertex_buffer->stride, source + i * vertex_buffer->stride, vertex_buffer->stride);
+
+                scratch->used = buffer_mark;
+            }
+        }
+    }
+
+    if (flags & Mesh_Cook_Quantize)
+        glm_quantize_vertices(layout, blob, scratch);
+
+    header->acmr_after        = glm_get_acmr(layout, indices, stamps);
+    header->vertex_size_after = glm_get_vertex_size(layout);
+
+    for (u32 i = 0; i < index_count; i++) {
+        if (header->index_type == GL_UNSIGNED_SHORT)
+            cast_p(u16, index_data)[i] = cast_v(u16, indices[i]);
+        else
+            cast_p(u32, index_data)[i] = indices[i];
+    }
+
+    // sections only move down, in the order of the blob
+    u32 offset = sizeof(Cooked_Mesh_Header);
+    offset += header->vertex_buffer_count * sizeof(Cooked_Vertex_Buffer);
+    offset += header->attribute_count * sizeof(Cooked_Vertex_Attribute);
+    offset += header->draw_call_count * Gpu_Mesh_Max_Lod_Count * sizeof(Cooked_Draw_Call);
+
+    for (u32 i = 0; i < header->vertex_buffer_count; i++) {
+        auto vertex_buffer = layout->vertex_buffers + i;
+
+        offset = align_up(offset, Cooked_Mesh_Alignment);
+        memmove(blob + offset, blob + vertex_buffer->data_offset, vertex_buffer->data_size);
+        vertex_buffer->data_offset = offset;
+        offset += vertex_buffer->data_size;
+    }
+
+    offset = align_up(offset, Cooked_Mesh_Alignment);
+    memmove(blob + offset, index_data, header->index_data_size);
+    header->index_data_offset = offset;
+    offset += header->index_data_size;
+
+    // the end of the blob stays zero, so cooking the same source gives the same file
+    u32 size = align_up(offset, Cooked_Mesh_Alignment);
+    memset(blob + offset, 0, header->size - offset);
+    header->size = size;
+}
+
+// second half of cooking: writes the blob of header.size bytes (as returned by glm_measure),
+// so the caller decides where the memory comes from.
+// scratch needs glm_get_scratch_size bytes, header.size shrinks to the bytes that are used.
+// flags are Mesh_Cook_Flag
+bool glm_cook(Glm_Layout *layout, u8_array source, u8 *blob, u32 flags, Job_Arena *scratch) {
+    auto header = &layout->header;
+    memset(blob, 0, header->size);
+
+    if (!glm_parse_pass(layout, source, blob))
+        return false;
+
+    glm_compute_bounds(layout, blob);
+    glm_build_lods(layout, blob, scratch);
+    glm_optimize(layout, blob, flags, scratch);
+
+    u32 offset = 0;
+    memcpy(blob + offset, header, sizeof(*header));
+    offset += sizeof(*header);
+    memcpy(blob + offset, layout->vertex_buffers, header->vertex_buffer_count * sizeof(Cooked_Vertex_Buffer));
+    offset += header->vertex_buffer_count * sizeof(Cooked_Vertex_Buffer);
+    memcpy(blob + offset, layout->attributes, header->attribute_count * sizeof(Cooked_Vertex_Attribute));
+    offset += header->attribute_count * sizeof(Cooked_Vertex_Attribute);
+    memcpy(blob + offset, layout->draw_calls, header->draw_call_count * Gpu_Mesh_Max_Lod_Count * sizeof(Cooked_Draw_Call));
+
+    return true;
+}
+
+// parses a text .glm file and returns the cooked blob,
+// returns an empty array if the source is malformed.
+// the blob is the only allocation that outlives the call, so the transient stack stays in order.
+// the array may be larger than the cooked mesh, its size is in Cooked_Mesh_Header.size
+u8_array cook_glm(u8_array source, Memory_Allocator *allocator, u32 flags = Mesh_Cook_Default_Flags) {
+    u8_array result = {};
+
+    Glm_Layout layout;
+    u32 size = glm_measure(&layout, source);
+    if (!size)
+        return result;
+
+    u8 *blob = TRACK_GROW(allocator, &result, size);
+
+    u8_array scratch_memory = {};
+    Job_Arena scratch = {};
+    scratch.capacity = glm_get_scratch_size(&layout);
+    if (scratch.capacity)
+        scratch.base = TRACK_GROW(allocator, &scratch_memory, scratch.capacity);
+
+    bool ok = glm_cook(&layout, source, blob, flags, &scratch);
+
+    if (scratch.capacity)
+        TRACK_FREE_ARRAY(allocator, &scratch_memory);
+
+    if (!ok) {
+        TRACK_FREE_ARRAY(allocator, &result);
+        return {};
+    }
+
+    return result;
+}
+
+// cooked blob access
+
+struct Cooked_Mesh {
+    Cooked_Mesh_Header      *header;
+    Cooked_Vertex_Buffer    *vertex_buffers;
+    Cooked_Vertex_Attribute *attributes;
+    Cooked_Draw_Call        *draw_calls;
+    u8 *base;
+};
+
+// validates all offsets against the blob size, so a truncated or stale file is rejected
+bool read_cooked_mesh(Cooked_Mesh *cooked_mesh, u8_array blob) {
+    *cooked_mesh = {};
+
+    if (blob.count < sizeof(Cooked_Mesh_Header))
+        return false;
+
+    auto header = cast_p(Cooked_Mesh_Header, blob.data);
+    if ((header->magic != Cooked_Mesh_Magic) || (header->version != Cooked_Mesh_Version) || (header->size > blob.count))
+        return false;
+
+    if ((header->vertex_buffer_count > Gpu_Mesh_Max_Vertex_Buffer_Count) || (header->draw_call_count > Gpu_Mesh_Max_Draw_Call_Count) || !header->lod_count || (header->lod_count > Gpu_Mesh_Max_Lod_Count))
+        return false;
+
+    u32 offset = sizeof(Cooked_Mesh_Header);
+    cooked_mesh->vertex_buffers = cast_p(Cooked_Vertex_Buffer, blob.data + offset);
+    offset += header->vertex_buffer_count * sizeof(Cooked_Vertex_Buffer);
+    cooked_mesh->attributes = cast_p(Cooked_Vertex_Attribute, blob.data + offset);
+    offset += header->attribute_count * sizeof(Cooked_Vertex_Attribute);
+    cooked_mesh->draw_calls = cast_p(Cooked_Draw_Call, blob.data + offset);
+    offset += header->draw_call_count * Gpu_Mesh_Max_Lod_Count * sizeof(Cooked_Draw_Call);
+
+    if (offset > header->size)
+        return false;
+
+    for (u32 i = 0; i < header->vertex_buffer_count; i++) {
+        auto vertex_buffer = cooked_mesh->vertex_buffers + i;
+        if ((vertex_buffer->attribute_offset + vertex_buffer->attribute_count > header->attribute_count) ||
+            (cast_v(u64, vertex_buffer->data_offset) + vertex_buffer->data_size > header->size))
+            return false;
+    }
+
+    if (cast_v(u64, header->index_data_offset) + header->index_data_size > header->size)
+        return false;
+
+    cooked_mesh->header = header;
+    cooked_mesh->base   = blob.data;
+
+    return true;
+}
+
+// uploads straight from the blob, which is usually a file mapping
+bool make_gpu_mesh(Gpu_Mesh *mesh, u8_array blob) {
+    Cooked_Mesh cooked_mesh;
+    if (!read_cooked_mesh(&cooked_mesh, blob))
+        return false;
+
+    auto header = cooked_mesh.header;
+
+    *mesh = {};
+    glGenVertexArrays(1, &mesh->vertex_array_object);
+    glBindVertexArray(mesh->vertex_array_object);
+
+    mesh->vertex_buffer_count = header->vertex_buffer_count;
+    glGenBuffers(mesh->vertex_buffer_count, mesh->vertex_buffer_objects);
+
+    // attribute locations follow the declaration order in the .glm file
+    for (u32 buffer_index = 0; buffer_index < header->vertex_buffer_count; buffer_index++) {
+        auto vertex_buffer = cooked_mesh.vertex_buffers + buffer_index;
+
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer_objects[buffer_index]);
+        glBufferData(GL_ARRAY_BUFFER, vertex_buffer->data_size, cooked_mesh.base + vertex_buffer->data_offset, GL_STATIC_DRAW);
+
+        for (u32 i = 0; i < vertex_buffer->attribute_count; i++) {
+            u32 location = vertex_buffer->attribute_offset + i;
+            auto attribute = cooked_mesh.attributes + location;
+
+            glEnableVertexAttribArray(location);
+
+            if (attribute->is_integer)
+                glVertexAttribIPointer(location, attribute->length, attribute->gl_type, vertex_buffer->stride, buffer_offset(attribute->offset));
+            else
+                glVertexAttribPointer(location, attribute->length, attribute->gl_type, attribute->is_normalized ? GL_TRUE : GL_FALSE, vertex_buffer->stride, buffer_offset(attribute->offset));
+        }
+    }
+
+    glGenBuffers(1, &mesh->index_buffer_object);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer_object);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, header->index_data_size, cooked_mesh.base + header->index_data_offset, GL_STATIC_DRAW);
+    mesh->index_type = header->index_type;
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    mesh->draw_call_count = header->draw_call_count;
+    mesh->lod_count       = header->lod_count;
+
+    for (u32 lod = 0; lod < mesh->lod_count; lod++) {
+        memcpy(mesh->draw_calls[lod], cooked_mesh.draw_calls + lod * mesh->draw_call_count, mesh->draw_call_count * sizeof(Cooked_Draw_Call));
+
+        mesh->lod_errors[lod] = header->lod_errors[lod];
+        for (u32 i = 0; i < mesh->draw_call_count; i++)
+            mesh->lod_index_counts[lod] += mesh->draw_calls[lod][i].index_count;
+    }
+
+    mesh->bounding_sphere_center = vec3f{ header->bounding_sphere_center[0], header->bounding_sphere_center[1], header->bounding_sphere_center[2] };
+    mesh->bounding_sphere_radius = header->bounding_sphere_radius;
+
+    mesh->position_offset = vec3f{ header->position_offset[0], header->position_offset[1], header->position_offset[2] };
+    mesh->position_scale  = header->position_scale;
+
+    return true;
+}
+
+void free_gpu_mesh(Gpu_Mesh *mesh) {
+    glDeleteBuffers(1, &mesh->index_buffer_object);
+    glDeleteBuffers(mesh->vertex_buffer_count, mesh->vertex_buffer_objects);
+    glDeleteVertexArrays(1, &mesh->vertex_array_object);
+
+    *mesh = {};
+}
+
+// counts glDraw* calls, the main loop resets it once per frame
+u32 global_draw_call_count;
+
+void draw(Gpu_Mesh const &mesh, u32 lod = 0) {
+    glBindVertexArray(mesh.vertex_array_object);
+
+    u32 index_byte_count = (mesh.index_type == GL_UNSIGNED_SHORT) ? sizeof(u16) : sizeof(u32);
+
+    for (u32 i = 0; i < mesh.draw_call_count; i++) {
+        auto draw_call = mesh.draw_calls[lod] + i;
+        glDrawElements(draw_call->gl_mode, draw_call->index_count, mesh.index_type, buffer_offset(draw_call->index_offset * index_byte_count));
+    }
+
+    global_draw_call_count += mesh.draw_call_count;
+
+    glBindVertexArray(0);
+}
+
+void draw_instanced(Gpu_Mesh const &mesh, u32 instance_count, u32 lod = 0) {
+    glBindVertexArray(mesh.vertex_array_object);
+
+    u32 index_byte_count = (mesh.index_type == GL_UNSIGNED_SHORT) ? sizeof(u16) : sizeof(u32);
+
+    for (u32 i = 0; i < mesh.draw_call_count; i++) {
+        auto draw_call = mesh.draw_calls[lod] + i;
+        glDrawElementsInstanced(draw_call->gl_mode, draw_call->index_count, mesh.index_type, buffer_offset(draw_call->index_offset * index_byte_count), instance_count);
+    }
+
+    global_draw_call_count += mesh.draw_call_count;
+
+    glBindVertexArray(0);
+}
+
+// a cooked file is only used if it was cooked with the requested Mesh_Cook_Flag
+bool has_cook_flags(u8_array blob, u32 cook_flags) {
+    Cooked_Mesh cooked_mesh;
+    return read_cooked_mesh(&cooked_mesh, blob) && (cooked_mesh.header->cook_flags == cook_flags);
+}
+
+// threaded loading
+// a worker maps the cooked file (or cooks the text file into pages of its own, with scratch from its arena),
+// the main thread only calls make_gpu_mesh and finish_mesh_load_job.
+
+struct Mesh_Load_Job {
+    string glm_path;
+    string cooked_path;
+    u32 cook_flags;
+
+    Mapped_File mapped_file;
+    u8_array cooked;
+    bool was_cooked_from_text;
+
+    // of the blob cooked from the text file, freed by finish_mesh_load_job
+    u8_array cooked_pages;
+
+    u32 volatile is_done;
+};
+
+// reads one byte per page, so the page faults happen on the worker and not during the upload
+u32 touch_pages(u8_array data) {
+    u32 sum = 0;
+    for (u32 i = 0; i < data.count; i += 4096)
+        sum += data.data[i];
+
+    return sum;
+}
+
+void mesh_load_job(Job_Worker *worker, void *data) {
+    auto job = cast_p(Mesh_Load_Job, data);
+    job->cooked = {};
+    job->was_cooked_from_text = false;
+
+    if (map_file(&job->mapped_file, job->cooked_path)) {
+        if (has_cook_flags(job->mapped_file.data, job->cook_flags)) {
+            touch_pages(job->mapped_file.data);
+            job->cooked = job->mapped_file.data;
+        }
+        else {
+            unmap_file(&job->mapped_file);
+        }
+    }
+
+    if (!job->cooked.count) {
+        Mapped_File source;
+        if (map_file(&source, job->glm_path)) {
+            Glm_Layout layout;
+            u32 size = glm_measure(&layout, source.data);
+
+            if (size)
+                job->cooked_pages = allocate_pages(size);
+
+            if (job->cooked_pages.count) {
+                // meshs larger than the arena was made for get their scratch from the os as well
+                u32 scratch_size = glm_get_scratch_size(&layout);
+                auto scratch = &worker->arena;
+
+                Job_Arena page_arena = {};
+                u8_array scratch_pages = {};
+
+                if (!arena_can_push(scratch, scratch_size)) {
+                    scratch_pages = allocate_pages(scratch_size);
+                    page_arena.base     = scratch_pages.data;
+                    page_arena.capacity = scratch_pages.count;
+                    scratch = &page_arena;
+                }
+
+                if (arena_can_push(scratch, scratch_size) && glm_cook(&layout, source.data, job->cooked_pages.data, job->cook_flags, scratch)) {
+                    job->cooked.data  = job->cooked_pages.data;
+                    job->cooked.count = layout.header.size;
+                    job->was_cooked_from_text = true;
+                }
+
+                free_pages(&scratch_pages);
+            }
+
+            if (!job->cooked.count)
+                free_pages(&job->cooked_pages);
+
+            unmap_file(&source);
+        }
+    }
+
+    atomic_write(&job->is_done, 1);
+}
+
+void push_mesh_load_job(Job_System *jobs, Mesh_Load_Job *job, string glm_path, string cooked_path, u32 cook_flags = Mesh_Cook_Default_Flags) {
+    *job = {};
+    job->glm_path    = glm_path;
+    job->cooked_path = cooked_path;
+    job->cook_flags  = cook_flags;
+
+    push_job(jobs, mesh_load_job, job);
+}
+
+// main thread, after job.is_done
+bool finish_mesh_load_job(Gpu_Mesh *mesh, Mesh_Load_Job *job, Platform_API *platform_api) {
+    bool ok = job->cooked.count && make_gpu_mesh(mesh, job->cooked);
+
+#if defined DEBUG
+    if (ok && job->was_cooked_from_text)
+        platform_api->write_entire_file(job->cooked_path, job->cooked);
+#endif
+
+    unmap_file(&job->mapped_file);
+    free_pages(&job->cooked_pages);
+
+    return ok;
+}
+
+#if defined BENCHMARK_MESH_LOADING
+
+#include "report.h"
+
+// loads every mesh repeatedly through both paths (including the gl upload)
+// and writes the timings to mesh_load_benchmark.txt, followed by what glm_optimize did to each mesh.
+// the text path is mooselib's make_mesh, like the demo loaded meshes before cooking.
+// release builds never write the .glmb files, so missing or stale ones are cooked and written first.
+void benchmark_mesh_loading(Platform_API *platform_api, Memory_Allocator *transient_allocator, string *glm_paths, string *cooked_paths, u32 *cook_flags, u32 mesh_count) {
+    u32 const Iteration_Count = 16;
+
+    char report_buffer[4096];
+    auto report = make_report(report_buffer, sizeof(report_buffer));
+
+    report_write(&report, "mesh load benchmark, best of %u runs (ms)\n%-32s %10s %10s %8s\n", Iteration_Count, "mesh", "text", "cooked", "speedup");
+
+    f64 total_text_seconds   = 0;
+    f64 total_cooked_seconds = 0;
+
+    for (u32 mesh_index = 0; mesh_index < mesh_count; mesh_index++) {
+        char name[256];
+        copy_to_c_string(name, sizeof(name), glm_paths[mesh_index]);
+
+        {
+            Mapped_File mapped_file;
+            bool is_cooked = map_file(&mapped_file, cooked_paths[mesh_index]) && has_cook_flags(mapped_file.data, cook_flags[mesh_index]);
+            unmap_file(&mapped_file);
+
+            if (!is_cooked) {
+                auto source = TRACK_READ_ENTIRE_FILE(platform_api, glm_paths[mesh_index], transient_allocator);
+                auto cooked = cook_glm(source, transient_allocator, cook_flags[mesh_index]);
+
+                is_cooked = cooked.count && platform_api->write_entire_file(cooked_paths[mesh_index], cooked);
+
+                TRACK_FREE_ARRAY(transient_allocator, &cooked);
+                TRACK_FREE_ARRAY(transient_allocator, &source);
+            }
+
+            if (!is_cooked) {
+                report_write(&report, "%-32s could not be cooked\n", name);
+                continue;
+            }
+        }
+
+        f64 text_seconds   = 1e10;
+        f64 cooked_seconds = 1e10;
+        bool ok = true;
+
+        for (u32 iteration = 0; ok && (iteration < Iteration_Count); iteration++) {
+            // mooselib has no way to free a Mesh, what make_mesh allocates stays until exit
+            u64 start = get_clock_ticks();
+            {
+                auto source = TRACK_READ_ENTIRE_FILE(platform_api, glm_paths[mesh_index], transient_allocator);
+                make_mesh(source, transient_allocator);
+                glFinish();
+
+                TRACK_FREE_ARRAY(transient_allocator, &source);
+            }
+            text_seconds = min(text_seconds, get_clock_seconds(get_clock_ticks() - start));
+
+            Gpu_Mesh mesh;
+
+            start = get_clock_ticks();
+            {
+                Mapped_File mapped_file;
+                ok = map_file(&mapped_file, cooked_paths[mesh_index]) && make_gpu_mesh(&mesh, mapped_file.data);
+                glFinish();
+
+                unmap_file(&mapped_file);
+            }
+            cooked_seconds = min(cooked_seconds, get_clock_seconds(get_clock_ticks() - start));
+
+            if (ok)
+                free_gpu_mesh(&mesh);
+        }
+
+        if (!ok) {
+            report_write(&report, "%-32s could not load %.*s\n", name, cast_v(s32, cooked_paths[mesh_index].count), cast_p(char const, cooked_paths[mesh_index].data));
+            continue;
+        }
+
+        total_text_seconds   += text_seconds;
+        total_cooked_seconds += cooked_seconds;
+
+        report_write(&report, "%-32s %10.3f %10.3f %7.1fx\n", name, text_seconds * 1000, cooked_seconds * 1000, text_seconds / cooked_seconds);
+    }
+
+    report_write(&report, "%-32s %10.3f %10.3f %7.1fx\n", "total", total_text_seconds * 1000, total_cooked_seconds * 1000, total_text_seconds / max(total_cooked_seconds, 1e-9));
+
+    report_write(&report, "\nlod 0 acmr (fifo %u) and bytes per vertex, before and after glm_optimize\n%-32s %8s %8s %8s %8s\n", Vertex_Cache_Measure_Size, "mesh", "acmr", "acmr", "bytes", "bytes");
+
+    for (u32 mesh_index = 0; mesh_index < mesh_count; mesh_index++) {
+        auto source = TRACK_READ_ENTIRE_FILE(platform_api, glm_paths[mesh_index], transient_allocator);
+        auto cooked = cook_glm(source, transient_allocator, cook_flags[mesh_index]);
+
+        char name[256];
+        copy_to_c_string(name, sizeof(name), glm_paths[mesh_index]);
+
+        Cooked_Mesh cooked_mesh;
+        if (read_cooked_mesh(&cooked_mesh, cooked)) {
+            auto header = cooked_mesh.header;
+            report_write(&report, "%-32s %8.3f %8.3f %8u %8u\n", name, header->acmr_before, header->acmr_after, header->vertex_size_before, header->vertex_size_after);
+        }
+
+        TRACK_FREE_ARRAY(transient_allocator, &cooked);
+        TRACK_FREE_ARRAY(transient_allocator, &source);
+    }
+
+    write_report(&report, platform_api, S("mesh_load_benchmark.txt"));
+}
+
+#endif // BENCHMARK_MESH_LOADING
+
+#endif // MESH_COOK_H
@@ -0,0 +1,260 @@
+#if !defined MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+// vertex cache and vertex fetch ordering for cooked meshs (see glm_optimize in mesh_cook.h).
+// triangles are reordered with tom forsyth's linear speed vertex cache optimization,
+// which greedily picks the triangle whose vertices score best in a simulated lru cache.
+// vertices are then renumbered in the order the indices first use them, so fetches walk the vertex buffer forward.
+// the average cache miss ratio (acmr, transformed vertices per triangle) is measured with a fifo cache,
+// closer to what gpus do than the lru the optimizer assumes.
+
+#include "jobs.h"
+
+u32 const Vertex_Cache_Optimize_Size = 32;
+u32 const Vertex_Cache_Measure_Size  = 16;
+
+inline f32 get_vertex_cache_score(s32 cache_position, u32 remaining_triangle_count) {
+    // no triangles left, the vertex no longer matters
+    if (!remaining_triangle_count)
+        return -1.0f;
+
+    f32 score = 0;
+    if (cache_position >= 0) {
+        // the vertices of the last triangle get a fixed score, so the next one does not just pick the same edge
+        if (cache_position < 3) {
+            score = 0.75f;
+        }
+        else {
+            f32 scale = 1.0f / (Vertex_Cache_Optimize_Size - 3);
+            score = powf(1.0f - (cache_position - 3) * scale, 1.5f);
+        }
+    }
+
+    // vertices with few triangles left are finished first, so they leave the cache for good
+    score += 2.0f / sqrtf(cast_v(f32, remaining_triangle_count));
+
+    return score;
+}
+
+// upper bound of the scratch memory of optimize_vertex_cache
+u32 get_vertex_cache_scratch_size(u32 vertex_count, u32 index_count) {
+    u32 triangle_count = index_count / 3;
+
+    u32 size = 0;
+    size += vertex_count * (2 * sizeof(u32) + sizeof(f32));
+    size += 2 * index_count * sizeof(u32);
+    size += triangle_count * (sizeof(f32) + 1);
+    size += (Vertex_Cache_Optimize_Size + 3) * 2 * sizeof(u32);
+
+    // alignment of 9 arrays
+    return size + 9 * 16;
+}
+
+// reorders the triangles of indices in place, vertex_count bounds the index values
+void optimize_vertex_cache(u32 *indices, u32 index_count, u32 vertex_count, Job_Arena *scratch) {
+    u32 triangle_count = index_count / 3;
+    if (triangle_count < 2)
+        return;
+
+    u32 scratch_mark = scratch->used;
+    defer { scratch->used = scratch_mark; };
+
+    auto remaining_counts     = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+    auto adjacency_offsets    = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+    auto vertex_scores        = ARENA_PUSH_ARRAY(scratch, f32, vertex_count);
+    auto adjacency            = ARENA_PUSH_ARRAY(scratch, u32, index_count);
+    auto triangle_scores      = ARENA_PUSH_ARRAY(scratch, f32, triangle_count);
+    auto cache                = ARENA_PUSH_ARRAY(scratch, u32, Vertex_Cache_Optimize_Size + 3);
+    auto next_cache           = ARENA_PUSH_ARRAY(scratch, u32, Vertex_Cache_Optimize_Size + 3);
+    auto is_triangle_added    = ARENA_PUSH_ARRAY(scratch, u8, triangle_count);
+
+    for (u32 i = 0; i < vertex_count; i++)
+        remaining_counts[i] = 0;
+
+    for (u32 i = 0; i < triangle_count * 3; i++)
+        remaining_counts[indices[i]]++;
+
+    // triangles per vertex, remaining_counts doubles as the fill cursor and is restored while filling
+    u32 offset = 0;
+    for (u32 i = 0; i < vertex_count; i++) {
+        adjacency_offsets[i] = offset;
+        offset += remaining_counts[i];
+        remaining_counts[i] = 0;
+    }
+
+    for (u32 triangle = 0; triangle < triangle_count; triangle++) {
+        for (u32 corner = 0; corner < 3; corner++) {
+            u32 vertex = indices[triangle * 3 + corner];
+            adjacency[adjacency_offsets[vertex] + remaining_counts[vertex]] = triangle;
+            remaining_counts[vertex]++;
+        }
+    }
+
+    for (u32 i = 0; i < vertex_count; i++)
+        vertex_scores[i] = get_vertex_cache_score(-1, remaining_counts[i]);
+
+    for (u32 triangle = 0; triangle < triangle_count; triangle++) {
+        is_triangle_added[triangle] = false;
+        triangle_scores[triangle] = vertex_scores[indices[triangle * 3]] + vertex_scores[indices[triangle * 3 + 1]] + vertex_scores[indices[triangle * 3 + 2]];
+    }
+
+    // triangles are read from a copy, the new order overwrites indices
+    auto source = ARENA_PUSH_ARRAY(scratch, u32, index_count);
+    memcpy(source, indices, triangle_count * 3 * sizeof(u32));
+
+    u32 cache_count = 0;
+    u32 scan_cursor = 0;
+    u32 best_triangle = 0xFFFFFFFF;
+
+    for (u32 output = 0; output < triangle_count; output++) {
+        // nothing in the cache scored, fall back to the best of the next triangles that are not added yet
+        if (best_triangle == 0xFFFFFFFF) {
+            while (is_triangle_added[scan_cursor])
+                scan_cursor++;
+
+            f32 best_score = -1e30f;
+            for (u32 triangle = scan_cursor; triangle < triangle_count; triangle++) {
+                if (!is_triangle_added[triangle] && (triangle_scores[triangle] > best_score)) {
+                    best_score = triangle_scores[triangle];
+                    best_triangle = triangle;
+                }
+            }
+        }
+
+        u32 triangle = best_triangle;
+        u32 const *corners = source + triangle * 3;
+        memcpy(indices + output * 3, corners, 3 * sizeof(u32));
+        is_triangle_added[triangle] = true;
+
+        // the triangle's vertices move to the front of the lru cache
+        u32 next_cache_count = 0;
+        for (u32 corner = 0; corner < 3; corner++) {
+            u32 vertex = corners[corner];
+            next_cache[next_cache_count++] = vertex;
+
+            // remove the triangle from the vertex's list
+            u32 *triangles = adjacency + adjacency_offsets[vertex];
+            for (u32 i = 0; i < remaining_counts[vertex]; i++) {
+                if (triangles[i] == triangle) {
+                    triangles[i] = triangles[remaining_counts[vertex] - 1];
+                    break;
+                }
+            }
+
+            remaining_counts[vertex]--;
+        }
+
+        for (u32 i = 0; i < cache_count; i++) {
+            u32 vertex = cache[i];
+            if ((vertex != corners[0]) && (vertex != corners[1]) && (vertex != corners[2]))
+                next_cache[next_cache_count++] = vertex;
+        }
+
+        // vertices pushed out of the cache lose their cache score, which only matters to the fallback scan
+        for (u32 i = Vertex_Cache_Optimize_Size; i < next_cache_count; i++) {
+            u32 vertex = next_cache[i];
+            vertex_scores[vertex] = get_vertex_cache_score(-1, remaining_counts[vertex]);
+
+            u32 const *triangles = adjacency + adjacency_offsets[vertex];
+            for (u32 j = 0; j < remaining_counts[vertex]; j++) {
+                u32 const *other_corners = source + triangles[j] * 3;
+                triangle_scores[triangles[j]] = vertex_scores[other_corners[0]] + vertex_scores[other_corners[1]] + vertex_scores[other_corners[2]];
+            }
+        }
+
+        cache_count = min(next_cache_count, Vertex_Cache_Optimize_Size);
+        memcpy(cache, next_cache, cache_count * sizeof(u32));
+
+        for (u32 i = 0; i < cache_count; i++) {
+            u32 vertex = cache[i];
+            vertex_scores[vertex] = get_vertex_cache_score(cast_v(s32, i), remaining_counts[vertex]);
+        }
+
+        // only triangles of cached vertices changed their score
+        best_triangle = 0xFFFFFFFF;
+        f32 best_score = -1e30f;
+
+        for (u32 i = 0; i < cache_count; i++) {
+            u32 vertex = cache[i];
+            u32 const *triangles = adjacency + adjacency_offsets[vertex];
+
+            for (u32 j = 0; j < remaining_counts[vertex]; j++) {
+                u32 other = triangles[j];
+                u32 const *other_corners = source + other * 3;
+
+                f32 score = vertex_scores[other_corners[0]] + vertex_scores[other_corners[1]] + vertex_scores[other_corners[2]];
+                triangle_scores[other] = score;
+
+                if (score > best_score) {
+                    best_score = score;
+                    best_triangle = other;
+                }
+            }
+        }
+    }
+}
+
+// fills remap with the new index of every vertex, in the order the indices first use them,
+// vertices no index uses go to the end. returns the number of used vertices
+u32 get_vertex_fetch_remap(u32 *remap, u32 const *indices, u32 index_count, u32 vertex_count) {
+    for (u32 i = 0; i < vertex_count; i++)
+        remap[i] = 0xFFFFFFFF;
+
+    u32 used_count = 0;
+    for (u32 i = 0; i < index_count; i++) {
+        u32 vertex = indices[i];
+        if (remap[vertex] == 0xFFFFFFFF)
+            remap[vertex] = used_count++;
+    }
+
+    u32 next = used_count;
+    for (u32 i = 0; i < vertex_count; i++) {
+        if (remap[i] == 0xFFFFFFFF)
+            remap[i] = next++;
+    }
+
+    return used_count;
+}
+
+// transformed vertices of a triangle list with a fifo post transform cache,
+// stamps needs vertex_count entries
+u32 count_vertex_cache_misses(u32 const *indices, u32 index_count, u32 vertex_count, u32 *stamps) {
+    // a vertex is cached if it missed less than cache size misses ago, stamps start out of range
+    u32 const Never = 0x80000000;
+    for (u32 i = 0; i < vertex_count; i++)
+        stamps[i] = Never;
+
+    u32 miss_count = 0;
+    for (u32 i = 0; i < index_count; i++) {
+        u32 vertex = indices[i];
+
+        if ((stamps[vertex] == Never) || (miss_count - stamps[vertex] >= Vertex_Cache_Measure_Size)) {
+            stamps[vertex] = miss_count;
+            miss_count++;
+        }
+    }
+
+    return miss_count;
+}
+
+// quantization
+
+// [-1, 1] to a GL_SHORT with normalize
+inline s16 pack_snorm16(f32 value) {
+    value = min(max(value, -1.0f), 1.0f);
+    return cast_v(s16, value * 32767.0f + ((value < 0) ? -0.5f : 0.5f));
+}
+
+// unit vector to GL_INT_2_10_10_10_REV with normalize, w is 0
+inline u32 pack_normal_2_10_10_10(f32 const *normal) {
+    u32 result = 0;
+    for (u32 i = 0; i < 3; i++) {
+        f32 value = min(max(normal[i], -1.0f), 1.0f);
+        s32 packed = cast_v(s32, value * 511.0f + ((value < 0) ? -0.5f : 0.5f));
+        result |= (cast_v(u32, packed) & 0x3FF) << (i * 10);
+    }
+
+    return result;
+}
+
+#endif // MESH_OPTIMIZE_H
@@ -0,0 +1,354 @@
+#if !defined MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+// triangle simplification for mesh lods (see glm_build_lods in mesh_cook.h).
+// greedy edge collapses ordered by quadric error (garland and heckbert),
+// a vertex always collapses onto a neighbour, so lods share the vertex buffer and only need new indices.
+// vertices with more than one vertex index at their position (uv seams, hard normals)
+// and vertices on open borders never move, so the simplified mesh keeps its outline and attributes.
+// collapses that flip a triangle are rejected.
+
+#include <stdlib.h>
+
+#include "jobs.h"
+
+// symmetric 4x4 matrix, the sum of squared distances to a set of planes
+struct Quadric {
+    f32 a00, a01, a02, a11, a12, a22;
+    f32 b0, b1, b2;
+    f32 c;
+};
+
+inline void add_plane(Quadric *q, vec3f normal, f32 distance) {
+    q->a00 += normal.x * normal.x;
+    q->a01 += normal.x * normal.y;
+    q->a02 += normal.x * normal.z;
+    q->a11 += normal.y * normal.y;
+    q->a12 += normal.y * normal.z;
+    q->a22 += normal.z * normal.z;
+    q->b0  += normal.x * distance;
+    q->b1  += normal.y * distance;
+    q->b2  += normal.z * distance;
+    q->c   += distance * distance;
+}
+
+inline void add_quadric(Quadric *q, Quadric const *other) {
+    q->a00 += other->a00;
+    q->a01 += other->a01;
+    q->a02 += other->a02;
+    q->a11 += other->a11;
+    q->a12 += other->a12;
+    q->a22 += other->a22;
+    q->b0  += other->b0;
+    q->b1  += other->b1;
+    q->b2  += other->b2;
+    q->c   += other->c;
+}
+
+inline f32 get_quadric_error(Quadric const *q, vec3f p) {
+    f32 error =
+        q->a00 * p.x * p.x + 2 * q->a01 * p.x * p.y + 2 * q->a02 * p.x * p.z +
+        q->a11 * p.y * p.y + 2 * q->a12 * p.y * p.z +
+        q->a22 * p.z * p.z +
+        2 * (q->b0 * p.x + q->b1 * p.y + q->b2 * p.z) + q->c;
+
+    return max(error, 0.0f);
+}
+
+struct Simplify_Collapse {
+    f32 cost;
+    u32 from;
+    u32 to;
+};
+
+int compare_simplify_collapses(void const *a, void const *b) {
+    f32 cost_a = cast_p(Simplify_Collapse const, a)->cost;
+    f32 cost_b = cast_p(Simplify_Collapse const, b)->cost;
+
+    return (cost_a < cost_b) ? -1 : (cost_a > cost_b);
+}
+
+inline u32 hash_u32(u32 value) {
+    value ^= value >> 16;
+    value *= 0x7feb352d;
+    value ^= value >> 15;
+    value *= 0x846ca68b;
+    value ^= value >> 16;
+
+    return value;
+}
+
+inline u32 get_hash_capacity(u32 count) {
+    u32 capacity = 16;
+    while (capacity < count * 2)
+        capacity *= 2;
+
+    return capacity;
+}
+
+// upper bound of the scratch memory of simplify_triangles
+u32 get_simplify_scratch_size(u32 vertex_count, u32 index_count) {
+    u32 size = 0;
+    size += get_hash_capacity(vertex_count) * sizeof(u32);
+    size += (vertex_count + 1) * (3 * sizeof(u32) + sizeof(Quadric) + 2);
+    size += get_hash_capacity(index_count) * (sizeof(u64) + sizeof(u32));
+    size += index_count * (sizeof(u32) + 2 * sizeof(Simplify_Collapse));
+
+    // alignment of 11 arrays
+    return size + 11 * 16;
+}
+
+inline vec3f get_simplify_position(f32 const *positions, u32 position_stride, u32 vertex_index) {
+    auto p = cast_p(f32 const, cast_p(u8 const, positions) + vertex_index * position_stride);
+    return vec3f{ p[0], p[1], p[2] };
+}
+
+// simplifies the triangle list indices until at most target_index_count indices are left or no collapse is possible,
+// writes the result to destination (index_count capacity) and returns its index count.
+// error gets the object space distance the surface moved at most (square root of the largest quadric error).
+// positions are 3 floats every position_stride bytes, scratch is reset before returning
+u32 simplify_triangles(u32 *destination, u32 const *indices, u32 index_count, f32 const *positions, u32 position_stride, u32 vertex_count, u32 target_index_count, f32 *error, Job_Arena *scratch) {
+    u32 scratch_mark = scratch->used;
+    defer { scratch->used = scratch_mark; };
+
+    *error = 0;
+    memcpy(destination, indices, index_count * sizeof(u32));
+
+    // position ids, the first vertex at each position stands for all of them
+    auto position_ids = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+    {
+        u32 capacity = get_hash_capacity(vertex_count);
+        auto table = ARENA_PUSH_ARRAY(scratch, u32, capacity);
+        memset(table, 0xFF, capacity * sizeof(u32));
+
+        for (u32 i = 0; i < vertex_count; i++) {
+            auto p = cast_p(u32 const, cast_p(u8 const, positions) + i * position_stride);
+            u32 slot = hash_u32(p[0] ^ hash_u32(p[1] ^ hash_u32(p[2]))) & (capacity - 1);
+
+            while (true) {
+                u32 other = table[slot];
+                if (other == 0xFFFFFFFF) {
+                    table[slot] = i;
+                    position_ids[i] = i;
+                    break;
+                }
+
+                auto other_p = cast_p(u32 const, cast_p(u8 const, positions) + other * position_stride);
+                if ((p[0] == other_p[0]) && (p[1] == other_p[1]) && (p[2] == other_p[2])) {
+                    position_ids[i] = other;
+                    break;
+                }
+
+                slot = (slot + 1) & (capacity - 1);
+            }
+        }
+    }
+
+    auto quadrics = ARENA_PUSH_ARRAY(scratch, Quadric, vertex_count);
+    memset(quadrics, 0, vertex_count * sizeof(Quadric));
+
+    for (u32 i = 0; i < index_count; i += 3) {
+        vec3f p0 = get_simplify_position(positions, position_stride, indices[i]);
+        vec3f p1 = get_simplify_position(positions, position_stride, indices[i + 1]);
+        vec3f p2 = get_simplify_position(positions, position_stride, indices[i + 2]);
+
+        vec3f normal = cross(p1 - p0, p2 - p0);
+        f32 area = length(normal);
+        if (area == 0)
+            continue;
+
+        normal = normal * (1.0f / area);
+        f32 distance = -dot(normal, p0);
+
+        for (u32 corner = 0; corner < 3; corner++)
+            add_plane(quadrics + position_ids[indices[i + corner]], normal, distance);
+    }
+
+    // seams and borders stay in place
+    auto is_locked = ARENA_PUSH_ARRAY(scratch, u8, vertex_count);
+    memset(is_locked, 0, vertex_count);
+
+    for (u32 i = 0; i < vertex_count; i++) {
+        if (position_ids[i] != i)
+            is_locked[position_ids[i]] = true;
+    }
+
+    {
+        u32 capacity = get_hash_capacity(index_count);
+        auto edges       = ARENA_PUSH_ARRAY(scratch, u64, capacity);
+        auto edge_counts = ARENA_PUSH_ARRAY(scratch, u32, capacity);
+        memset(edges, 0xFF, capacity * sizeof(u64));
+
+        for (u32 i = 0; i < index_count; i++) {
+            u32 a = position_ids[indices[i]];
+            u32 b = position_ids[indices[(i % 3 == 2) ? i - 2 : i + 1]];
+            u64 key = (cast_v(u64, min(a, b)) << 32) | max(a, b);
+
+            u32 slot = hash_u32(cast_v(u32, key) ^ hash_u32(cast_v(u32, key >> 32))) & (capacity - 1);
+            while ((edges[slot] != key) && (edges[slot] != 0xFFFFFFFFFFFFFFFFull))
+                slot = (slot + 1) & (capacity - 1);
+
+            if (edges[slot] != key) {
+                edges[slot] = key;
+                edge_counts[slot] = 0;
+            }
+
+            edge_counts[slot]++;
+        }
+
+        for (u32 i = 0; i < capacity; i++) {
+            if ((edges[i] != 0xFFFFFFFFFFFFFFFFull) && (edge_counts[i] != 2)) {
+                is_locked[cast_v(u32, edges[i] >> 32)] = true;
+                is_locked[cast_v(u32, edges[i])] = true;
+            }
+        }
+    }
+
+    auto adjacency_offsets = ARENA_PUSH_ARRAY(scratch, u32, vertex_count + 1);
+    auto adjacency         = ARENA_PUSH_ARRAY(scratch, u32, index_count);
+    auto remap             = ARENA_PUSH_ARRAY(scratch, u32, vertex_count);
+    auto is_touched        = ARENA_PUSH_ARRAY(scratch, u8, vertex_count);
+    auto collapses         = ARENA_PUSH_ARRAY(scratch, Simplify_Collapse, index_count * 2);
+
+    f32 max_cost = 0;
+    u32 triangle_index_count = index_count;
+
+    // every pass collapses a set of edges that do not share a triangle, so they can not interfere
+    while (triangle_index_count > target_index_count) {
+        memset(adjacency_offsets, 0, (vertex_count + 1) * sizeof(u32));
+        for (u32 i = 0; i < triangle_index_count; i++)
+            adjacency_offsets[destination[i] + 1]++;
+
+        for (u32 i = 0; i < vertex_count; i++)
+            adjacency_offsets[i + 1] += adjacency_offsets[i];
+
+        for (u32 i = 0; i < triangle_index_count; i++)
+            adjacency[adjacency_offsets[destination[i]]++] = i / 3;
+
+        // offsets were advanced to the end of their list
+        for (u32 i = vertex_count; i > 0; i--)
+            adjacency_offsets[i] = adjacency_offsets[i - 1];
+
+        adjacency_offsets[0] = 0;
+
+        u32 collapse_count = 0;
+        for (u32 i = 0; i < triangle_index_count; i++) {
+            u32 a = destination[i];
+            u32 b = destination[(i % 3 == 2) ? i - 2 : i + 1];
+
+            for (u32 direction = 0; direction < 2; direction++) {
+                u32 from = direction ? b : a;
+                u32 to   = direction ? a : b;
+
+                if (is_locked[position_ids[from]] || (position_ids[from] == position_ids[to]))
+                    continue;
+
+                Quadric q = quadrics[position_ids[from]];
+                add_quadric(&q, quadrics + position_ids[to]);
+
+                auto collapse = collapses + collapse_count++;
+                collapse->cost = get_quadric_error(&q, get_simplify_position(positions, position_stride, to));
+                collapse->from = from;
+                collapse->to   = to;
+            }
+        }
+
+        if (!collapse_count)
+            break;
+
+        qsort(collapses, collapse_count, sizeof(Simplify_Collapse), compare_simplify_collapses);
+
+        for (u32 i = 0; i < vertex_count; i++)
+            remap[i] = i;
+
+        memset(is_touched, 0, vertex_count);
+
+        u32 removed_index_count = 0;
+        u32 pass_collapse_count = 0;
+
+        for (u32 collapse_index = 0; collapse_index < collapse_count; collapse_index++) {
+            if (triangle_index_count - removed_index_count <= target_index_count)
+                break;
+
+            auto collapse = collapses + collapse_index;
+            u32 from = collapse->from;
+            u32 to   = collapse->to;
+
+            if (is_touched[position_ids[from]] || is_touched[position_ids[to]])
+                continue;
+
+            vec3f to_position = get_simplify_position(positions, position_stride, to);
+
+            // unlocked vertices have a single vertex index, so these are all triangles around from
+            bool is_flipping = false;
+            u32 collapsed_triangle_count = 0;
+
+            for (u32 j = adjacency_offsets[from]; j < adjacency_offsets[from + 1]; j++) {
+                u32 *triangle = destination + adjacency[j] * 3;
+
+                if ((position_ids[triangle[0]] == position_ids[to]) || (position_ids[triangle[1]] == position_ids[to]) || (position_ids[triangle[2]] == position_ids[to])) {
+                    collapsed_triangle_count++;
+                    continue;
+                }
+
+                vec3f p[3];
+                vec3f moved[3];
+                for (u32 corner = 0; corner < 3; corner++) {
+                    p[corner] = get_simplify_position(positions, position_stride, triangle[corner]);
+                    moved[corner] = (triangle[corner] == from) ? to_position : p[corner];
+                }
+
+                vec3f normal = cross(p[1] - p[0], p[2] - p[0]);
+                vec3f moved_normal = cross(moved[1] - moved[0], moved[2] - moved[0]);
+
+                if (dot(normal, moved_normal) <= 0.25f * length(normal) * length(moved_normal)) {
+                    is_flipping = true;
+                    break;
+                }
+            }
+
+            if (is_flipping)
+                continue;
+
+            // neighbours of from keep their triangles until the pass ends
+            for (u32 j = adjacency_offsets[from]; j < adjacency_offsets[from + 1]; j++) {
+                u32 *triangle = destination + adjacency[j] * 3;
+
+                for (u32 corner = 0; corner < 3; corner++)
+                    is_touched[position_ids[triangle[corner]]] = true;
+            }
+
+            remap[from] = to;
+            add_quadric(quadrics + position_ids[to], quadrics + position_ids[from]);
+            max_cost = max(max_cost, collapse->cost);
+
+            removed_index_count += collapsed_triangle_count * 3;
+            pass_collapse_count++;
+        }
+
+        if (!pass_collapse_count)
+            break;
+
+        u32 kept_index_count = 0;
+        for (u32 i = 0; i < triangle_index_count; i += 3) {
+            u32 a = remap[destination[i]];
+            u32 b = remap[destination[i + 1]];
+            u32 c = remap[destination[i + 2]];
+
+            if ((position_ids[a] == position_ids[b]) || (position_ids[b] == position_ids[c]) || (position_ids[c] == position_ids[a]))
+                continue;
+
+            destination[kept_index_count++] = a;
+            destination[kept_index_count++] = b;
+            destination[kept_index_count++] = c;
+        }
+
+        triangle_index_count = kept_index_count;
+    }
+
+    *error = sqrtf(max_cost);
+
+    return triangle_index_count;
+}
+
+#endif // MESH_SIMPLIFY_H
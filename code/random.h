@@ -0,0 +1,22 @@
+#if !defined RANDOM_H
+#define RANDOM_H
+
+// a linear congruential generator for test scenes and benchmarks,
+// started from a fixed seed, so runs are comparable
+
+struct Random {
+    u32 state;
+};
+
+// in [0, 1) with 24 bits
+f32 random_unit(Random *random) {
+    random->state = random->state * 1664525u + 1013904223u;
+    return (random->state >> 8) / cast_v(f32, 1 << 24);
+}
+
+void random_units(Random *random, f32 *values, u32 count) {
+    for (u32 i = 0; i < count; i++)
+        values[i] = random_unit(random);
+}
+
+#endif // RANDOM_H
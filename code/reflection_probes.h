@@ -0,0 +1,539 @@
+#if !defined REFLECTION_PROBES_H
+#define REFLECTION_PROBES_H
+
+// local reflections from many cube map probes, all stored in one cube map array (6 layers per probe).
+// a probe captures the scene from its position and lights everything inside its influence box,
+// the scene shader (REFLECTION_PROBES) blends the probes around the shaded point, corrects reflections
+// for the box as if it were the walls of a room, and falls back to the sky outside of all boxes.
+//
+// faces are rendered by a scheduler with a fixed budget of faces per frame:
+// static probes render their faces once and again only if a static object moves,
+// other probes also re-render while dynamic items overlap their box and once after they left.
+// probes near the camera and with dynamic items inside go first, waiting raises the priority of the others.
+// a probe is only blended once all its faces were rendered, its irradiance follows through a read back.
+//
+// when all 6 faces of a probe are due in the same frame, they can be rendered in one layered pass,
+// a geometry shader routes each triangle to the layers probe * 6 + face it touches (LAYERED in scene.shader.txt).
+// the per face path is kept for comparison and for single faces.
+
+#include "render_queue.h"
+#include "texture_load.h"
+#include "spherical_harmonics.h"
+
+u32 const Reflection_Probe_Max_Count = 16;
+
+// faces rendered in one frame, each face is a render queue view and a camera upload
+u32 const Reflection_Probe_Max_Faces_Per_Frame    = 6;
+u32 const Reflection_Probe_Default_Faces_Per_Frame = 2;
+
+// the distance to the camera at which a probe's priority halves
+f32 const Reflection_Probe_Priority_Distance = 20.0f;
+
+// width of the mip level that is read back for the irradiance
+u32 const Reflection_Probe_Irradiance_Size = 32;
+
+u8 const Reflection_Probe_All_Faces = (1 << 6) - 1;
+
+enum Reflection_Probe_Flag {
+    // ignores dynamic items, rendered once
+    Reflection_Probe_Static = 1 << 0,
+};
+
+struct Reflection_Probe {
+    vec3f position;
+    vec3f influence_min;
+    vec3f influence_max;
+
+    // the blend weight rises from 0 at the box to 1 this far inside
+    f32 blend_distance;
+    u32 flags;
+
+    // bit i for GL_TEXTURE_CUBE_MAP_POSITIVE_X + i
+    u8 rendered_faces;
+    u8 due_faces;
+
+    // faces rendered since the last irradiance read back
+    u8 changed_faces;
+
+    bool has_dynamic_items;
+
+    // all faces are rendered again once the current ones are done
+    bool needs_update;
+
+    f32 waiting_seconds;
+
+    SH_Irradiance irradiance;
+};
+
+struct Reflection_Probe_Face {
+    u32 probe;
+    u32 face;
+};
+
+struct Reflection_Probes {
+    Reflection_Probe probes[Reflection_Probe_Max_Count];
+    u32 count;
+
+    // GL_TEXTURE_CUBE_MAP_ARRAY of Reflection_Probe_Max_Count cube maps
+    GLuint texture_object;
+    GLuint depth_render_buffer_object;
+    GLuint frame_buffer_object;
+
+    // read and draw, for the mip chain of single faces
+    GLuint mip_frame_buffer_objects[2];
+
+    // every attachment of a layered frame buffer has to be layered, so depth is an array with a layer per face of every probe
+    // (24 MB at a resolution of 256).
+    // clearing the layered frame buffer would clear all of them, a probe's layers are cleared through depth_clear_frame_buffer_object.
+    // 0 if the frame buffer is not complete
+    GLuint layered_frame_buffer_object;
+    GLuint layered_depth_texture_object;
+    GLuint depth_clear_frame_buffer_object;
+    bool use_layered_rendering;
+
+    Pixel_Dimensions resolution;
+    u32 level_count;
+
+    // faces render into this mip level, it is also the base level for sampling, see Quality_Level
+    u32 level;
+
+    u32 faces_per_frame;
+    u32 static_version;
+
+    Irradiance_Readback irradiance_readback;
+    u32 readback_probe;
+
+    // of the last frame, for the debug overlay
+    u32 due_face_count;
+    u32 rendered_face_count;
+    u32 draw_call_count;
+};
+
+// std140 mirror of Scene_Reflection_Probes in data/shaders/scene.shader.txt
+
+u32 const Reflection_Probe_Max_Visible_Count = 8;
+
+struct Reflection_Probe_Uniforms {
+    // w is the cube map index in the array
+    vec4f position;
+
+    // w of min is the blend distance
+    vec4f influence_min;
+    vec4f influence_max;
+
+    vec4f irradiance[SH_Coefficient_Count];
+};
+
+struct Scene_Reflection_Probes_Block {
+    u32 count;
+    u32 padding[3];
+    Reflection_Probe_Uniforms probes[Reflection_Probe_Max_Visible_Count];
+};
+
+// needs cube map arrays (gl 4.0 or GL_ARB_texture_cube_map_array), returns false without them
+bool init_reflection_probes(Reflection_Probes *probes, u32 resolution) {
+    *probes = {};
+    probes->faces_per_frame = Reflection_Probe_Default_Faces_Per_Frame;
+
+    GLint major_version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+
+    if ((major_version < 4) && !has_gl_extension("GL_ARB_texture_cube_map_array"))
+        return false;
+
+    probes->resolution = { cast_v(s32, resolution), cast_v(s32, resolution) };
+    probes->level_count = bit_count_of(resolution);
+
+    glGenTextures(1, &probes->texture_object);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, probes->texture_object);
+
+    for (u32 level = 0; level < probes->level_count; level++) {
+        u32 size = max(resolution >> level, 1u);
+        glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, level, GL_RGBA8, size, size, 6 * Reflection_Probe_Max_Count, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    }
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, probes->level_count - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+    // shared by all faces, lower levels render to its lower left part
+    glGenRenderbuffers(1, &probes->depth_render_buffer_object);
+    glBindRenderbuffer(GL_RENDERBUFFER, probes->depth_render_buffer_object);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, resolution, resolution);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &probes->frame_buffer_object);
+    glBindFramebuffer(GL_FRAMEBUFFER, probes->frame_buffer_object);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, 0, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, probes->depth_render_buffer_object);
+
+    bool is_complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenFramebuffers(ARRAY_COUNT(probes->mip_frame_buffer_objects), probes->mip_frame_buffer_objects);
+
+    {
+        glGenTextures(1, &probes->layered_depth_texture_object);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, probes->layered_depth_texture_object);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 6 * Reflection_Probe_Max_Count, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &probes->layered_frame_buffer_object);
+        glBindFramebuffer(GL_FRAMEBUFFER, probes->layered_frame_buffer_object);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, probes->layered_depth_texture_object, 0);
+
+        bool is_layered_complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (is_layered_complete) {
+            glGenFramebuffers(1, &probes->depth_clear_frame_buffer_object);
+        }
+        else {
+            glDeleteFramebuffers(1, &probes->layered_frame_buffer_object);
+            glDeleteTextures(1, &probes->layered_depth_texture_object);
+            probes->layered_frame_buffer_object  = 0;
+            probes->layered_depth_texture_object = 0;
+        }
+    }
+
+    return is_complete;
+}
+
+// influence_min and influence_max are the corners of the box in world space, which should contain position
+u32 add_reflection_probe(Reflection_Probes *probes, vec3f position, vec3f influence_min, vec3f influence_max, f32 blend_distance, u32 flags = 0) {
+    assert(probes->count < Reflection_Probe_Max_Count);
+
+    u32 index = probes->count++;
+    auto probe = probes->probes + index;
+
+    *probe = {};
+    probe->position       = position;
+    probe->influence_min  = influence_min;
+    probe->influence_max  = influence_max;
+    probe->blend_distance = blend_distance;
+    probe->flags          = flags;
+    probe->due_faces      = Reflection_Probe_All_Faces;
+
+    return index;
+}
+
+// levels sampled below the base level
+inline u32 get_reflection_probe_level_count(Reflection_Probes const *probes) {
+    return probes->level_count - 1 - probes->level;
+}
+
+// larger levels were not rendered since the probes went below them, so the rendered faces are scaled up into them.
+// either way every face is rendered again at the new level, one after the other
+void set_reflection_probe_level(Reflection_Probes *probes, u32 level) {
+    level = min(level, probes->level_count - 1);
+
+    if (level < probes->level) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, probes->mip_frame_buffer_objects[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, probes->mip_frame_buffer_objects[1]);
+
+        for (u32 i = 0; i < probes->count; i++) {
+            for (u32 face = 0; face < 6; face++) {
+                if (!(probes->probes[i].rendered_faces & (1 << face)))
+                    continue;
+
+                for (u32 source_level = probes->level; source_level > level; source_level--) {
+                    s32 size      = max(probes->resolution.width >> source_level, 1);
+                    s32 next_size = max(probes->resolution.width >> (source_level - 1), 1);
+
+                    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, source_level, i * 6 + face);
+                    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, source_level - 1, i * 6 + face);
+                    glBlitFramebuffer(0, 0, size, size, 0, 0, next_size, next_size, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                }
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    probes->level = level;
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, probes->texture_object);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+    // depth keeps level 0, the frame buffer renders to the smaller size of both
+    if (probes->layered_frame_buffer_object) {
+        glBindFramebuffer(GL_FRAMEBUFFER, probes->layered_frame_buffer_object);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, level);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    for (u32 i = 0; i < probes->count; i++)
+        probes->probes[i].due_faces = Reflection_Probe_All_Faces;
+}
+
+inline f32 get_squared_distance_to_box(vec3f point, vec3f box_min, vec3f box_max) {
+    f32 result = 0;
+    for (u32 i = 0; i < 3; i++) {
+        f32 outside = max(max(box_min.values[i] - point.values[i], point.values[i] - box_max.values[i]), 0.0f);
+        result += outside * outside;
+    }
+
+    return result;
+}
+
+// higher goes first
+f32 get_reflection_probe_priority(Reflection_Probe const *probe, vec3f camera_position) {
+    f32 urgency = 1.0f;
+
+    // nothing to blend before all faces are there
+    if (probe->rendered_faces != Reflection_Probe_All_Faces)
+        urgency += 4.0f;
+
+    if (probe->has_dynamic_items)
+        urgency += 2.0f;
+
+    f32 distance = sqrtf(get_squared_distance_to_box(camera_position, probe->influence_min, probe->influence_max));
+
+    return urgency * (1.0f + probe->waiting_seconds) / (1.0f + distance / Reflection_Probe_Priority_Distance);
+}
+
+// marks due faces and picks at most faces_per_frame of them, call after the render queue is sorted.
+// returns the number of faces written to faces
+u32 schedule_reflection_probe_faces(Reflection_Probes *probes, Render_Queue const *queue, u32 static_version, vec3f camera_position, f32 delta_seconds, Reflection_Probe_Face *faces) {
+    bool has_static_change = (probes->static_version != static_version);
+    probes->static_version = static_version;
+
+    for (u32 i = 0; i < probes->count; i++) {
+        auto probe = probes->probes + i;
+
+        // once more after the items left, so they do not stay in the reflection
+        if (probe->has_dynamic_items)
+            probe->needs_update = true;
+
+        probe->has_dynamic_items = false;
+
+        if (has_static_change)
+            probe->due_faces = Reflection_Probe_All_Faces;
+    }
+
+    // one pass over the queue, only dynamic items are tested against the boxes
+    for (u32 i = 0; i < queue->item_count; i++) {
+        auto item = queue->items + cast_v(u32, queue->sort_entries[i]);
+        if (item->flags & Draw_Item_Static)
+            continue;
+
+        vec3f center = vec3f{ queue->bounds.center_x[i], queue->bounds.center_y[i], queue->bounds.center_z[i] };
+        f32 radius = queue->bounds.radius[i];
+
+        for (u32 j = 0; j < probes->count; j++) {
+            auto probe = probes->probes + j;
+            if (!(probe->flags & Reflection_Probe_Static) && (get_squared_distance_to_box(center, probe->influence_min, probe->influence_max) <= radius * radius))
+                probe->has_dynamic_items = true;
+        }
+    }
+
+    u32 candidates[Reflection_Probe_Max_Count];
+    f32 priorities[Reflection_Probe_Max_Count];
+    u32 candidate_count = 0;
+
+    probes->due_face_count      = 0;
+    probes->rendered_face_count = 0;
+
+    for (u32 i = 0; i < probes->count; i++) {
+        auto probe = probes->probes + i;
+
+        // a started round of faces is finished first, so every face gets its turn
+        if (probe->has_dynamic_items)
+            probe->needs_update = true;
+
+        if (!probe->due_faces && probe->needs_update) {
+            probe->due_faces = Reflection_Probe_All_Faces;
+            probe->needs_update = false;
+        }
+
+        if (!probe->due_faces) {
+            probe->waiting_seconds = 0;
+            continue;
+        }
+
+        probe->waiting_seconds += delta_seconds;
+
+        for (u32 face = 0; face < 6; face++)
+            probes->due_face_count += (probe->due_faces >> face) & 1;
+
+        // insertion sort, highest priority first
+        f32 priority = get_reflection_probe_priority(probe, camera_position);
+        u32 slot = candidate_count++;
+        while ((slot > 0) && (priorities[slot - 1] < priority)) {
+            candidates[slot] = candidates[slot - 1];
+            priorities[slot] = priorities[slot - 1];
+            slot--;
+        }
+
+        candidates[slot] = i;
+        priorities[slot] = priority;
+    }
+
+    u32 face_budget = min(probes->faces_per_frame, Reflection_Probe_Max_Faces_Per_Frame);
+    u32 face_count = 0;
+
+    for (u32 i = 0; (i < candidate_count) && (face_count < face_budget); i++) {
+        auto probe = probes->probes + candidates[i];
+
+        for (u32 face = 0; (face < 6) && (face_count < face_budget); face++) {
+            if (probe->due_faces & (1 << face))
+                faces[face_count++] = { candidates[i], face };
+        }
+    }
+
+    return face_count;
+}
+
+// the faces starting at faces[first] are all 6 faces of one probe in order, as schedule_reflection_probe_faces picks them
+bool is_whole_reflection_probe(Reflection_Probe_Face const *faces, u32 face_count, u32 first) {
+    if (first + 6 > face_count)
+        return false;
+
+    for (u32 i = 0; i < 6; i++) {
+        if ((faces[first + i].probe != faces[first].probe) || (faces[first + i].face != i))
+            return false;
+    }
+
+    return true;
+}
+
+// renders into all 6 faces of the probe at the current level, followed by draws with First_Layer = probe * 6.
+// call end_reflection_probe_face for each face afterwards
+void begin_reflection_probe_layers(Reflection_Probes *probes, u32 probe) {
+    glDisable(GL_SCISSOR_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, probes->depth_clear_frame_buffer_object);
+    for (u32 face = 0; face < 6; face++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, probes->layered_depth_texture_object, 0, probe * 6 + face);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, probes->layered_frame_buffer_object);
+
+    s32 size = max(probes->resolution.width >> probes->level, 1);
+    glViewport(0, 0, size, size);
+}
+
+// renders into the face of the probe at the current level, followed by draws of the face's view
+void begin_reflection_probe_face(Reflection_Probes *probes, Reflection_Probe_Face face) {
+    glBindFramebuffer(GL_FRAMEBUFFER, probes->frame_buffer_object);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, probes->level, face.probe * 6 + face.face);
+
+    s32 size = max(probes->resolution.width >> probes->level, 1);
+    glViewport(0, 0, size, size);
+    glDisable(GL_SCISSOR_TEST);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+// builds the mip chain of the rendered face by blits, glGenerateMipmap would filter every layer of the array
+void end_reflection_probe_face(Reflection_Probes *probes, Reflection_Probe_Face face) {
+    u32 layer = face.probe * 6 + face.face;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, probes->mip_frame_buffer_objects[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, probes->mip_frame_buffer_objects[1]);
+
+    for (u32 level = probes->level; level + 1 < probes->level_count; level++) {
+        s32 size      = max(probes->resolution.width >> level, 1);
+        s32 next_size = max(size / 2, 1);
+
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, level, layer);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes->texture_object, level + 1, layer);
+        glBlitFramebuffer(0, 0, size, size, 0, 0, next_size, next_size, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    auto probe = probes->probes + face.probe;
+    u8 bit = cast_v(u8, 1 << face.face);
+    probe->due_faces      &= ~bit;
+    probe->rendered_faces |= bit;
+    probe->changed_faces  |= bit;
+
+    if (!probe->due_faces)
+        probe->waiting_seconds = 0;
+
+    probes->rendered_face_count++;
+}
+
+// finishes the pending read back and starts the next for a complete probe that changed,
+// one read back is in flight at a time
+void update_reflection_probe_irradiance(Reflection_Probes *probes) {
+    auto readback = &probes->irradiance_readback;
+    finish_irradiance_readback(readback, &probes->probes[probes->readback_probe].irradiance);
+
+    if (readback->is_pending)
+        return;
+
+    for (u32 i = 0; i < probes->count; i++) {
+        auto probe = probes->probes + i;
+
+        if ((probe->rendered_faces != Reflection_Probe_All_Faces) || !probe->changed_faces)
+            continue;
+
+        u32 level = probes->level;
+        while ((level + 1 < probes->level_count) && ((probes->resolution.width >> level) > cast_v(s32, Reflection_Probe_Irradiance_Size)))
+            level++;
+
+        begin_irradiance_readback(readback, probes->texture_object, level, max(probes->resolution.width >> level, 1), i * 6);
+        probes->readback_probe = i;
+        probe->changed_faces = 0;
+
+        break;
+    }
+}
+
+// the complete probes whose boxes are visible, nearest to the camera first
+void fill_reflection_probes_block(Scene_Reflection_Probes_Block *block, Reflection_Probes const *probes, Frustum const *frustum, vec3f camera_position) {
+    u32 indices[Reflection_Probe_Max_Count];
+    f32 distances[Reflection_Probe_Max_Count];
+    u32 count = 0;
+
+    for (u32 i = 0; i < probes->count; i++) {
+        auto probe = probes->probes + i;
+        if (probe->rendered_faces != Reflection_Probe_All_Faces)
+            continue;
+
+        vec3f center = (probe->influence_min + probe->influence_max) * 0.5f;
+        f32 radius = length(probe->influence_max - center);
+        if (!is_sphere_in_frustum(frustum, center, radius))
+            continue;
+
+        f32 distance = get_squared_distance_to_box(camera_position, probe->influence_min, probe->influence_max);
+
+        u32 slot = count++;
+        while ((slot > 0) && (distances[slot - 1] > distance)) {
+            indices[slot]   = indices[slot - 1];
+            distances[slot] = distances[slot - 1];
+            slot--;
+        }
+
+        indices[slot]   = i;
+        distances[slot] = distance;
+    }
+
+    block->count = min(count, Reflection_Probe_Max_Visible_Count);
+
+    for (u32 i = 0; i < block->count; i++) {
+        auto probe = probes->probes + indices[i];
+        auto uniforms = block->probes + i;
+
+        uniforms->position      = make_vec4(probe->position.x, probe->position.y, probe->position.z, cast_v(f32, indices[i]));
+        uniforms->influence_min = make_vec4(probe->influence_min.x, probe->influence_min.y, probe->influence_min.z, probe->blend_distance);
+        uniforms->influence_max = make_vec4(probe->influence_max.x, probe->influence_max.y, probe->influence_max.z, 0.0f);
+
+        for (u32 j = 0; j < SH_Coefficient_Count; j++)
+            uniforms->irradiance[j] = probe->irradiance.coefficients[j];
+    }
+}
+
+#endif // REFLECTION_PROBES_H
@@ -0,0 +1,578 @@
+#if !defined RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+// collects the draw items of a frame, sorts them by mesh and material
+// and merges items sharing a mesh into instanced draws.
+// per instance transforms and materials live in a texture buffer (see data/shaders/scene.shader.txt),
+// so a batch costs one uniform and one draw call, regardless of its instance count.
+// all passes of a frame use the same queue, it is sorted and uploaded once.
+// a queue is drawn with one program per pass, so the sort key only holds mesh and material.
+//
+// every pass draws a view of the queue, which holds the instances that pass its frustum.
+// the visible instance indices of all views go to a second texture buffer,
+// so the instance data itself is uploaded only once.
+// both are written to the frame's part of a Uniform_Ring, so uploads never wait on the gpu.
+//
+// a view may pick mesh lods per instance from the size of their error on screen (Lod_Selection),
+// its batches are split by lod inside each mesh.
+//
+// add_render_view only records a view, upload_render_queue culls and batches all of them.
+// with a job system every view is a job, next to jobs that write ranges of the instance data,
+// views only share the queue's read only parts, so they need no locks.
+
+#include "mesh_cook.h"
+#include "culling.h"
+#include "uniform_ring.h"
+
+struct Draw_Material {
+    vec4f diffuse_color;
+    vec4f specular_color;
+    f32 gloss;
+    f32 metalness;
+};
+
+// static items keep mesh and transform between frames, so passes may cache what they render of them
+enum Draw_Item_Flag {
+    Draw_Item_Static = 1 << 0,
+};
+
+struct Draw_Item {
+    Gpu_Mesh const *mesh;
+    Draw_Material material;
+    mat4x3f object_to_world;
+    u32 flags;
+};
+
+// 6 GL_RGBA32F texels, see scene.shader.txt
+struct Instance_Data {
+    vec4f object_to_world_rows[3];
+    vec4f diffuse_color;
+    vec4f specular_color;
+    vec4f gloss_metalness;
+};
+
+struct Render_Batch {
+    Gpu_Mesh const *mesh;
+    u32 first_instance;
+    u32 instance_count;
+    u32 lod;
+};
+
+u32 const Render_Queue_Max_Mesh_Count  = 256;
+// every mesh splits into at most one batch per lod
+u32 const Render_Queue_Max_Batch_Count = Render_Queue_Max_Mesh_Count * Gpu_Mesh_Max_Lod_Count;
+u32 const Render_Queue_Max_View_Count  = 16;
+
+// instance data is written in jobs of at least this many items, see upload_render_queue
+u32 const Render_Queue_Min_Job_Item_Count = 1024;
+u32 const Render_Queue_Max_Instance_Job_Count = 16;
+
+// a lod is used while its error covers at most this many pixels (times the view's bias)
+f32 const Lod_Max_Error_Pixels = 1.0f;
+
+struct Lod_Selection {
+    vec3f eye;
+
+    // pixels covered by one world unit at distance 1
+    f32 pixels_per_unit;
+    f32 max_error_pixels;
+};
+
+struct Render_View {
+    // what add_render_view recorded for build_render_view
+    Frustum frustum;
+    Lod_Selection lod_selection;
+    bool has_frustum;
+    bool has_lod_selection;
+    u32 flag_mask;
+    u32 flag_value;
+
+    // indices into the sorted instances, batches index this list
+    u32 *visible_instances;
+    u32 visible_count;
+
+    Render_Batch *batches;
+    u32 batch_count;
+
+    // of visible_instances in Instance_Buffer.visible_texture_object
+    u32 instance_offset;
+
+    // of all batches with their lods, for the debug overlay
+    u32 index_count;
+
+    // to group the visible instances of a mesh by lod
+    u8 *instance_lods;
+    u32 *lod_scratch;
+};
+
+struct Render_Queue {
+    u8_array memory;
+
+    Draw_Item *items;
+    u32 item_count;
+    u32 item_capacity;
+
+    // key in the high 32 bits, item index in the low 32 bits
+    u64 *sort_entries;
+    u64 *sort_scratch;
+
+    Gpu_Mesh const *meshs[Render_Queue_Max_Mesh_Count];
+    u32 mesh_count;
+
+    // world space bounds in sorted order, for culling
+    Bounding_Spheres bounds;
+
+    Render_View views[Render_Queue_Max_View_Count];
+    u32 view_count;
+    u32 *view_memory;
+    Render_Batch *view_batch_memory;
+
+    // lod scratch of all views, views are built in parallel
+    u32 *view_lod_scratch_memory;
+    u8 *view_instance_lod_memory;
+};
+
+// texture buffer views of the queue's instances and visible lists,
+// which are rebound to the frame's ranges of the uniform ring every upload
+struct Instance_Buffer {
+    GLuint texture_object;
+    GLuint visible_texture_object;
+};
+
+// item_capacity draw items per frame, the memory is kept and begin_render_queue empties the queue every frame
+void init_render_queue(Render_Queue *queue, Memory_Allocator *allocator, u32 item_capacity) {
+    *queue = {};
+
+    u32 padded_capacity = align_up(item_capacity, Bounding_Sphere_Lane_Count);
+
+    u32 items_size   = item_capacity * sizeof(Draw_Item);
+    u32 entries_size = item_capacity * sizeof(u64);
+    u32 bounds_size  = padded_capacity * sizeof(f32);
+    u32 views_size   = Render_Queue_Max_View_Count * padded_capacity * sizeof(u32);
+    u32 view_batches_size = Render_Queue_Max_View_Count * Render_Queue_Max_Batch_Count * sizeof(Render_Batch);
+    u32 lod_scratch_size  = Render_Queue_Max_View_Count * padded_capacity * sizeof(u32);
+    u32 instance_lods_size = Render_Queue_Max_View_Count * padded_capacity;
+
+    u8 *base = TRACK_GROW(allocator, &queue->memory, items_size + 2 * entries_size + 4 * bounds_size + views_size + view_batches_size + lod_scratch_size + instance_lods_size + 16);
+    base = cast_p(u8, (cast_v(size_t, base) + 15) & ~cast_v(size_t, 15));
+
+    queue->items         = cast_p(Draw_Item, base);
+    base += items_size;
+    queue->sort_entries  = cast_p(u64, base);
+    base += entries_size;
+    queue->sort_scratch  = cast_p(u64, base);
+    base += entries_size;
+
+    queue->bounds.center_x = cast_p(f32, base);
+    queue->bounds.center_y = queue->bounds.center_x + padded_capacity;
+    queue->bounds.center_z = queue->bounds.center_y + padded_capacity;
+    queue->bounds.radius   = queue->bounds.center_z + padded_capacity;
+    base += 4 * bounds_size;
+
+    queue->view_memory       = cast_p(u32, base);
+    base += views_size;
+    queue->view_batch_memory = cast_p(Render_Batch, base);
+    base += view_batches_size;
+    queue->view_lod_scratch_memory  = cast_p(u32, base);
+    base += lod_scratch_size;
+    queue->view_instance_lod_memory = base;
+
+    queue->item_capacity = item_capacity;
+}
+
+void begin_render_queue(Render_Queue *queue) {
+    queue->item_count   = 0;
+    queue->mesh_count   = 0;
+    queue->bounds.count = 0;
+    queue->view_count   = 0;
+}
+
+void free_render_queue(Render_Queue *queue, Memory_Allocator *allocator) {
+    TRACK_FREE_ARRAY(allocator, &queue->memory);
+    *queue = {};
+}
+
+void push_draw_item(Render_Queue *queue, Gpu_Mesh const *mesh, Draw_Material material, mat4x3f object_to_world, u32 flags = 0) {
+    assert(queue->item_count < queue->item_capacity);
+
+    auto item = queue->items + queue->item_count++;
+    item->mesh            = mesh;
+    item->material        = material;
+    item->object_to_world = object_to_world;
+    item->flags           = flags;
+}
+
+u32 get_mesh_slot(Render_Queue *queue, Gpu_Mesh const *mesh) {
+    for (u32 i = 0; i < queue->mesh_count; i++) {
+        if (queue->meshs[i] == mesh)
+            return i;
+    }
+
+    assert(queue->mesh_count < Render_Queue_Max_Mesh_Count);
+    queue->meshs[queue->mesh_count] = mesh;
+
+    return queue->mesh_count++;
+}
+
+// fnv-1a, only orders items inside a batch, so collisions are harmless
+u32 get_material_hash(Draw_Material const *material) {
+    u32 hash = 2166136261u;
+
+    auto bytes = cast_p(u8 const, material);
+    for (u32 i = 0; i < sizeof(Draw_Material); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    return hash;
+}
+
+// lsd radix sort over the 32 key bits, stable
+void sort_render_queue_entries(u64 *entries, u64 *scratch, u32 count) {
+    for (u32 shift = 32; shift < 64; shift += 8) {
+        u32 offsets[256] = {};
+
+        for (u32 i = 0; i < count; i++)
+            offsets[(entries[i] >> shift) & 0xFF]++;
+
+        u32 sum = 0;
+        for (u32 i = 0; i < 256; i++) {
+            u32 bucket_count = offsets[i];
+            offsets[i] = sum;
+            sum += bucket_count;
+        }
+
+        for (u32 i = 0; i < count; i++)
+            scratch[offsets[(entries[i] >> shift) & 0xFF]++] = entries[i];
+
+        u64 *temp = entries;
+        entries = scratch;
+        scratch = temp;
+    }
+
+    // 4 passes, so the result ends up in entries again
+}
+
+// sorts the items and computes their bounds
+void sort_render_queue(Render_Queue *queue) {
+    for (u32 i = 0; i < queue->item_count; i++) {
+        auto item = queue->items + i;
+
+        u32 key = (get_mesh_slot(queue, item->mesh) << 24) | (get_material_hash(&item->material) & 0xFFFFFF);
+        queue->sort_entries[i] = (cast_v(u64, key) << 32) | i;
+    }
+
+    sort_render_queue_entries(queue->sort_entries, queue->sort_scratch, queue->item_count);
+
+    for (u32 i = 0; i < queue->item_count; i++) {
+        auto item = queue->items + cast_v(u32, queue->sort_entries[i]);
+
+        // bounds scale with the largest axis, so they stay conservative
+        auto t = item->object_to_world;
+        f32 max_squared_scale = max(max(squared_length(t.columns[0]), squared_length(t.columns[1])), squared_length(t.columns[2]));
+        vec3f center = transform_point(t, item->mesh->bounding_sphere_center);
+
+        queue->bounds.center_x[i] = center.x;
+        queue->bounds.center_y[i] = center.y;
+        queue->bounds.center_z[i] = center.z;
+        queue->bounds.radius[i]   = item->mesh->bounding_sphere_radius * sqrtf(max_squared_scale);
+    }
+
+    queue->bounds.count = queue->item_count;
+}
+
+// bias > 1 allows coarser lods, for passes like shadows and reflections that blur or shrink what they render
+Lod_Selection make_lod_selection(vec3f eye, mat4f camera_to_clip, u32 viewport_height, f32 bias = 1.0f) {
+    Lod_Selection selection;
+    selection.eye              = eye;
+    selection.pixels_per_unit  = camera_to_clip.columns[1].y * viewport_height * 0.5f;
+    selection.max_error_pixels = Lod_Max_Error_Pixels * bias;
+
+    return selection;
+}
+
+// the coarsest lod whose error stays below the selection's pixel limit at the distance of the bounds
+u32 select_lod(Gpu_Mesh const *mesh, Lod_Selection const *selection, vec3f world_center, f32 world_radius) {
+    f32 distance = length(world_center - selection->eye);
+    if ((distance <= world_radius) || (mesh->bounding_sphere_radius <= 0))
+        return 0;
+
+    // world_radius is the mesh radius times the item's largest scale
+    f32 error_pixels_per_unit = (world_radius / mesh->bounding_sphere_radius) * selection->pixels_per_unit / distance;
+
+    u32 lod = 0;
+    while ((lod + 1 < mesh->lod_count) && (mesh->lod_errors[lod + 1] * error_pixels_per_unit <= selection->max_error_pixels))
+        lod++;
+
+    return lod;
+}
+
+// records a view, which upload_render_queue culls against the sorted instances, frustum 0 keeps all of them.
+// without lod_selection every instance uses lod 0.
+// with a flag_mask, only items with (flags & flag_mask) == flag_value are kept.
+// returns the view index for draw_render_queue
+u32 add_render_view(Render_Queue *queue, Frustum const *frustum, Lod_Selection const *lod_selection = 0, u32 flag_mask = 0, u32 flag_value = 0) {
+    assert(queue->view_count < Render_Queue_Max_View_Count);
+
+    u32 view_index = queue->view_count++;
+    auto view = queue->views + view_index;
+
+    *view = {};
+
+    if (frustum) {
+        view->frustum     = *frustum;
+        view->has_frustum = true;
+    }
+
+    if (lod_selection) {
+        view->lod_selection     = *lod_selection;
+        view->has_lod_selection = true;
+    }
+
+    view->flag_mask  = flag_mask;
+    view->flag_value = flag_value;
+
+    u32 padded_capacity = align_up(queue->item_capacity, Bounding_Sphere_Lane_Count);
+    view->visible_instances = queue->view_memory + view_index * padded_capacity;
+    view->batches           = queue->view_batch_memory + view_index * Render_Queue_Max_Batch_Count;
+    view->lod_scratch       = queue->view_lod_scratch_memory + view_index * padded_capacity;
+    view->instance_lods     = queue->view_instance_lod_memory + view_index * padded_capacity;
+
+    return view_index;
+}
+
+// culls the instances of a view and batches the visible ones, only writes to the view
+void build_render_view(Render_Queue const *queue, Render_View *view) {
+    if (view->has_frustum) {
+        view->visible_count = cull_bounding_spheres(&view->frustum, &queue->bounds, view->visible_instances);
+    }
+    else {
+        for (u32 i = 0; i < queue->item_count; i++)
+            view->visible_instances[i] = i;
+
+        view->visible_count = queue->item_count;
+    }
+
+    if (view->flag_mask) {
+        u32 visible_count = 0;
+
+        for (u32 i = 0; i < view->visible_count; i++) {
+            u32 instance = view->visible_instances[i];
+            auto item = queue->items + cast_v(u32, queue->sort_entries[instance]);
+
+            view->visible_instances[visible_count] = instance;
+            visible_count += ((item->flags & view->flag_mask) == view->flag_value);
+        }
+
+        view->visible_count = visible_count;
+    }
+
+    auto lod_selection = view->has_lod_selection ? &view->lod_selection : 0;
+
+    // instances are sorted by mesh, so the visible ones are too
+    u32 run_begin = 0;
+    while (run_begin < view->visible_count) {
+        auto mesh = queue->items[cast_v(u32, queue->sort_entries[view->visible_instances[run_begin]])].mesh;
+
+        u32 run_end = run_begin + 1;
+        while ((run_end < view->visible_count) && (queue->items[cast_v(u32, queue->sort_entries[view->visible_instances[run_end]])].mesh == mesh))
+            run_end++;
+
+        u32 lod_counts[Gpu_Mesh_Max_Lod_Count] = {};
+
+        if (lod_selection && (mesh->lod_count > 1)) {
+            for (u32 i = run_begin; i < run_end; i++) {
+                u32 instance = view->visible_instances[i];
+                vec3f center = vec3f{ queue->bounds.center_x[instance], queue->bounds.center_y[instance], queue->bounds.center_z[instance] };
+
+                u32 lod = select_lod(mesh, lod_selection, center, queue->bounds.radius[instance]);
+                view->instance_lods[i] = cast_v(u8, lod);
+                lod_counts[lod]++;
+            }
+
+            // stable counting sort of the run by lod
+            u32 lod_offsets[Gpu_Mesh_Max_Lod_Count];
+            u32 offset = run_begin;
+            for (u32 lod = 0; lod < Gpu_Mesh_Max_Lod_Count; lod++) {
+                lod_offsets[lod] = offset;
+                offset += lod_counts[lod];
+            }
+
+            for (u32 i = run_begin; i < run_end; i++)
+                view->lod_scratch[lod_offsets[view->instance_lods[i]]++] = view->visible_instances[i];
+
+            memcpy(view->visible_instances + run_begin, view->lod_scratch + run_begin, (run_end - run_begin) * sizeof(u32));
+        }
+        else {
+            lod_counts[0] = run_end - run_begin;
+        }
+
+        u32 first_instance = run_begin;
+        for (u32 lod = 0; lod < Gpu_Mesh_Max_Lod_Count; lod++) {
+            if (!lod_counts[lod])
+                continue;
+
+            assert(view->batch_count < Render_Queue_Max_Batch_Count);
+
+            auto batch = view->batches + view->batch_count++;
+            batch->mesh           = mesh;
+            batch->first_instance = first_instance;
+            batch->instance_count = lod_counts[lod];
+            batch->lod            = lod;
+
+            first_instance    += lod_counts[lod];
+            view->index_count += lod_counts[lod] * mesh->lod_index_counts[lod];
+        }
+
+        run_begin = run_end;
+    }
+}
+
+void init_instance_buffer(Instance_Buffer *instance_buffer) {
+    *instance_buffer = {};
+
+    glGenTextures(1, &instance_buffer->texture_object);
+    glGenTextures(1, &instance_buffer->visible_texture_object);
+}
+
+void upload_render_views(Render_Queue *queue, Instance_Buffer *instance_buffer, Uniform_Ring *ring) {
+    u32 visible_count = 0;
+    for (u32 i = 0; i < queue->view_count; i++) {
+        queue->views[i].instance_offset = visible_count;
+        visible_count += queue->views[i].visible_count;
+    }
+
+    if (!visible_count)
+        return;
+
+    auto range = push_uniform_range(ring, visible_count * sizeof(u32));
+    auto visible_instances = cast_p(u32, range.data);
+
+    for (u32 i = 0; i < queue->view_count; i++) {
+        auto view = queue->views + i;
+        memcpy(visible_instances + view->instance_offset, view->visible_instances, view->visible_count * sizeof(u32));
+    }
+
+    flush_uniform_range(ring, range);
+
+    glBindTexture(GL_TEXTURE_BUFFER, instance_buffer->visible_texture_object);
+    glTexBufferRange(GL_TEXTURE_BUFFER, GL_R32UI, range.buffer_object, range.offset, range.size);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void write_instance_data(Render_Queue const *queue, Instance_Data *instances, u32 begin, u32 end) {
+    for (u32 i = begin; i < end; i++) {
+        auto item = queue->items + cast_v(u32, queue->sort_entries[i]);
+        auto instance = instances + i;
+
+        auto t = get_vertex_to_world(item->mesh, item->object_to_world);
+        instance->object_to_world_rows[0] = make_vec4(t.columns[0].x, t.columns[1].x, t.columns[2].x, t.columns[3].x);
+        instance->object_to_world_rows[1] = make_vec4(t.columns[0].y, t.columns[1].y, t.columns[2].y, t.columns[3].y);
+        instance->object_to_world_rows[2] = make_vec4(t.columns[0].z, t.columns[1].z, t.columns[2].z, t.columns[3].z);
+
+        instance->diffuse_color   = item->material.diffuse_color;
+        instance->specular_color  = item->material.specular_color;
+        instance->gloss_metalness = make_vec4(item->material.gloss, item->material.metalness, 0, 0);
+    }
+}
+
+struct Render_View_Job {
+    Render_Queue const *queue;
+    Render_View *view;
+};
+
+void render_view_job(Job_Worker *worker, void *data) {
+    auto job = cast_p(Render_View_Job, data);
+    build_render_view(job->queue, job->view);
+}
+
+struct Instance_Data_Job {
+    Render_Queue const *queue;
+    Instance_Data *instances;
+    u32 begin;
+    u32 end;
+};
+
+void instance_data_job(Job_Worker *worker, void *data) {
+    auto job = cast_p(Instance_Data_Job, data);
+    write_instance_data(job->queue, job->instances, job->begin, job->end);
+}
+
+// builds the views added since begin_render_queue and writes the instances in sorted order
+// and the visible instances of all views to the frame's part of ring.
+// with jobs, the views and ranges of the instances are built in parallel, the gl calls stay on the calling thread.
+// call after sort_render_queue and add_render_view
+void upload_render_queue(Render_Queue *queue, Instance_Buffer *instance_buffer, Uniform_Ring *ring, Job_System *jobs = 0) {
+    // the ring is only touched on the calling thread
+    Uniform_Range instance_range = {};
+    if (queue->item_count)
+        instance_range = push_uniform_range(ring, queue->item_count * sizeof(Instance_Data));
+
+    auto instances = cast_p(Instance_Data, instance_range.data);
+
+    if (!jobs || (jobs->worker_count < 2)) {
+        for (u32 i = 0; i < queue->view_count; i++)
+            build_render_view(queue, queue->views + i);
+
+        write_instance_data(queue, instances, 0, queue->item_count);
+    }
+    else {
+        u32 volatile pending_count = 0;
+
+        Render_View_Job view_jobs[Render_Queue_Max_View_Count];
+        for (u32 i = 0; i < queue->view_count; i++) {
+            view_jobs[i] = { queue, queue->views + i };
+            push_job(jobs, render_view_job, view_jobs + i, &pending_count);
+        }
+
+        u32 job_count = min(jobs->worker_count, Render_Queue_Max_Instance_Job_Count);
+        u32 items_per_job = max((queue->item_count + job_count - 1) / job_count, Render_Queue_Min_Job_Item_Count);
+
+        Instance_Data_Job instance_jobs[Render_Queue_Max_Instance_Job_Count];
+        job_count = 0;
+        for (u32 begin = 0; begin < queue->item_count; begin += items_per_job) {
+            auto job = instance_jobs + job_count++;
+            *job = { queue, instances, begin, min(begin + items_per_job, queue->item_count) };
+            push_job(jobs, instance_data_job, job, &pending_count);
+        }
+
+        wait_for_jobs(jobs, &pending_count);
+    }
+
+    upload_render_views(queue, instance_buffer, ring);
+
+    if (!queue->item_count)
+        return;
+
+    flush_uniform_range(ring, instance_range);
+
+    glBindTexture(GL_TEXTURE_BUFFER, instance_buffer->texture_object);
+    glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGBA32F, instance_range.buffer_object, instance_range.offset, instance_range.size);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+struct Instance_Uniforms {
+    GLint instances;
+    GLint visible_instances;
+    GLint instance_offset;
+};
+
+// the scene program has to be bound, uses texture_slot and texture_slot + 1
+void draw_render_queue(Render_Queue const *queue, u32 view_index, Instance_Buffer const *instance_buffer, Instance_Uniforms const *uniforms, u32 texture_slot) {
+    auto view = queue->views + view_index;
+
+    glUniform1i(uniforms->instances, texture_slot);
+    glActiveTexture(GL_TEXTURE0 + texture_slot);
+    glBindTexture(GL_TEXTURE_BUFFER, instance_buffer->texture_object);
+
+    glUniform1i(uniforms->visible_instances, texture_slot + 1);
+    glActiveTexture(GL_TEXTURE0 + texture_slot + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, instance_buffer->visible_texture_object);
+
+    for (u32 i = 0; i < view->batch_count; i++) {
+        auto batch = view->batches + i;
+
+        glUniform1i(uniforms->instance_offset, view->instance_offset + batch->first_instance);
+        draw_instanced(*batch->mesh, batch->instance_count, batch->lod);
+    }
+}
+
+#endif // RENDER_QUEUE_H
@@ -0,0 +1,50 @@
+#if !defined REPORT_H
+#define REPORT_H
+
+// text reports of benchmarks and stats, printed into a caller's buffer and written as one file.
+// what does not fit is cut off
+
+#include <stdio.h>
+#include <stdarg.h>
+
+struct Report {
+    char *data;
+    u32 count;
+    u32 capacity;
+};
+
+Report make_report(char *buffer, u32 capacity) {
+    Report report;
+    report.data     = buffer;
+    report.count    = 0;
+    report.capacity = capacity;
+
+    return report;
+}
+
+// printf
+void report_write(Report *report, char const *format, ...) {
+    if (report->count + 1 >= report->capacity)
+        return;
+
+    va_list arguments;
+    va_start(arguments, format);
+    s32 count = vsnprintf(report->data + report->count, report->capacity - report->count, format, arguments);
+    va_end(arguments);
+
+    if (count > 0)
+        report->count = min(report->count + cast_v(u32, count), report->capacity - 1);
+}
+
+bool report_is_full(Report const *report) {
+    return (report->count + 1 >= report->capacity);
+}
+
+void write_report(Report const *report, Platform_API *platform_api, string path) {
+    u8_array file;
+    file.data  = cast_p(u8, report->data);
+    file.count = report->count;
+    platform_api->write_entire_file(path, file);
+}
+
+#endif // REPORT_H
@@ -0,0 +1,251 @@
+#if !defined SCENE_H
+#define SCENE_H
+
+// scene objects as structure of arrays.
+// an object has a local transform relative to its parent and a cached world transform,
+// which update_scene_transforms only recomputes for objects marked dirty and their descendants.
+// parents are added before their children, so a parent's index is always lower than its child's.
+// with many dirty objects, the update is split into jobs, one hierarchy depth after the other.
+// dirty children are combined with their parents in batches by the simd kernels of transform_batch.h.
+// all passes read the cached world transforms through the render queue (queue_scene_objects).
+
+#include "jobs.h"
+#include "render_queue.h"
+#include "transform_batch.h"
+
+u32 const Scene_No_Parent = 0xFFFFFFFF;
+
+// below this many dirty objects, the update runs on the calling thread
+u32 const Scene_Min_Parallel_Update_Count = 4096;
+u32 const Scene_Min_Update_Job_Object_Count = 1024;
+
+// dirty children collected before they are combined at once
+u32 const Scene_Transform_Batch_Count = 256;
+
+enum Scene_Object_Flag {
+    // the object is not expected to move, moving it anyway invalidates caches of static objects
+    Scene_Object_Static = 1 << 0,
+};
+
+struct Scene {
+    u8_array memory;
+
+    u32 count;
+    u32 capacity;
+
+    // objects without mesh only group their children
+    Gpu_Mesh const **meshs;
+    u32 *material_indices;
+    u32 *parents;
+    u32 *flags;
+    u8 *depths;
+    u8 *is_dirty;
+    mat4x3f *local_transforms;
+    mat4x3f *world_transforms;
+
+    Draw_Material *materials;
+    u32 material_count;
+    u32 material_capacity;
+
+    u8 max_depth;
+    u32 dirty_count;
+
+    // changes whenever a static object is added or moved
+    u32 static_version;
+
+    // of the last update_scene_transforms
+    u32 updated_count;
+};
+
+void init_scene(Scene *scene, Memory_Allocator *allocator, u32 capacity, u32 material_capacity) {
+    *scene = {};
+
+    u32 transforms_size = capacity * sizeof(mat4x3f);
+    u32 pointers_size   = capacity * sizeof(Gpu_Mesh const *);
+    u32 indices_size    = capacity * sizeof(u32);
+    u32 materials_size  = material_capacity * sizeof(Draw_Material);
+
+    u8 *base = TRACK_GROW(allocator, &scene->memory, 2 * transforms_size + pointers_size + 3 * indices_size + materials_size + 2 * capacity + 16);
+    base = cast_p(u8, (cast_v(size_t, base) + 15) & ~cast_v(size_t, 15));
+
+    // largest alignment first
+    scene->local_transforms = cast_p(mat4x3f, base);
+    base += transforms_size;
+    scene->world_transforms = cast_p(mat4x3f, base);
+    base += transforms_size;
+    scene->materials        = cast_p(Draw_Material, base);
+    base += materials_size;
+    scene->meshs            = cast_p(Gpu_Mesh const *, base);
+    base += pointers_size;
+    scene->material_indices = cast_p(u32, base);
+    base += indices_size;
+    scene->parents          = cast_p(u32, base);
+    base += indices_size;
+    scene->flags            = cast_p(u32, base);
+    base += indices_size;
+    scene->depths           = base;
+    base += capacity;
+    scene->is_dirty         = base;
+
+    scene->capacity          = capacity;
+    scene->material_capacity = material_capacity;
+}
+
+void free_scene(Scene *scene, Memory_Allocator *allocator) {
+    TRACK_FREE_ARRAY(allocator, &scene->memory);
+    *scene = {};
+}
+
+u32 add_scene_material(Scene *scene, Draw_Material material) {
+    assert(scene->material_count < scene->material_capacity);
+    scene->materials[scene->material_count] = material;
+
+    return scene->material_count++;
+}
+
+// mesh may be 0, parent is Scene_No_Parent or a previously added object
+u32 add_scene_object(Scene *scene, u32 parent, Gpu_Mesh const *mesh, u32 material_index, mat4x3f local_transform, u32 flags = 0) {
+    assert(scene->count < scene->capacity);
+    assert((parent == Scene_No_Parent) || (parent < scene->count));
+    assert(!mesh || (material_index < scene->material_count));
+
+    u32 index = scene->count++;
+    scene->meshs[index]            = mesh;
+    scene->material_indices[index] = material_index;
+    scene->parents[index]          = parent;
+    scene->flags[index]            = flags;
+    scene->local_transforms[index] = local_transform;
+    scene->is_dirty[index]         = true;
+    scene->dirty_count++;
+
+    u32 depth = 0;
+    if (parent != Scene_No_Parent) {
+        depth = scene->depths[parent] + 1;
+        assert(depth <= 255);
+    }
+
+    scene->depths[index] = cast_v(u8, depth);
+    scene->max_depth = max(scene->max_depth, cast_v(u8, depth));
+
+    if (flags & Scene_Object_Static)
+        scene->static_version++;
+
+    return index;
+}
+
+void set_scene_object_transform(Scene *scene, u32 index, mat4x3f local_transform) {
+    scene->local_transforms[index] = local_transform;
+
+    if (!scene->is_dirty[index]) {
+        scene->is_dirty[index] = true;
+        scene->dirty_count++;
+    }
+
+    if (scene->flags[index] & Scene_Object_Static)
+        scene->static_version++;
+}
+
+// updates the dirty objects of one depth in [begin, end), their parents are up to date.
+// a batch only holds objects of one depth, so none of them is the parent of another
+void update_scene_transform_range(Scene *scene, u32 begin, u32 end, u32 depth) {
+    u32 batch[Scene_Transform_Batch_Count];
+    u32 batch_count = 0;
+
+    for (u32 i = begin; i < end; i++) {
+        if (!scene->is_dirty[i] || (scene->depths[i] != depth))
+            continue;
+
+        scene->is_dirty[i] = false;
+
+        if (scene->parents[i] == Scene_No_Parent) {
+            scene->world_transforms[i] = scene->local_transforms[i];
+            continue;
+        }
+
+        batch[batch_count++] = i;
+
+        if (batch_count == Scene_Transform_Batch_Count) {
+            combine_transforms_indexed(scene->world_transforms, scene->world_transforms, scene->local_transforms, scene->parents, batch, batch_count);
+            batch_count = 0;
+        }
+    }
+
+    combine_transforms_indexed(scene->world_transforms, scene->world_transforms, scene->local_transforms, scene->parents, batch, batch_count);
+}
+
+struct Scene_Transform_Job {
+    Scene *scene;
+    u32 begin;
+    u32 end;
+    u32 depth;
+};
+
+void scene_transform_job(Job_Worker *worker, void *data) {
+    auto job = cast_p(Scene_Transform_Job, data);
+    update_scene_transform_range(job->scene, job->begin, job->end, job->depth);
+}
+
+// recomputes the world transforms of dirty objects and their descendants, jobs may be 0
+void update_scene_transforms(Scene *scene, Job_System *jobs) {
+    scene->updated_count = 0;
+
+    if (!scene->dirty_count)
+        return;
+
+    // children of dirty parents are dirty too, parents come first
+    u32 dirty_count = 0;
+    for (u32 i = 0; i < scene->count; i++) {
+        u32 parent = scene->parents[i];
+        if ((parent != Scene_No_Parent) && scene->is_dirty[parent])
+            scene->is_dirty[i] = true;
+
+        dirty_count += scene->is_dirty[i];
+    }
+
+    scene->updated_count = dirty_count;
+    scene->dirty_count   = 0;
+
+    if (!jobs || (jobs->worker_count < 2) || (dirty_count < Scene_Min_Parallel_Update_Count)) {
+        for (u32 depth = 0; depth <= scene->max_depth; depth++)
+            update_scene_transform_range(scene, 0, scene->count, depth);
+
+        return;
+    }
+
+    // a few jobs per worker balance uneven dirty ranges
+    u32 job_count = min(jobs->worker_count * 4, Job_Queue_Capacity);
+    u32 objects_per_job = max((scene->count + job_count - 1) / job_count, Scene_Min_Update_Job_Object_Count);
+    job_count = (scene->count + objects_per_job - 1) / objects_per_job;
+
+    Scene_Transform_Job transform_jobs[Job_Queue_Capacity];
+    u32 volatile pending_count = 0;
+
+    for (u32 depth = 0; depth <= scene->max_depth; depth++) {
+        for (u32 i = 0; i < job_count; i++) {
+            auto job = transform_jobs + i;
+            job->scene = scene;
+            job->begin = i * objects_per_job;
+            job->end   = min(job->begin + objects_per_job, scene->count);
+            job->depth = depth;
+
+            push_job(jobs, scene_transform_job, job, &pending_count);
+        }
+
+        // other groups, like the simulation of the next frame, keep running
+        wait_for_jobs(jobs, &pending_count);
+    }
+}
+
+// every object with a mesh becomes a draw item with its cached world transform
+void queue_scene_objects(Scene const *scene, Render_Queue *queue) {
+    for (u32 i = 0; i < scene->count; i++) {
+        auto mesh = scene->meshs[i];
+        if (!mesh)
+            continue;
+
+        u32 flags = (scene->flags[i] & Scene_Object_Static) ? Draw_Item_Static : 0;
+        push_draw_item(queue, mesh, scene->materials[scene->material_indices[i]], scene->world_transforms[i], flags);
+    }
+}
+
+#endif // SCENE_H
@@ -0,0 +1,367 @@
+#if !defined SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+// loads the demo's own shaders (data/shaders), which may have a geometry stage.
+// a shader file holds all stages, each compiled with VERTEX_SHADER, GEOMETRY_SHADER or FRAGMENT_SHADER defined.
+// like load_shader, uniform locations are written to an array in the order of a comma separated name list.
+// linked programs are cached as driver binaries next to their source (see Program_Binary_Header),
+// a cached binary is only used if source, defines and driver match, otherwise the program is compiled again.
+
+#include <stdio.h>
+
+// uniform blocks of the demo shaders use fixed binding points above the ones mooselib uses
+enum {
+    Scene_Camera_Binding   = 8,
+    Scene_Lighting_Binding = 9,
+    Scene_Reflection_Probes_Binding = 10,
+};
+
+struct Uniform_Block_Binding {
+    char const *name;
+    GLuint binding;
+};
+
+Uniform_Block_Binding const Demo_Uniform_Block_Bindings[] = {
+    { "Scene_Camera",   Scene_Camera_Binding },
+    { "Scene_Lighting", Scene_Lighting_Binding },
+    { "Scene_Reflection_Probes", Scene_Reflection_Probes_Binding },
+};
+
+// std140 mirrors of the blocks in data/shaders, Scene_Reflection_Probes is in reflection_probes.h
+
+// one matrix per cube map layer, single views only use index 0
+struct Scene_Camera_Block {
+    mat4f world_to_clip[6];
+    mat4f clip_to_world[6];
+    vec4f world_position;
+};
+
+u32 const Scene_Max_Light_Count = 16;
+
+// directional lights come first, parameters hold their direction,
+// point lights hold position and attenuation factor k in w
+struct Scene_Lighting_Block {
+    vec4f global_ambient_color;
+    u32 directional_light_count;
+    u32 point_light_count;
+    u32 padding[2];
+    vec4f parameters[Scene_Max_Light_Count];
+    vec4f colors[Scene_Max_Light_Count];
+};
+
+u32 const Program_Binary_Magic   = 'G' | ('L' << 8) | ('P' << 16) | ('B' << 24);
+u32 const Program_Binary_Version = 1;
+
+// file layout: Program_Binary_Header, then the binary from glGetProgramBinary
+struct Program_Binary_Header {
+    u32 magic;
+    u32 version;
+    u32 size;
+    u32 binary_format;
+
+    // of source, defines, stages and the driver strings
+    u64 key;
+};
+
+// for the debug overlay
+struct Program_Binary_Cache_Stats {
+    u32 loaded_count;
+    u32 compiled_count;
+    u32 rejected_count;
+};
+
+Program_Binary_Cache_Stats global_program_binary_cache_stats;
+
+// fnv-1a
+u64 hash_bytes(u64 hash, u8 const *bytes, u32 count) {
+    for (u32 i = 0; i < count; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+
+    return hash;
+}
+
+u64 hash_c_string(u64 hash, char const *text) {
+    if (!text)
+        return hash;
+
+    return hash_bytes(hash, cast_p(u8 const, text), cast_v(u32, strlen(text)));
+}
+
+// program binaries need GL_ARB_get_program_binary (gl 4.1) and a driver with at least one binary format
+bool can_cache_program_binaries() {
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+
+    return (format_count > 0);
+}
+
+u64 get_program_binary_key(string source, string defines, bool with_geometry_shader) {
+    u64 key = 14695981039346656037ull;
+    key = hash_bytes(key, source.data, source.count);
+    key = hash_bytes(key, defines.data, defines.count);
+    key = hash_bytes(key, cast_p(u8 const, &with_geometry_shader), sizeof(with_geometry_shader));
+
+    // a driver update may change the binary, even if the format stays the same
+    key = hash_c_string(key, cast_p(char const, glGetString(GL_VENDOR)));
+    key = hash_c_string(key, cast_p(char const, glGetString(GL_RENDERER)));
+    key = hash_c_string(key, cast_p(char const, glGetString(GL_VERSION)));
+
+    return key;
+}
+
+// one file per path and defines, so permutations of a shader do not evict each other
+// and an outdated binary is overwritten instead of piling up
+string write_program_binary_path(char *buffer, u32 buffer_size, string path, string defines, bool with_geometry_shader) {
+    u64 defines_hash = hash_bytes(14695981039346656037ull, defines.data, defines.count);
+    defines_hash = hash_bytes(defines_hash, cast_p(u8 const, &with_geometry_shader), sizeof(with_geometry_shader));
+
+    s32 count = snprintf(buffer, buffer_size, "%.*s.%08x.glpb", cast_v(s32, path.count), cast_p(char const, path.data), cast_v(u32, defines_hash));
+
+    string result = {};
+    result.data  = cast_p(u8, buffer);
+    result.count = min(cast_v(u32, max(count, 0)), buffer_size - 1);
+
+    return result;
+}
+
+// returns 0 if there is no matching binary or the driver rejects it
+GLuint load_program_binary(Platform_API *platform_api, Memory_Allocator *allocator, string binary_path, u64 key) {
+    auto blob = TRACK_READ_ENTIRE_FILE(platform_api, binary_path, allocator);
+    if (!blob.count)
+        return 0;
+
+    defer { TRACK_FREE_ARRAY(allocator, &blob); };
+
+    auto header = cast_p(Program_Binary_Header, blob.data);
+    if ((blob.count < sizeof(Program_Binary_Header)) || (header->magic != Program_Binary_Magic) || (header->version != Program_Binary_Version) || (header->size > blob.count) || (header->size < sizeof(Program_Binary_Header)))
+        return 0;
+
+    // source or driver changed
+    if (header->key != key)
+        return 0;
+
+    GLuint program_object = glCreateProgram();
+    glProgramBinary(program_object, header->binary_format, blob.data + sizeof(Program_Binary_Header), header->size - sizeof(Program_Binary_Header));
+
+    GLint ok;
+    glGetProgramiv(program_object, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        global_program_binary_cache_stats.rejected_count++;
+
+        glDeleteProgram(program_object);
+        return 0;
+    }
+
+    return program_object;
+}
+
+void save_program_binary(Platform_API *platform_api, Memory_Allocator *allocator, string binary_path, u64 key, GLuint program_object) {
+    GLint binary_size = 0;
+    glGetProgramiv(program_object, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+    if (binary_size <= 0)
+        return;
+
+    u8_array blob = {};
+    u8 *base = TRACK_GROW(allocator, &blob, sizeof(Program_Binary_Header) + binary_size);
+    defer { TRACK_FREE_ARRAY(allocator, &blob); };
+
+    auto header = cast_p(Program_Binary_Header, base);
+    *header = {};
+    header->magic   = Program_Binary_Magic;
+    header->version = Program_Binary_Version;
+    header->key     = key;
+
+    GLsizei written_size = 0;
+    GLenum binary_format = 0;
+    glGetProgramBinary(program_object, binary_size, &written_size, &binary_format, base + sizeof(Program_Binary_Header));
+    if (written_size <= 0)
+        return;
+
+    header->binary_format = binary_format;
+    header->size          = sizeof(Program_Binary_Header) + written_size;
+
+    u8_array file = {};
+    file.data  = base;
+    file.count = header->size;
+
+    platform_api->write_entire_file(binary_path, file);
+}
+
+GLuint compile_shader_stage(GLenum stage, char const *stage_define, string defines, string source) {
+    char header[256];
+    snprintf(header, sizeof(header), "#version 330 core\n#define %s\n", stage_define);
+
+    char const *sources[] = {
+        header,
+        defines.count ? cast_p(char const, defines.data) : "", // EMPTY_STRING has no data
+        "\n#line 1\n",
+        cast_p(char const, source.data),
+    };
+
+    GLint lengths[] = {
+        -1,
+        cast_v(GLint, defines.count),
+        -1,
+        cast_v(GLint, source.count),
+    };
+
+    GLuint shader_object = glCreateShader(stage);
+    glShaderSource(shader_object, ARRAY_COUNT(sources), sources, lengths);
+    glCompileShader(shader_object);
+
+    GLint ok;
+    glGetShaderiv(shader_object, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[2048];
+        glGetShaderInfoLog(shader_object, sizeof(log), 0, log);
+        printf("%s compile error:\n%s\n", stage_define, log);
+
+        glDeleteShader(shader_object);
+        return 0;
+    }
+
+    return shader_object;
+}
+
+// uniform_names like "a, b.c, d", empty names are skipped
+void get_uniform_locations(GLuint program_object, GLint *uniforms, u32 uniform_count, string uniform_names) {
+    u32 uniform_index = 0;
+    u32 start = 0;
+
+    for (u32 i = 0; i <= uniform_names.count; i++) {
+        if ((i < uniform_names.count) && (uniform_names.data[i] != ','))
+            continue;
+
+        u32 end = i;
+        while ((start < end) && (uniform_names.data[start] == ' '))
+            start++;
+
+        while ((end > start) && (uniform_names.data[end - 1] == ' '))
+            end--;
+
+        if (end > start) {
+            assert(uniform_index < uniform_count);
+
+            char name[128];
+            string name_string = {};
+            name_string.data  = uniform_names.data + start;
+            name_string.count = end - start;
+
+            bool ok = copy_to_c_string(name, sizeof(name), name_string);
+            assert(ok);
+
+            uniforms[uniform_index++] = glGetUniformLocation(program_object, name);
+        }
+
+        start = i + 1;
+    }
+
+    assert(uniform_index == uniform_count);
+}
+
+GLuint link_program(GLuint *shader_objects, u32 shader_count, bool is_retrievable = false) {
+    GLuint program_object = glCreateProgram();
+
+    if (is_retrievable)
+        glProgramParameteri(program_object, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    for (u32 i = 0; i < shader_count; i++)
+        glAttachShader(program_object, shader_objects[i]);
+
+    glLinkProgram(program_object);
+
+    for (u32 i = 0; i < shader_count; i++) {
+        glDetachShader(program_object, shader_objects[i]);
+        glDeleteShader(shader_objects[i]);
+    }
+
+    GLint ok;
+    glGetProgramiv(program_object, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[2048];
+        glGetProgramInfoLog(program_object, sizeof(log), 0, log);
+        printf("link error:\n%s\n", log);
+
+        glDeleteProgram(program_object);
+        return 0;
+    }
+
+    return program_object;
+}
+
+void bind_demo_uniform_blocks(GLuint program_object) {
+    for (u32 i = 0; i < ARRAY_COUNT(Demo_Uniform_Block_Bindings); i++) {
+        GLuint block_index = glGetUniformBlockIndex(program_object, Demo_Uniform_Block_Bindings[i].name);
+        if (block_index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program_object, block_index, Demo_Uniform_Block_Bindings[i].binding);
+    }
+}
+
+// defines are inserted after the #version line, like "#define REFLECTION_PROBES\n"
+GLuint load_program(Platform_API *platform_api, Memory_Allocator *allocator, GLint *uniforms, u32 uniform_count, string path, string defines, string uniform_names, bool with_geometry_shader = false) {
+    auto source = TRACK_READ_ENTIRE_FILE(platform_api, path, allocator);
+    if (!source.count)
+        return 0;
+
+    defer { TRACK_FREE_ARRAY(allocator, &source); };
+
+    string source_string = {};
+    source_string.data  = source.data;
+    source_string.count = source.count;
+
+    bool use_binary_cache = can_cache_program_binaries();
+
+    char binary_path_buffer[512];
+    string binary_path = {};
+    u64 key = 0;
+
+    if (use_binary_cache) {
+        binary_path = write_program_binary_path(binary_path_buffer, sizeof(binary_path_buffer), path, defines, with_geometry_shader);
+        key = get_program_binary_key(source_string, defines, with_geometry_shader);
+
+        GLuint program_object = load_program_binary(platform_api, allocator, binary_path, key);
+        if (program_object) {
+            global_program_binary_cache_stats.loaded_count++;
+
+            get_uniform_locations(program_object, uniforms, uniform_count, uniform_names);
+            bind_demo_uniform_blocks(program_object);
+
+            return program_object;
+        }
+    }
+
+    GLuint shader_objects[3];
+    u32 shader_count = 0;
+
+    shader_objects[shader_count++] = compile_shader_stage(GL_VERTEX_SHADER, "VERTEX_SHADER", defines, source_string);
+
+    if (with_geometry_shader)
+        shader_objects[shader_count++] = compile_shader_stage(GL_GEOMETRY_SHADER, "GEOMETRY_SHADER", defines, source_string);
+
+    shader_objects[shader_count++] = compile_shader_stage(GL_FRAGMENT_SHADER, "FRAGMENT_SHADER", defines, source_string);
+
+    for (u32 i = 0; i < shader_count; i++) {
+        if (!shader_objects[i]) {
+            for (u32 j = 0; j < shader_count; j++)
+                glDeleteShader(shader_objects[j]);
+
+            return 0;
+        }
+    }
+
+    GLuint program_object = link_program(shader_objects, shader_count, use_binary_cache);
+    if (!program_object)
+        return 0;
+
+    global_program_binary_cache_stats.compiled_count++;
+
+    if (use_binary_cache)
+        save_program_binary(platform_api, allocator, binary_path, key, program_object);
+
+    get_uniform_locations(program_object, uniforms, uniform_count, uniform_names);
+    bind_demo_uniform_blocks(program_object);
+
+    return program_object;
+}
+
+#endif // SHADER_PROGRAM_H
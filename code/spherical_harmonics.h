@@ -0,0 +1,341 @@
+#if !defined SPHERICAL_HARMONICS_H
+#define SPHERICAL_HARMONICS_H
+
+// diffuse environment lighting as 9 l2 spherical harmonics (ramamoorthi and hanrahan, "an efficient representation for irradiance environment maps").
+// cube map faces are projected on the cpu, texel by texel weighted by their solid angle,
+// the sse2 kernel projects 4 texels of a row at once and matches the scalar reference up to float rounding.
+// the result is irradiance divided by pi with the basis constants folded in, so a shader only needs
+//     c0 + c1 y + c2 z + c3 x + c4 xy + c5 yz + c6 (3z² - 1) + c7 xz + c8 (x² - y²)
+// for a normal (x, y, z), see get_irradiance in data/shaders/scene.shader.txt.
+//
+// the skybox is projected when it is cooked (see cook_cube_map), reflection probes through an
+// asynchronous read back of one of its small mip levels (see Irradiance_Readback).
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && (_M_IX86_FP >= 2))
+#   define SPHERICAL_HARMONICS_SSE2
+#   include <emmintrin.h>
+#endif
+
+u32 const SH_Coefficient_Count = 9;
+
+// rgb per coefficient, w is 0, uploaded as a vec4 array
+struct SH_Irradiance {
+    vec4f coefficients[SH_Coefficient_Count];
+};
+
+// sums of color * basis polynomial * solid angle over the projected texels, per channel
+struct SH_Projection {
+    f64 sums[3][SH_Coefficient_Count];
+    f64 weight_sum;
+};
+
+// direction of a face texel is major + s * s_axis + t * t_axis,
+// s and t in [-1, 1] from left to right and from the first row to the last, as gl addresses cube map faces
+struct Cube_Face_Axes {
+    f32 major[3];
+    f32 s_axis[3];
+    f32 t_axis[3];
+};
+
+// in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+Cube_Face_Axes const Cube_Faces_Axes[6] = {
+    { {  1,  0,  0 }, {  0,  0, -1 }, {  0, -1,  0 } },
+    { { -1,  0,  0 }, {  0,  0,  1 }, {  0, -1,  0 } },
+    { {  0,  1,  0 }, {  1,  0,  0 }, {  0,  0,  1 } },
+    { {  0, -1,  0 }, {  1,  0,  0 }, {  0,  0, -1 } },
+    { {  0,  0,  1 }, {  1,  0,  0 }, {  0, -1,  0 } },
+    { {  0,  0, -1 }, { -1,  0,  0 }, {  0, -1,  0 } },
+};
+
+void project_cube_face_scalar(SH_Projection *projection, u32 face, u8 const *pixels, u32 size, u32 channel_count) {
+    auto axes = Cube_Faces_Axes + face;
+    f32 texel_scale = 2.0f / size;
+
+    for (u32 y = 0; y < size; y++) {
+        f32 t = (y + 0.5f) * texel_scale - 1.0f;
+
+        for (u32 x = 0; x < size; x++) {
+            f32 s = (x + 0.5f) * texel_scale - 1.0f;
+
+            f32 direction[3];
+            for (u32 i = 0; i < 3; i++)
+                direction[i] = axes->major[i] + s * axes->s_axis[i] + t * axes->t_axis[i];
+
+            // the solid angle of a texel shrinks with the cube of its distance to the center
+            f32 inverse_length = 1.0f / sqrtf(1.0f + s * s + t * t);
+            f32 weight = inverse_length * inverse_length * inverse_length;
+
+            f32 dx = direction[0] * inverse_length;
+            f32 dy = direction[1] * inverse_length;
+            f32 dz = direction[2] * inverse_length;
+
+            f32 basis[SH_Coefficient_Count] = {
+                1.0f, dy, dz, dx,
+                dx * dy, dy * dz, 3.0f * dz * dz - 1.0f, dx * dz, dx * dx - dy * dy,
+            };
+
+            u8 const *pixel = pixels + (y * size + x) * channel_count;
+            for (u32 channel = 0; channel < 3; channel++) {
+                f32 value = pixel[channel] * (weight / 255.0f);
+
+                for (u32 i = 0; i < SH_Coefficient_Count; i++)
+                    projection->sums[channel][i] += value * basis[i];
+            }
+
+            projection->weight_sum += weight;
+        }
+    }
+}
+
+#if defined SPHERICAL_HARMONICS_SSE2
+
+// rows are summed in float lanes and added to the double sums per row
+void project_cube_face_sse2(SH_Projection *projection, u32 face, u8 const *pixels, u32 size, u32 channel_count) {
+    // too small for a lane of 4 texels
+    if (size % 4) {
+        project_cube_face_scalar(projection, face, pixels, size, channel_count);
+        return;
+    }
+
+    auto axes = Cube_Faces_Axes + face;
+    f32 texel_scale = 2.0f / size;
+
+    __m128 major[3], s_axis[3], t_axis[3];
+    for (u32 i = 0; i < 3; i++) {
+        major[i]  = _mm_set1_ps(axes->major[i]);
+        s_axis[i] = _mm_set1_ps(axes->s_axis[i]);
+        t_axis[i] = _mm_set1_ps(axes->t_axis[i]);
+    }
+
+    __m128 one   = _mm_set1_ps(1.0f);
+    __m128 three = _mm_set1_ps(3.0f);
+    __m128 color_scale = _mm_set1_ps(1.0f / 255.0f);
+    __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 texel_scales = _mm_set1_ps(texel_scale);
+
+    for (u32 y = 0; y < size; y++) {
+        f32 t_scalar = (y + 0.5f) * texel_scale - 1.0f;
+        __m128 t = _mm_set1_ps(t_scalar);
+
+        __m128 row_base[3];
+        for (u32 i = 0; i < 3; i++)
+            row_base[i] = _mm_add_ps(major[i], _mm_mul_ps(t, t_axis[i]));
+
+        __m128 row_sums[3][SH_Coefficient_Count];
+        for (u32 channel = 0; channel < 3; channel++) {
+            for (u32 i = 0; i < SH_Coefficient_Count; i++)
+                row_sums[channel][i] = _mm_setzero_ps();
+        }
+
+        __m128 row_weight = _mm_setzero_ps();
+        __m128 t_squared_plus_one = _mm_set1_ps(1.0f + t_scalar * t_scalar);
+
+        for (u32 x = 0; x < size; x += 4) {
+            __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(cast_v(f32, x)), lane_offsets), texel_scales), one);
+
+            __m128 inverse_length = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(t_squared_plus_one, _mm_mul_ps(s, s))));
+            __m128 weight = _mm_mul_ps(_mm_mul_ps(inverse_length, inverse_length), inverse_length);
+
+            __m128 dx = _mm_mul_ps(_mm_add_ps(row_base[0], _mm_mul_ps(s, s_axis[0])), inverse_length);
+            __m128 dy = _mm_mul_ps(_mm_add_ps(row_base[1], _mm_mul_ps(s, s_axis[1])), inverse_length);
+            __m128 dz = _mm_mul_ps(_mm_add_ps(row_base[2], _mm_mul_ps(s, s_axis[2])), inverse_length);
+
+            __m128 basis[SH_Coefficient_Count] = {
+                one, dy, dz, dx,
+                _mm_mul_ps(dx, dy), _mm_mul_ps(dy, dz), _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dz, dz)), one), _mm_mul_ps(dx, dz), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+            };
+
+            u8 const *pixel = pixels + (y * size + x) * channel_count;
+            __m128 texel_weight = _mm_mul_ps(weight, color_scale);
+
+            for (u32 channel = 0; channel < 3; channel++) {
+                __m128 value = _mm_setr_ps(pixel[channel], pixel[channel_count + channel], pixel[2 * channel_count + channel], pixel[3 * channel_count + channel]);
+                value = _mm_mul_ps(value, texel_weight);
+
+                for (u32 i = 0; i < SH_Coefficient_Count; i++)
+                    row_sums[channel][i] = _mm_add_ps(row_sums[channel][i], _mm_mul_ps(value, basis[i]));
+            }
+
+            row_weight = _mm_add_ps(row_weight, weight);
+        }
+
+        f32 lanes[4];
+        for (u32 channel = 0; channel < 3; channel++) {
+            for (u32 i = 0; i < SH_Coefficient_Count; i++) {
+                _mm_storeu_ps(lanes, row_sums[channel][i]);
+                projection->sums[channel][i] += cast_v(f64, lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+            }
+        }
+
+        _mm_storeu_ps(lanes, row_weight);
+        projection->weight_sum += cast_v(f64, lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+}
+
+#endif
+
+// adds a square face of rgb or rgba pixels, rows in gl order, face in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+void project_cube_face(SH_Projection *projection, u32 face, u8 const *pixels, u32 size, u32 channel_count) {
+#if defined SPHERICAL_HARMONICS_SSE2
+    project_cube_face_sse2(projection, face, pixels, size, channel_count);
+#else
+    project_cube_face_scalar(projection, face, pixels, size, channel_count);
+#endif
+}
+
+// call after all 6 faces were projected
+SH_Irradiance get_sh_irradiance(SH_Projection const *projection) {
+    SH_Irradiance result = {};
+    if (projection->weight_sum <= 0)
+        return result;
+
+    // squared basis constants times the cosine lobe per band (pi, 2pi/3, pi/4) over pi,
+    // the texel weights are normalized to the 4 pi of the sphere
+    f64 const Pi = 3.14159265358979323846;
+    f64 const Scales[SH_Coefficient_Count] = {
+        0.282095 * 0.282095,
+        0.488603 * 0.488603 * 2.0 / 3.0,
+        0.488603 * 0.488603 * 2.0 / 3.0,
+        0.488603 * 0.488603 * 2.0 / 3.0,
+        1.092548 * 1.092548 / 4.0,
+        1.092548 * 1.092548 / 4.0,
+        0.315392 * 0.315392 / 4.0,
+        1.092548 * 1.092548 / 4.0,
+        0.546274 * 0.546274 / 4.0,
+    };
+
+    f64 normalization = 4.0 * Pi / projection->weight_sum;
+
+    for (u32 i = 0; i < SH_Coefficient_Count; i++) {
+        for (u32 channel = 0; channel < 3; channel++)
+            result.coefficients[i].values[channel] = cast_v(f32, projection->sums[channel][i] * normalization * Scales[i]);
+    }
+
+    return result;
+}
+
+// projects all 6 faces at once, faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+SH_Irradiance project_cube_map(u8 const * const *faces, u32 size, u32 channel_count) {
+    SH_Projection projection = {};
+    for (u32 face = 0; face < 6; face++)
+        project_cube_face(&projection, face, faces[face], size, channel_count);
+
+    return get_sh_irradiance(&projection);
+}
+
+// asynchronous read back of a cube map level for projection.
+// begin copies the 6 faces into a pixel buffer and sets a fence,
+// finish projects them once the fence is signaled and never waits on the gpu.
+
+struct Irradiance_Readback {
+    GLuint pixel_buffer_object;
+    GLuint frame_buffer_object;
+    GLsync fence;
+    u32 size;
+    u32 capacity;
+    bool is_pending;
+
+    // finished read backs, for the debug overlay
+    u32 completed_count;
+};
+
+// with a first_layer, cube_map_object is a cube map array and the faces are its layers first_layer + i
+void begin_irradiance_readback(Irradiance_Readback *readback, GLuint cube_map_object, u32 level, u32 size, s32 first_layer = -1) {
+    assert(!readback->is_pending);
+
+    u32 face_size = size * size * 4;
+
+    if (!readback->pixel_buffer_object)
+        glGenBuffers(1, &readback->pixel_buffer_object);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pixel_buffer_object);
+
+    if (readback->capacity < 6 * face_size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, 6 * face_size, 0, GL_STREAM_READ);
+        readback->capacity = 6 * face_size;
+    }
+
+    if (first_layer < 0) {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cube_map_object);
+
+        for (u32 face = 0; face < 6; face++)
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA, GL_UNSIGNED_BYTE, cast_p(u8, 0) + face * face_size);
+    }
+    else {
+        // glGetTexImage would read every layer of the array, single layers are read through a frame buffer
+        if (!readback->frame_buffer_object)
+            glGenFramebuffers(1, &readback->frame_buffer_object);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readback->frame_buffer_object);
+
+        for (u32 face = 0; face < 6; face++) {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, cube_map_object, level, first_layer + face);
+            glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, cast_p(u8, 0) + face * face_size);
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback->size  = size;
+    readback->is_pending = true;
+}
+
+// returns true and writes irradiance if the pending read back arrived.
+// a failed fence drops the read back, irradiance keeps its coefficients
+bool finish_irradiance_readback(Irradiance_Readback *readback, SH_Irradiance *irradiance) {
+    if (!readback->is_pending)
+        return false;
+
+    GLenum status = glClientWaitSync(readback->fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+        return false;
+
+    glDeleteSync(readback->fence);
+    readback->fence = 0;
+    readback->is_pending = false;
+
+    if (status == GL_WAIT_FAILED)
+        return false;
+
+    u32 face_size = readback->size * readback->size * 4;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pixel_buffer_object);
+    auto pixels = cast_p(u8 const, glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 6 * face_size, GL_MAP_READ_BIT));
+
+    bool ok = (pixels != 0);
+    if (ok) {
+        u8 const *faces[6];
+        for (u32 face = 0; face < 6; face++)
+            faces[face] = pixels + face * face_size;
+
+        *irradiance = project_cube_map(faces, readback->size, 4);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+        readback->completed_count++;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return ok;
+}
+
+// blocking version for load time, when the cube map has no cpu copy.
+// waits as long as the gpu needs, irradiance keeps its coefficients if the read back fails
+bool read_cube_map_irradiance(SH_Irradiance *irradiance, GLuint cube_map_object, u32 level, u32 size) {
+    Irradiance_Readback readback = {};
+    begin_irradiance_readback(&readback, cube_map_object, level, size);
+
+    while (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+        ;
+
+    // deletes the fence on every path
+    bool ok = finish_irradiance_readback(&readback, irradiance);
+    glDeleteBuffers(1, &readback.pixel_buffer_object);
+
+    return ok;
+}
+
+#endif // SPHERICAL_HARMONICS_H
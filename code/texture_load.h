@@ -0,0 +1,625 @@
+#if !defined TEXTURE_LOAD_H
+#define TEXTURE_LOAD_H
+
+// texture decoding off the main thread.
+// tga_load_texture decodes and uploads in one go, here the decode runs in a job
+// and the main thread only calls glTexImage2D on the result.
+//
+// cooked cube maps (.glcm) hold all six faces with their full mip chain,
+// so they are uploaded from a single mapping without decoding or glGenerateMipmap.
+// they also carry the diffuse irradiance of the faces as spherical harmonics (see spherical_harmonics.h).
+
+#include "demo_platform.h"
+#include "jobs.h"
+#include "block_compression.h"
+#include "spherical_harmonics.h"
+
+struct Decoded_Image {
+    Pixel_Dimensions resolution;
+    u32 channel_count; // 3: rgb, 4: rgba
+    u8 *pixels;        // rows from top to bottom
+};
+
+#pragma pack(push, 1)
+struct Tga_Header {
+    u8  id_length;
+    u8  color_map_type;
+    u8  image_type;
+    u8  color_map_specification[5];
+    u16 x_origin;
+    u16 y_origin;
+    u16 width;
+    u16 height;
+    u8  bits_per_pixel;
+    u8  image_descriptor;
+};
+#pragma pack(pop)
+
+enum {
+    Tga_Image_Type_True_Color     = 2,
+    Tga_Image_Type_True_Color_RLE = 10,
+};
+
+u32 const Tga_Descriptor_Top_To_Bottom = 1 << 5;
+
+bool tga_read_header(Tga_Header *header, u8_array source) {
+    if (source.count < sizeof(Tga_Header))
+        return false;
+
+    *header = *cast_p(Tga_Header, source.data);
+
+    if (header->color_map_type != 0)
+        return false;
+
+    if ((header->image_type != Tga_Image_Type_True_Color) && (header->image_type != Tga_Image_Type_True_Color_RLE))
+        return false;
+
+    if ((header->bits_per_pixel != 24) && (header->bits_per_pixel != 32))
+        return false;
+
+    return (header->width > 0) && (header->height > 0);
+}
+
+u32 tga_decoded_size(Tga_Header const *header) {
+    return header->width * header->height * (header->bits_per_pixel / 8);
+}
+
+// decodes into pixels (tga_decoded_size bytes), converting bgr(a) to rgb(a)
+// and bottom to top images to top to bottom.
+bool tga_decode(Decoded_Image *image, u8_array source, u8 *pixels) {
+    Tga_Header header;
+    if (!tga_read_header(&header, source))
+        return false;
+
+    u32 channel_count = header.bits_per_pixel / 8;
+    u32 row_size      = header.width * channel_count;
+
+    u8 *it  = source.data + sizeof(Tga_Header) + header.id_length;
+    u8 *end = source.data + source.count;
+
+    bool is_top_to_bottom = (header.image_descriptor & Tga_Descriptor_Top_To_Bottom) != 0;
+
+    u32 run_count = 0;
+    bool is_raw_run = false;
+    u8 run_pixel[4];
+
+    for (u32 y = 0; y < header.height; y++) {
+        u32 row = is_top_to_bottom ? y : (header.height - 1 - y);
+        u8 *destination = pixels + row * row_size;
+
+        if (header.image_type == Tga_Image_Type_True_Color) {
+            if (it + row_size > end)
+                return false;
+
+            for (u32 x = 0; x < header.width; x++) {
+                destination[0] = it[2];
+                destination[1] = it[1];
+                destination[2] = it[0];
+
+                if (channel_count == 4)
+                    destination[3] = it[3];
+
+                destination += channel_count;
+                it += channel_count;
+            }
+        }
+        else {
+            // rle packets may cross row boundaries
+            for (u32 x = 0; x < header.width; x++) {
+                if (!run_count) {
+                    if (it >= end)
+                        return false;
+
+                    is_raw_run = (*it & 0x80) == 0;
+                    run_count  = (*it & 0x7F) + 1;
+                    it++;
+
+                    if (!is_raw_run) {
+                        if (it + channel_count > end)
+                            return false;
+
+                        memcpy(run_pixel, it, channel_count);
+                        it += channel_count;
+                    }
+                }
+
+                u8 *source_pixel = run_pixel;
+                if (is_raw_run) {
+                    if (it + channel_count > end)
+                        return false;
+
+                    source_pixel = it;
+                    it += channel_count;
+                }
+
+                destination[0] = source_pixel[2];
+                destination[1] = source_pixel[1];
+                destination[2] = source_pixel[0];
+
+                if (channel_count == 4)
+                    destination[3] = source_pixel[3];
+
+                destination += channel_count;
+                run_count--;
+            }
+        }
+    }
+
+    image->resolution    = { header.width, header.height };
+    image->channel_count = channel_count;
+    image->pixels        = pixels;
+
+    return true;
+}
+
+void upload_image(Decoded_Image const *image, GLenum target) {
+    GLenum format = (image->channel_count == 4) ? GL_RGBA : GL_RGB;
+    GLenum internal_format = (image->channel_count == 4) ? GL_RGBA8 : GL_RGB8;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(target, 0, internal_format, image->resolution.width, image->resolution.height, 0, format, GL_UNSIGNED_BYTE, image->pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+bool has_gl_extension(char const *name) {
+    s32 count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (s32 i = 0; i < count; i++) {
+        auto extension = cast_p(char const, glGetStringi(GL_EXTENSIONS, i));
+        if (extension && (strcmp(extension, name) == 0))
+            return true;
+    }
+
+    return false;
+}
+
+// threaded loading
+
+struct Tga_Load_Job {
+    string path;
+
+    // image points into pixels, freed by free_tga_load_job
+    Decoded_Image image;
+    u8_array pixels;
+    bool ok;
+
+    u32 volatile is_done;
+};
+
+void tga_load_job(Job_Worker *worker, void *data) {
+    auto job = cast_p(Tga_Load_Job, data);
+    job->ok = false;
+
+    Mapped_File mapped_file;
+    if (map_file(&mapped_file, job->path)) {
+        Tga_Header header;
+        if (tga_read_header(&header, mapped_file.data)) {
+            job->pixels = allocate_pages(tga_decoded_size(&header));
+            job->ok = job->pixels.count && tga_decode(&job->image, mapped_file.data, job->pixels.data);
+        }
+
+        unmap_file(&mapped_file);
+    }
+
+    atomic_write(&job->is_done, 1);
+}
+
+void push_tga_load_job(Job_System *jobs, Tga_Load_Job *job, string path) {
+    *job = {};
+    job->path = path;
+
+    push_job(jobs, tga_load_job, job);
+}
+
+// main thread, once the image is uploaded or copied
+void free_tga_load_job(Tga_Load_Job *job) {
+    free_pages(&job->pixels);
+    job->image = {};
+    job->ok = false;
+}
+
+// cooked cube maps
+//
+// blob layout (all sections start at a multiple of Cooked_Cube_Map_Alignment):
+//   Cooked_Cube_Map_Header
+//   Cooked_Cube_Map_Level [level_count]
+//   per level: 6 faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+//
+// cube map faces keep the image row order (top to bottom), same as the upload of decoded faces
+
+u32 const Cooked_Cube_Map_Magic     = 'G' | ('L' << 8) | ('C' << 16) | ('M' << 24);
+u32 const Cooked_Cube_Map_Version   = 3;
+u32 const Cooked_Cube_Map_Alignment = 64;
+u32 const Cooked_Cube_Map_Max_Level_Count = 16;
+
+// irradiance is projected from the first level at most this wide, it has no detail a diffuse term could show
+u32 const Cooked_Cube_Map_Irradiance_Max_Size = 64;
+
+struct Cooked_Cube_Map_Level {
+    u32 width;
+    u32 height;
+    u32 face_size;
+    u32 data_offset; // first face, the others follow every face_stride bytes
+    u32 face_stride;
+};
+
+struct Cooked_Cube_Map_Header {
+    u32 magic;
+    u32 version;
+    u32 size;
+
+    u32 channel_count;
+    u32 level_count;
+
+    // GL_RGB8, GL_RGBA8 or GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    u32 gl_internal_format;
+
+    SH_Irradiance irradiance;
+};
+
+inline u32 cube_map_align_up(u32 value) {
+    return (value + Cooked_Cube_Map_Alignment - 1) & ~(Cooked_Cube_Map_Alignment - 1);
+}
+
+// 2x2 box filter, same as glGenerateMipmap for 8 bit unorm formats.
+// odd sizes repeat the last row or column
+void downsample_image(u8 *destination, u32 destination_width, u32 destination_height, u8 const *source, u32 source_width, u32 source_height, u32 channel_count) {
+    for (u32 y = 0; y < destination_height; y++) {
+        u32 y0 = min(y * 2,     source_height - 1);
+        u32 y1 = min(y * 2 + 1, source_height - 1);
+
+        for (u32 x = 0; x < destination_width; x++) {
+            u32 x0 = min(x * 2,     source_width - 1);
+            u32 x1 = min(x * 2 + 1, source_width - 1);
+
+            for (u32 c = 0; c < channel_count; c++) {
+                u32 sum =
+                    source[(y0 * source_width + x0) * channel_count + c] +
+                    source[(y0 * source_width + x1) * channel_count + c] +
+                    source[(y1 * source_width + x0) * channel_count + c] +
+                    source[(y1 * source_width + x1) * channel_count + c];
+
+                destination[(y * destination_width + x) * channel_count + c] = cast_v(u8, (sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// faces are decoded images (top to bottom), all with the same size and channel count.
+// with compress, opaque faces are stored as BC1 (including the mip levels below 4x4).
+// returns an empty array if the faces do not match
+u8_array cook_cube_map(Decoded_Image const *faces, Memory_Allocator *allocator, bool compress) {
+    u8_array result = {};
+
+    u32 width  = faces[0].resolution.width;
+    u32 height = faces[0].resolution.height;
+    u32 channel_count = faces[0].channel_count;
+
+    for (u32 i = 1; i < 6; i++) {
+        if ((faces[i].resolution.width != cast_v(s32, width)) || (faces[i].resolution.height != cast_v(s32, height)) || (faces[i].channel_count != channel_count))
+            return result;
+    }
+
+    // BC1 has no alpha
+    compress &= (channel_count == 3);
+
+    Cooked_Cube_Map_Header header = {};
+    header.magic   = Cooked_Cube_Map_Magic;
+    header.version = Cooked_Cube_Map_Version;
+    header.channel_count = channel_count;
+
+    if (compress)
+        header.gl_internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else
+        header.gl_internal_format = (channel_count == 4) ? GL_RGBA8 : GL_RGB8;
+
+    Cooked_Cube_Map_Level levels[Cooked_Cube_Map_Max_Level_Count];
+
+    {
+        u32 level_width  = width;
+        u32 level_height = height;
+
+        while (true) {
+            assert(header.level_count < Cooked_Cube_Map_Max_Level_Count);
+            header.level_count++;
+
+            if ((level_width == 1) && (level_height == 1))
+                break;
+
+            level_width  = max(level_width  / 2, 1u);
+            level_height = max(level_height / 2, 1u);
+        }
+    }
+
+    u32 offset = sizeof(Cooked_Cube_Map_Header) + header.level_count * sizeof(Cooked_Cube_Map_Level);
+
+    // uncompressed mip chain of one face
+    u32 scratch_size = 0;
+
+    {
+        u32 level_width  = width;
+        u32 level_height = height;
+
+        for (u32 level = 0; level < header.level_count; level++) {
+            levels[level].width  = level_width;
+            levels[level].height = level_height;
+
+            if (compress)
+                levels[level].face_size = get_compressed_image_size(level_width, level_height, Block_Format_BC1);
+            else
+                levels[level].face_size = level_width * level_height * channel_count;
+
+            levels[level].face_stride = cube_map_align_up(levels[level].face_size);
+
+            offset = cube_map_align_up(offset);
+            levels[level].data_offset = offset;
+            offset += 6 * levels[level].face_stride;
+
+            scratch_size += level_width * level_height * channel_count;
+
+            level_width  = max(level_width  / 2, 1u);
+            level_height = max(level_height / 2, 1u);
+        }
+    }
+
+    header.size = cube_map_align_up(offset);
+
+    u8 *blob = TRACK_GROW(allocator, &result, header.size);
+    memset(blob, 0, header.size);
+
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), levels, header.level_count * sizeof(Cooked_Cube_Map_Level));
+
+    u8_array scratch = {};
+    TRACK_GROW(allocator, &scratch, scratch_size);
+
+    // last level if no level is small enough, square faces only
+    u32 irradiance_level = header.level_count - 1;
+    for (u32 level = 0; level < header.level_count; level++) {
+        if ((levels[level].width <= Cooked_Cube_Map_Irradiance_Max_Size) && (levels[level].height <= Cooked_Cube_Map_Irradiance_Max_Size)) {
+            irradiance_level = level;
+            break;
+        }
+    }
+
+    bool is_square = (width == height);
+    SH_Projection projection = {};
+
+    for (u32 face = 0; face < 6; face++) {
+        u8 *level_pixels = scratch.data;
+        memcpy(level_pixels, faces[face].pixels, width * height * channel_count);
+
+        for (u32 level = 0; level < header.level_count; level++) {
+            auto current = levels + level;
+
+            if (level > 0) {
+                auto previous = levels + level - 1;
+                u8 *previous_pixels = level_pixels;
+                level_pixels += previous->width * previous->height * channel_count;
+
+                downsample_image(level_pixels, current->width, current->height, previous_pixels, previous->width, previous->height, channel_count);
+            }
+
+            if (is_square && (level == irradiance_level))
+                project_cube_face(&projection, face, level_pixels, current->width, channel_count);
+
+            u8 *destination = blob + current->data_offset + face * current->face_stride;
+
+            if (compress)
+                compress_image(destination, level_pixels, current->width, current->height, channel_count, Block_Format_BC1);
+            else
+                memcpy(destination, level_pixels, current->face_size);
+        }
+    }
+
+    TRACK_FREE_ARRAY(allocator, &scratch);
+
+    cast_p(Cooked_Cube_Map_Header, blob)->irradiance = get_sh_irradiance(&projection);
+
+    return result;
+}
+
+bool read_cooked_cube_map(Cooked_Cube_Map_Header **header_out, Cooked_Cube_Map_Level **levels_out, u8_array blob) {
+    if (blob.count < sizeof(Cooked_Cube_Map_Header))
+        return false;
+
+    auto header = cast_p(Cooked_Cube_Map_Header, blob.data);
+    if ((header->magic != Cooked_Cube_Map_Magic) || (header->version != Cooked_Cube_Map_Version) || (header->size > blob.count))
+        return false;
+
+    if ((header->level_count == 0) || (header->level_count > Cooked_Cube_Map_Max_Level_Count) || ((header->channel_count != 3) && (header->channel_count != 4)))
+        return false;
+
+    if ((header->gl_internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) && !has_gl_extension("GL_EXT_texture_compression_s3tc"))
+        return false;
+
+    if (sizeof(Cooked_Cube_Map_Header) + header->level_count * sizeof(Cooked_Cube_Map_Level) > header->size)
+        return false;
+
+    auto levels = cast_p(Cooked_Cube_Map_Level, blob.data + sizeof(Cooked_Cube_Map_Header));
+    for (u32 i = 0; i < header->level_count; i++) {
+        if ((levels[i].face_size > levels[i].face_stride) || (cast_v(u64, levels[i].data_offset) + 6 * cast_v(u64, levels[i].face_stride) > header->size))
+            return false;
+    }
+
+    *header_out = header;
+    *levels_out = levels;
+
+    return true;
+}
+
+// maps the cooked file and keeps the mapping only if it is valid
+bool map_cooked_cube_map(Mapped_File *mapped_file, string path) {
+    if (!map_file(mapped_file, path))
+        return false;
+
+    Cooked_Cube_Map_Header *header;
+    Cooked_Cube_Map_Level *levels;
+    if (!read_cooked_cube_map(&header, &levels, mapped_file->data)) {
+        unmap_file(mapped_file);
+        return false;
+    }
+
+    return true;
+}
+
+// uploads every face and level to texture_object, which is left bound to GL_TEXTURE_CUBE_MAP.
+// irradiance receives the cooked spherical harmonics if it is not null
+bool upload_cooked_cube_map(GLuint texture_object, u8_array blob, SH_Irradiance *irradiance = 0) {
+    Cooked_Cube_Map_Header *header;
+    Cooked_Cube_Map_Level *levels;
+    if (!read_cooked_cube_map(&header, &levels, blob))
+        return false;
+
+    GLenum format = (header->channel_count == 4) ? GL_RGBA : GL_RGB;
+    bool is_compressed = (header->gl_internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_object);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (u32 level = 0; level < header->level_count; level++) {
+        for (u32 face = 0; face < 6; face++) {
+            u8 *data = blob.data + levels[level].data_offset + face * levels[level].face_stride;
+
+            if (is_compressed)
+                glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, header->gl_internal_format, levels[level].width, levels[level].height, 0, levels[level].face_size, data);
+            else
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, header->gl_internal_format, levels[level].width, levels[level].height, 0, format, GL_UNSIGNED_BYTE, data);
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, header->level_count - 1);
+
+    if (irradiance)
+        *irradiance = header->irradiance;
+
+    return true;
+}
+
+#if defined BENCHMARK_TEXTURE_COMPRESSION
+
+#include "report.h"
+
+// mean squared error of the decoded blocks against the source, over the channels the format stores
+f64 get_block_compression_error(u8 const *blocks, u8 const *pixels, u32 width, u32 height, u32 channel_count, Block_Format format) {
+    u32 block_count_x = (width  + 3) / 4;
+    u32 block_count_y = (height + 3) / 4;
+    u32 compared_channel_count = (format == Block_Format_BC1) ? 3 : 2;
+
+    f64 squared_error_sum = 0;
+    u32 sample_count = 0;
+
+    for (u32 block_y = 0; block_y < block_count_y; block_y++) {
+        for (u32 block_x = 0; block_x < block_count_x; block_x++) {
+            u8 const *block = blocks + (block_y * block_count_x + block_x) * get_block_size(format);
+
+            u8 decoded[64];
+            if (format == Block_Format_BC1) {
+                bc1_decompress_block(decoded, block);
+            }
+            else {
+                bc4_decompress_block(decoded + 0, 4, block);
+                bc4_decompress_block(decoded + 1, 4, block + 8);
+            }
+
+            for (u32 y = 0; y < 4; y++) {
+                for (u32 x = 0; x < 4; x++) {
+                    u32 pixel_x = block_x * 4 + x;
+                    u32 pixel_y = block_y * 4 + y;
+                    if ((pixel_x >= width) || (pixel_y >= height))
+                        continue;
+
+                    for (u32 c = 0; c < compared_channel_count; c++) {
+                        f64 difference = cast_v(f64, decoded[(y * 4 + x) * 4 + c]) - pixels[(pixel_y * width + pixel_x) * channel_count + c];
+                        squared_error_sum += difference * difference;
+                        sample_count++;
+                    }
+                }
+            }
+        }
+    }
+
+    return squared_error_sum / sample_count;
+}
+
+// compresses every image with the scalar and the sse2 kernels and writes
+// throughput, psnr and whether both outputs match to texture_compression_benchmark.txt.
+// BC5 compresses the red and green channel, standing in for a normal map.
+void benchmark_texture_compression(Platform_API *platform_api, Memory_Allocator *allocator, string *paths, u32 path_count) {
+    u32 const Iteration_Count = 8;
+
+    char report_buffer[4096];
+    auto report = make_report(report_buffer, sizeof(report_buffer));
+
+    report_write(&report, "texture compression benchmark, best of %u runs\n%-48s %6s %14s %14s %8s %10s %6s\n",
+                 Iteration_Count, "image", "format", "scalar MPix/s", "simd MPix/s", "speedup", "psnr (dB)", "equal");
+
+    for (u32 path_index = 0; path_index < path_count; path_index++) {
+        auto source = TRACK_READ_ENTIRE_FILE(platform_api, paths[path_index], allocator);
+        defer { TRACK_FREE_ARRAY(allocator, &source); };
+
+        Tga_Header header;
+        if (!tga_read_header(&header, source))
+            continue;
+
+        u8_array pixels = {};
+        TRACK_GROW(allocator, &pixels, tga_decoded_size(&header));
+        defer { TRACK_FREE_ARRAY(allocator, &pixels); };
+
+        Decoded_Image image;
+        if (!tga_decode(&image, source, pixels.data))
+            continue;
+
+        u32 width  = image.resolution.width;
+        u32 height = image.resolution.height;
+
+        for (u32 format_index = 0; format_index < 2; format_index++) {
+            auto format = cast_v(Block_Format, format_index);
+            u32 size = get_compressed_image_size(width, height, format);
+
+            u8_array scalar_blocks = {};
+            TRACK_GROW(allocator, &scalar_blocks, size);
+            defer { TRACK_FREE_ARRAY(allocator, &scalar_blocks); };
+
+            u8_array simd_blocks = {};
+            TRACK_GROW(allocator, &simd_blocks, size);
+            defer { TRACK_FREE_ARRAY(allocator, &simd_blocks); };
+
+            f64 scalar_seconds = 1e10;
+            f64 simd_seconds   = 1e10;
+
+            for (u32 iteration = 0; iteration < Iteration_Count; iteration++) {
+                u64 start = get_clock_ticks();
+                compress_image(scalar_blocks.data, image.pixels, width, height, image.channel_count, format, false);
+                scalar_seconds = min(scalar_seconds, get_clock_seconds(get_clock_ticks() - start));
+
+                start = get_clock_ticks();
+                compress_image(simd_blocks.data, image.pixels, width, height, image.channel_count, format, true);
+                simd_seconds = min(simd_seconds, get_clock_seconds(get_clock_ticks() - start));
+            }
+
+            f64 mean_squared_error = get_block_compression_error(simd_blocks.data, image.pixels, width, height, image.channel_count, format);
+            f64 psnr = (mean_squared_error > 0) ? 10 * log10(255.0 * 255.0 / mean_squared_error) : 99.0;
+
+            f64 mega_pixels = width * height * 1e-6;
+            bool is_equal = (memcmp(scalar_blocks.data, simd_blocks.data, size) == 0);
+
+            char name[256];
+            copy_to_c_string(name, sizeof(name), paths[path_index]);
+            report_write(&report, "%-48s %6s %14.1f %14.1f %7.1fx %10.2f %6s\n",
+                         name, (format == Block_Format_BC1) ? "BC1" : "BC5",
+                         mega_pixels / scalar_seconds, mega_pixels / simd_seconds, scalar_seconds / simd_seconds,
+                         psnr, is_equal ? "yes" : "NO");
+        }
+    }
+
+    write_report(&report, platform_api, S("texture_compression_benchmark.txt"));
+}
+
+#endif // BENCHMARK_TEXTURE_COMPRESSION
+
+#endif // TEXTURE_LOAD_H
@@ -0,0 +1,594 @@
+#if !defined TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+// transform math over many objects at once.
+// the sse2 matrix kernels load 4 mat4x3f, transpose them so every register holds one element of 4 transforms,
+// apply the scalar formula to all lanes and transpose back.
+// points are structure of arrays and go 4 (sse2) or 8 (avx) at a time.
+// every kernel has a scalar version, which also handles the last count % lane count elements.
+// results match mooselib's make_transform, make_inverse_unscaled_transform and transform_point up to rounding,
+// benchmark_transform_batch reports the largest difference.
+
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && (_M_IX86_FP >= 2))
+#   define TRANSFORM_BATCH_SSE2
+#   include <emmintrin.h>
+#endif
+
+#if defined __AVX__
+#   define TRANSFORM_BATCH_AVX
+#   include <immintrin.h>
+#endif
+
+// what make_transform takes, rotations are unit quaternions
+struct Transform_Components {
+    f32 *rotation_x;
+    f32 *rotation_y;
+    f32 *rotation_z;
+    f32 *rotation_w;
+    f32 *translation_x;
+    f32 *translation_y;
+    f32 *translation_z;
+    f32 *scale_x;
+    f32 *scale_y;
+    f32 *scale_z;
+    u32 count;
+};
+
+struct Point_Array {
+    f32 *x;
+    f32 *y;
+    f32 *z;
+    u32 count;
+};
+
+// parent_to_world * child_to_parent
+inline mat4x3f combine_transforms(mat4x3f const &parent_to_world, mat4x3f const &child_to_parent) {
+    mat4x3f result;
+    for (u32 i = 0; i < 3; i++)
+        result.columns[i] = transform_direction(parent_to_world, child_to_parent.columns[i]);
+
+    result.columns[3] = transform_point(parent_to_world, child_to_parent.columns[3]);
+
+    return result;
+}
+
+void make_transforms_scalar(mat4x3f *results, Transform_Components const *components, u32 first = 0) {
+    for (u32 i = first; i < components->count; i++) {
+        f32 x = components->rotation_x[i];
+        f32 y = components->rotation_y[i];
+        f32 z = components->rotation_z[i];
+        f32 w = components->rotation_w[i];
+
+        f32 sx = components->scale_x[i];
+        f32 sy = components->scale_y[i];
+        f32 sz = components->scale_z[i];
+
+        auto result = results + i;
+        result->columns[0] = vec3f{ (1 - 2 * (y * y + z * z)) * sx, 2 * (x * y + w * z) * sx, 2 * (x * z - w * y) * sx };
+        result->columns[1] = vec3f{ 2 * (x * y - w * z) * sy, (1 - 2 * (x * x + z * z)) * sy, 2 * (y * z + w * x) * sy };
+        result->columns[2] = vec3f{ 2 * (x * z + w * y) * sz, 2 * (y * z - w * x) * sz, (1 - 2 * (x * x + y * y)) * sz };
+        result->columns[3] = vec3f{ components->translation_x[i], components->translation_y[i], components->translation_z[i] };
+    }
+}
+
+// results[i] = parent_to_worlds[parents[i]] * child_to_parents[i] for every i in indices.
+// results may be parent_to_worlds, as long as no index is the parent of another
+void combine_transforms_indexed_scalar(mat4x3f *results, mat4x3f const *parent_to_worlds, mat4x3f const *child_to_parents, u32 const *parents, u32 const *indices, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        u32 index = indices[i];
+        results[index] = combine_transforms(parent_to_worlds[parents[index]], child_to_parents[index]);
+    }
+}
+
+// transforms without scale, like make_inverse_unscaled_transform
+void invert_unscaled_transforms_scalar(mat4x3f *results, mat4x3f const *transforms, u32 count, u32 first = 0) {
+    for (u32 i = first; i < count; i++) {
+        auto t = transforms[i];
+
+        mat4x3f result;
+        for (u32 column = 0; column < 3; column++)
+            result.columns[column] = vec3f{ t.columns[0].values[column], t.columns[1].values[column], t.columns[2].values[column] };
+
+        result.columns[3] = vec3f{ -dot(t.columns[0], t.columns[3]), -dot(t.columns[1], t.columns[3]), -dot(t.columns[2], t.columns[3]) };
+
+        results[i] = result;
+    }
+}
+
+// results may be points
+void transform_points_scalar(Point_Array *results, mat4x3f transform, Point_Array const *points, u32 first = 0) {
+    for (u32 i = first; i < points->count; i++) {
+        f32 x = points->x[i];
+        f32 y = points->y[i];
+        f32 z = points->z[i];
+
+        results->x[i] = transform.columns[0].x * x + transform.columns[1].x * y + transform.columns[2].x * z + transform.columns[3].x;
+        results->y[i] = transform.columns[0].y * x + transform.columns[1].y * y + transform.columns[2].y * z + transform.columns[3].y;
+        results->z[i] = transform.columns[0].z * x + transform.columns[1].z * y + transform.columns[2].z * z + transform.columns[3].z;
+    }
+
+    results->count = points->count;
+}
+
+#if defined TRANSFORM_BATCH_SSE2
+
+// values[column * 3 + row] holds that element of 4 transforms
+struct Transform_Lanes {
+    __m128 values[12];
+};
+
+inline void load_transform_lanes(Transform_Lanes *lanes, mat4x3f const * const transforms[4]) {
+    for (u32 part = 0; part < 3; part++) {
+        __m128 rows[4];
+        for (u32 lane = 0; lane < 4; lane++)
+            rows[lane] = _mm_loadu_ps(&transforms[lane]->columns[0].x + part * 4);
+
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+        for (u32 i = 0; i < 4; i++)
+            lanes->values[part * 4 + i] = rows[i];
+    }
+}
+
+inline void store_transform_lanes(mat4x3f * const transforms[4], Transform_Lanes const *lanes) {
+    for (u32 part = 0; part < 3; part++) {
+        __m128 rows[4];
+        for (u32 i = 0; i < 4; i++)
+            rows[i] = lanes->values[part * 4 + i];
+
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+        for (u32 lane = 0; lane < 4; lane++)
+            _mm_storeu_ps(&transforms[lane]->columns[0].x + part * 4, rows[lane]);
+    }
+}
+
+void make_transforms_sse2(mat4x3f *results, Transform_Components const *components) {
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+
+    u32 i = 0;
+    for (; i + 4 <= components->count; i += 4) {
+        __m128 x = _mm_loadu_ps(components->rotation_x + i);
+        __m128 y = _mm_loadu_ps(components->rotation_y + i);
+        __m128 z = _mm_loadu_ps(components->rotation_z + i);
+        __m128 w = _mm_loadu_ps(components->rotation_w + i);
+
+        __m128 sx = _mm_loadu_ps(components->scale_x + i);
+        __m128 sy = _mm_loadu_ps(components->scale_y + i);
+        __m128 sz = _mm_loadu_ps(components->scale_z + i);
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        // same operation order as the scalar version
+        Transform_Lanes result;
+        result.values[0]  = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        result.values[1]  = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        result.values[2]  = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        result.values[3]  = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        result.values[4]  = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        result.values[5]  = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        result.values[6]  = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        result.values[7]  = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        result.values[8]  = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+        result.values[9]  = _mm_loadu_ps(components->translation_x + i);
+        result.values[10] = _mm_loadu_ps(components->translation_y + i);
+        result.values[11] = _mm_loadu_ps(components->translation_z + i);
+
+        mat4x3f * const transforms[4] = { results + i, results + i + 1, results + i + 2, results + i + 3 };
+        store_transform_lanes(transforms, &result);
+    }
+
+    make_transforms_scalar(results, components, i);
+}
+
+void combine_transforms_indexed_sse2(mat4x3f *results, mat4x3f const *parent_to_worlds, mat4x3f const *child_to_parents, u32 const *parents, u32 const *indices, u32 count) {
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        mat4x3f const *parent_pointers[4];
+        mat4x3f const *child_pointers[4];
+        mat4x3f *result_pointers[4];
+
+        for (u32 lane = 0; lane < 4; lane++) {
+            u32 index = indices[i + lane];
+            parent_pointers[lane] = parent_to_worlds + parents[index];
+            child_pointers[lane]  = child_to_parents + index;
+            result_pointers[lane] = results + index;
+        }
+
+        Transform_Lanes parent, child, result;
+        load_transform_lanes(&parent, parent_pointers);
+        load_transform_lanes(&child, child_pointers);
+
+        for (u32 column = 0; column < 4; column++) {
+            for (u32 row = 0; row < 3; row++) {
+                __m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(parent.values[row], child.values[column * 3]), _mm_mul_ps(parent.values[3 + row], child.values[column * 3 + 1])), _mm_mul_ps(parent.values[6 + row], child.values[column * 3 + 2]));
+
+                if (column == 3)
+                    value = _mm_add_ps(value, parent.values[9 + row]);
+
+                result.values[column * 3 + row] = value;
+            }
+        }
+
+        store_transform_lanes(result_pointers, &result);
+    }
+
+    combine_transforms_indexed_scalar(results, parent_to_worlds, child_to_parents, parents, indices + i, count - i);
+}
+
+void invert_unscaled_transforms_sse2(mat4x3f *results, mat4x3f const *transforms, u32 count) {
+    __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    u32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        mat4x3f const * const sources[4] = { transforms + i, transforms + i + 1, transforms + i + 2, transforms + i + 3 };
+
+        Transform_Lanes t, result;
+        load_transform_lanes(&t, sources);
+
+        for (u32 column = 0; column < 3; column++) {
+            for (u32 row = 0; row < 3; row++)
+                result.values[column * 3 + row] = t.values[row * 3 + column];
+
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t.values[column * 3], t.values[9]), _mm_mul_ps(t.values[column * 3 + 1], t.values[10])), _mm_mul_ps(t.values[column * 3 + 2], t.values[11]));
+            result.values[9 + column] = _mm_xor_ps(d, sign_mask);
+        }
+
+        mat4x3f * const destinations[4] = { results + i, results + i + 1, results + i + 2, results + i + 3 };
+        store_transform_lanes(destinations, &result);
+    }
+
+    invert_unscaled_transforms_scalar(results, transforms, count, i);
+}
+
+void transform_points_sse2(Point_Array *results, mat4x3f transform, Point_Array const *points) {
+    __m128 m[12];
+    for (u32 i = 0; i < 12; i++)
+        m[i] = _mm_set1_ps((&transform.columns[0].x)[i]);
+
+    u32 i = 0;
+    for (; i + 4 <= points->count; i += 4) {
+        __m128 x = _mm_loadu_ps(points->x + i);
+        __m128 y = _mm_loadu_ps(points->y + i);
+        __m128 z = _mm_loadu_ps(points->z + i);
+
+        for (u32 row = 0; row < 3; row++) {
+            __m128 value = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[row], x), _mm_mul_ps(m[3 + row], y)), _mm_mul_ps(m[6 + row], z)), m[9 + row]);
+            f32 *result_row = (row == 0) ? results->x : ((row == 1) ? results->y : results->z);
+            _mm_storeu_ps(result_row + i, value);
+        }
+    }
+
+    transform_points_scalar(results, transform, points, i);
+}
+
+#endif
+
+#if defined TRANSFORM_BATCH_AVX
+
+void transform_points_avx(Point_Array *results, mat4x3f transform, Point_Array const *points) {
+    __m256 m[12];
+    for (u32 i = 0; i < 12; i++)
+        m[i] = _mm256_set1_ps((&transform.columns[0].x)[i]);
+
+    u32 i = 0;
+    for (; i + 8 <= points->count; i += 8) {
+        __m256 x = _mm256_loadu_ps(points->x + i);
+        __m256 y = _mm256_loadu_ps(points->y + i);
+        __m256 z = _mm256_loadu_ps(points->z + i);
+
+        // no fused multiply add, so results stay equal to the scalar version
+        for (u32 row = 0; row < 3; row++) {
+            __m256 value = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[row], x), _mm256_mul_ps(m[3 + row], y)), _mm256_mul_ps(m[6 + row], z)), m[9 + row]);
+            f32 *result_row = (row == 0) ? results->x : ((row == 1) ? results->y : results->z);
+            _mm256_storeu_ps(result_row + i, value);
+        }
+    }
+
+    transform_points_scalar(results, transform, points, i);
+}
+
+#endif
+
+// make_transform of every element
+void make_transforms(mat4x3f *results, Transform_Components const *components) {
+#if defined TRANSFORM_BATCH_SSE2
+    make_transforms_sse2(results, components);
+#else
+    make_transforms_scalar(results, components);
+#endif
+}
+
+void combine_transforms_indexed(mat4x3f *results, mat4x3f const *parent_to_worlds, mat4x3f const *child_to_parents, u32 const *parents, u32 const *indices, u32 count) {
+#if defined TRANSFORM_BATCH_SSE2
+    combine_transforms_indexed_sse2(results, parent_to_worlds, child_to_parents, parents, indices, count);
+#else
+    combine_transforms_indexed_scalar(results, parent_to_worlds, child_to_parents, parents, indices, count);
+#endif
+}
+
+void invert_unscaled_transforms(mat4x3f *results, mat4x3f const *transforms, u32 count) {
+#if defined TRANSFORM_BATCH_SSE2
+    invert_unscaled_transforms_sse2(results, transforms, count);
+#else
+    invert_unscaled_transforms_scalar(results, transforms, count);
+#endif
+}
+
+void transform_points(Point_Array *results, mat4x3f transform, Point_Array const *points) {
+#if defined TRANSFORM_BATCH_AVX
+    transform_points_avx(results, transform, points);
+#elif defined TRANSFORM_BATCH_SSE2
+    transform_points_sse2(results, transform, points);
+#else
+    transform_points_scalar(results, transform, points);
+#endif
+}
+
+#if defined BENCHMARK_TRANSFORM_BATCH
+
+#include "random.h"
+#include "report.h"
+
+struct Transform_Batch_Benchmark {
+    Transform_Components components;
+
+    // scaled and unscaled transforms of the components
+    mat4x3f *transforms;
+    mat4x3f *unscaled_transforms;
+
+    // like children in a hierarchy, runs of 16 objects share a parent
+    u32 *parents;
+    u32 *indices;
+
+    Point_Array points;
+    mat4x3f point_transform;
+
+    mat4x3f *results;
+    Point_Array result_points;
+};
+
+typedef void (*Transform_Batch_Function)(Transform_Batch_Benchmark *benchmark, u32 count);
+
+void benchmark_make_transforms_scalar(Transform_Batch_Benchmark *benchmark, u32 count) {
+    auto components = benchmark->components;
+    components.count = count;
+    make_transforms_scalar(benchmark->results, &components);
+}
+
+void benchmark_combine_transforms_scalar(Transform_Batch_Benchmark *benchmark, u32 count) {
+    combine_transforms_indexed_scalar(benchmark->results, benchmark->transforms, benchmark->transforms, benchmark->parents, benchmark->indices, count);
+}
+
+void benchmark_invert_transforms_scalar(Transform_Batch_Benchmark *benchmark, u32 count) {
+    invert_unscaled_transforms_scalar(benchmark->results, benchmark->unscaled_transforms, count);
+}
+
+void benchmark_transform_points_scalar(Transform_Batch_Benchmark *benchmark, u32 count) {
+    auto points = benchmark->points;
+    points.count = count;
+    transform_points_scalar(&benchmark->result_points, benchmark->point_transform, &points);
+}
+
+#if defined TRANSFORM_BATCH_SSE2
+
+void benchmark_make_transforms_sse2(Transform_Batch_Benchmark *benchmark, u32 count) {
+    auto components = benchmark->components;
+    components.count = count;
+    make_transforms_sse2(benchmark->results, &components);
+}
+
+void benchmark_combine_transforms_sse2(Transform_Batch_Benchmark *benchmark, u32 count) {
+    combine_transforms_indexed_sse2(benchmark->results, benchmark->transforms, benchmark->transforms, benchmark->parents, benchmark->indices, count);
+}
+
+void benchmark_invert_transforms_sse2(Transform_Batch_Benchmark *benchmark, u32 count) {
+    invert_unscaled_transforms_sse2(benchmark->results, benchmark->unscaled_transforms, count);
+}
+
+void benchmark_transform_points_sse2(Transform_Batch_Benchmark *benchmark, u32 count) {
+    auto points = benchmark->points;
+    points.count = count;
+    transform_points_sse2(&benchmark->result_points, benchmark->point_transform, &points);
+}
+
+#endif
+
+#if defined TRANSFORM_BATCH_AVX
+
+void benchmark_transform_points_avx(Transform_Batch_Benchmark *benchmark, u32 count) {
+    auto points = benchmark->points;
+    points.count = count;
+    transform_points_avx(&benchmark->result_points, benchmark->point_transform, &points);
+}
+
+#endif
+
+// runs every kernel on random transforms at several batch sizes and writes throughput
+// and the largest difference to mooselib's one at a time functions to transform_batch_benchmark.txt
+void benchmark_transform_batch(Platform_API *platform_api, Memory_Allocator *allocator) {
+    u32 const Iteration_Count = 16;
+    u32 const Batch_Counts[] = { 16, 256, 4096, 65536 };
+    u32 const Max_Count = Batch_Counts[ARRAY_COUNT(Batch_Counts) - 1];
+
+    enum Operation {
+        Operation_Make,
+        Operation_Combine,
+        Operation_Invert,
+        Operation_Points,
+    };
+
+    struct {
+        char const *operation_name;
+        char const *name;
+        Operation operation;
+        Transform_Batch_Function function;
+    } kernels[] = {
+        { "make",    "scalar", Operation_Make,    benchmark_make_transforms_scalar },
+#if defined TRANSFORM_BATCH_SSE2
+        { "make",    "sse2",   Operation_Make,    benchmark_make_transforms_sse2 },
+#endif
+        { "combine", "scalar", Operation_Combine, benchmark_combine_transforms_scalar },
+#if defined TRANSFORM_BATCH_SSE2
+        { "combine", "sse2",   Operation_Combine, benchmark_combine_transforms_sse2 },
+#endif
+        { "invert",  "scalar", Operation_Invert,  benchmark_invert_transforms_scalar },
+#if defined TRANSFORM_BATCH_SSE2
+        { "invert",  "sse2",   Operation_Invert,  benchmark_invert_transforms_sse2 },
+#endif
+        { "points",  "scalar", Operation_Points,  benchmark_transform_points_scalar },
+#if defined TRANSFORM_BATCH_SSE2
+        { "points",  "sse2",   Operation_Points,  benchmark_transform_points_sse2 },
+#endif
+#if defined TRANSFORM_BATCH_AVX
+        { "points",  "avx",    Operation_Points,  benchmark_transform_points_avx },
+#endif
+    };
+
+    u32 transforms_size = Max_Count * sizeof(mat4x3f);
+    u32 floats_size     = Max_Count * sizeof(f32);
+
+    u8_array memory = {};
+    u8 *base = TRACK_GROW(allocator, &memory, 4 * transforms_size + 19 * floats_size + 2 * Max_Count * sizeof(u32));
+    defer { TRACK_FREE_ARRAY(allocator, &memory); };
+
+    Transform_Batch_Benchmark benchmark;
+    Point_Array reference_points;
+
+    benchmark.transforms          = cast_p(mat4x3f, base);
+    benchmark.unscaled_transforms = benchmark.transforms + Max_Count;
+    benchmark.results             = benchmark.unscaled_transforms + Max_Count;
+
+    // make_transform is what the components came from
+    mat4x3f *reference_transforms[] = { benchmark.transforms, benchmark.results + Max_Count };
+    mat4x3f *reference_combined = reference_transforms[Operation_Combine];
+
+    f32 *floats = cast_p(f32, reference_combined + Max_Count);
+    f32 **float_arrays[] = {
+        &benchmark.components.rotation_x, &benchmark.components.rotation_y, &benchmark.components.rotation_z, &benchmark.components.rotation_w,
+        &benchmark.components.translation_x, &benchmark.components.translation_y, &benchmark.components.translation_z,
+        &benchmark.components.scale_x, &benchmark.components.scale_y, &benchmark.components.scale_z,
+        &benchmark.points.x, &benchmark.points.y, &benchmark.points.z,
+        &benchmark.result_points.x, &benchmark.result_points.y, &benchmark.result_points.z,
+        &reference_points.x, &reference_points.y, &reference_points.z,
+    };
+
+    for (u32 i = 0; i < ARRAY_COUNT(float_arrays); i++)
+        *float_arrays[i] = floats + i * Max_Count;
+
+    benchmark.parents = cast_p(u32, floats + ARRAY_COUNT(float_arrays) * Max_Count);
+    benchmark.indices = benchmark.parents + Max_Count;
+
+    benchmark.components.count = Max_Count;
+    benchmark.points.count     = Max_Count;
+    benchmark.point_transform  = make_transform(make_quat(normalize(vec3f{ 1, 2, 3 }), 0.7f), vec3f{ 10, 20, 30 }, vec3f{ 2, 2, 2 });
+
+    Random random = { 12345 };
+    for (u32 i = 0; i < Max_Count; i++) {
+        f32 values[10];
+        random_units(&random, ARRAY_WITH_COUNT(values));
+
+        vec3f axis = normalize(vec3f{ values[0] - 0.5f, values[1] - 0.5f, values[2] - 0.5f } + vec3f{ 0, 1e-3f, 0 });
+        auto rotation = make_quat(axis, values[3] * 2 * Pi32);
+        vec3f translation = vec3f{ values[4], values[5], values[6] } * 1000.0f - vec3f{ 500, 500, 500 };
+        vec3f scale = vec3f{ values[7], values[8], values[9] } * 1.5f + vec3f{ 0.5f, 0.5f, 0.5f };
+
+        benchmark.components.rotation_x[i]    = rotation.x;
+        benchmark.components.rotation_y[i]    = rotation.y;
+        benchmark.components.rotation_z[i]    = rotation.z;
+        benchmark.components.rotation_w[i]    = rotation.w;
+        benchmark.components.translation_x[i] = translation.x;
+        benchmark.components.translation_y[i] = translation.y;
+        benchmark.components.translation_z[i] = translation.z;
+        benchmark.components.scale_x[i]       = scale.x;
+        benchmark.components.scale_y[i]       = scale.y;
+        benchmark.components.scale_z[i]       = scale.z;
+
+        benchmark.points.x[i] = translation.y;
+        benchmark.points.y[i] = translation.z;
+        benchmark.points.z[i] = translation.x;
+
+        benchmark.transforms[i]          = make_transform(rotation, translation, scale);
+        benchmark.unscaled_transforms[i] = make_transform(rotation, translation);
+
+        benchmark.parents[i] = i / 16;
+        benchmark.indices[i] = i;
+    }
+
+    for (u32 i = 0; i < Max_Count; i++) {
+        reference_combined[i] = combine_transforms(benchmark.transforms[benchmark.parents[i]], benchmark.transforms[i]);
+
+        vec3f point = transform_point(benchmark.point_transform, vec3f{ benchmark.points.x[i], benchmark.points.y[i], benchmark.points.z[i] });
+        reference_points.x[i] = point.x;
+        reference_points.y[i] = point.y;
+        reference_points.z[i] = point.z;
+    }
+
+    char report_buffer[4096];
+    auto report = make_report(report_buffer, sizeof(report_buffer));
+
+    report_write(&report, "transform batch benchmark, best of %u runs of %u elements each\n%-8s %-8s %8s %16s %12s %12s\n",
+                 Iteration_Count, Max_Count, "kernel", "simd", "batch", "MTransforms/s", "ns/element", "max error");
+
+    for (u32 kernel_index = 0; kernel_index < ARRAY_COUNT(kernels); kernel_index++) {
+        auto kernel = kernels + kernel_index;
+
+        for (u32 batch_index = 0; batch_index < ARRAY_COUNT(Batch_Counts); batch_index++) {
+            u32 count = Batch_Counts[batch_index];
+
+            // small batches repeat, so every run covers the same element count
+            u32 repeat_count = Max_Count / count;
+            f64 best_seconds = 1e30;
+
+            for (u32 iteration = 0; iteration < Iteration_Count; iteration++) {
+                u64 start = get_clock_ticks();
+
+                for (u32 repeat = 0; repeat < repeat_count; repeat++)
+                    kernel->function(&benchmark, count);
+
+                best_seconds = min(best_seconds, get_clock_seconds(get_clock_ticks() - start));
+            }
+
+            // the results of the last batch against the one at a time version
+            f32 max_error = 0;
+
+            if (kernel->operation == Operation_Points) {
+                for (u32 i = 0; i < count; i++) {
+                    max_error = max(max_error, abs(benchmark.result_points.x[i] - reference_points.x[i]));
+                    max_error = max(max_error, abs(benchmark.result_points.y[i] - reference_points.y[i]));
+                    max_error = max(max_error, abs(benchmark.result_points.z[i] - reference_points.z[i]));
+                }
+            }
+            else if (kernel->operation == Operation_Invert) {
+                // the inverse times the transform is the identity
+                for (u32 i = 0; i < count; i++) {
+                    mat4x3f identity = combine_transforms(benchmark.results[i], benchmark.unscaled_transforms[i]);
+
+                    for (u32 j = 0; j < 12; j++)
+                        max_error = max(max_error, abs((&identity.columns[0].x)[j] - (&MAT4X3_IDENTITY.columns[0].x)[j]));
+                }
+            }
+            else {
+                for (u32 i = 0; i < count; i++) {
+                    for (u32 j = 0; j < 12; j++)
+                        max_error = max(max_error, abs((&benchmark.results[i].columns[0].x)[j] - (&reference_transforms[kernel->operation][i].columns[0].x)[j]));
+                }
+            }
+
+            f64 element_count = cast_v(f64, repeat_count) * count;
+
+            report_write(&report, "%-8s %-8s %8u %16.1f %12.3f %12g\n",
+                         kernel->operation_name, kernel->name, count,
+                         element_count / best_seconds * 1e-6, best_seconds * 1e9 / element_count, max_error);
+        }
+    }
+
+    write_report(&report, platform_api, S("transform_batch_benchmark.txt"));
+}
+
+#endif // BENCHMARK_TRANSFORM_BATCH
+
+#endif // TRANSFORM_BATCH_H
@@ -0,0 +1,167 @@
+#if !defined UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+// per frame gpu memory for uniform blocks and texture buffers.
+// one persistently mapped buffer is split into Uniform_Ring_Frame_Count segments,
+// a frame writes to its own segment and binds sub ranges of it.
+// a segment is written again Uniform_Ring_Frame_Count frames later, after the fence of its last frame passed,
+// so no write waits on a buffer the gpu is still reading.
+// without GL_ARB_buffer_storage (gl 4.4) the ring is a cpu copy and every range is uploaded with glBufferSubData
+// by flush_uniform_range once it is written, push_uniform_data does that itself. texture buffer ranges need gl 4.3.
+// the mapping is write combined, build blocks on the stack and copy them over instead of reading it back.
+
+#include "memory_stats.h"
+#include "texture_load.h"
+
+u32 const Uniform_Ring_Frame_Count = 3;
+
+struct Uniform_Ring {
+    GLuint buffer_object;
+    u8 *base;
+
+    // false without buffer storage, then base points into cpu_memory
+    bool is_mapped;
+    u8_array cpu_memory;
+
+    u32 frame_capacity;
+    u32 alignment;
+
+    u32 frame_index;
+    u32 used_size;
+
+    GLsync frame_fences[Uniform_Ring_Frame_Count];
+
+    // frames that had to wait for the gpu, should stay 0
+    u32 wait_count;
+};
+
+struct Uniform_Range {
+    u8 *data;
+    GLuint buffer_object;
+    u32 offset;
+    u32 size;
+};
+
+bool init_uniform_ring(Uniform_Ring *ring, Memory_Allocator *allocator, u32 frame_capacity) {
+    *ring = {};
+
+    // both alignments are powers of two
+    GLint uniform_alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+
+    GLint texture_alignment = 0;
+    glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &texture_alignment);
+
+    ring->alignment      = max(cast_v(u32, max(uniform_alignment, texture_alignment)), 16u);
+    ring->frame_capacity = align_up(frame_capacity, ring->alignment);
+
+    u32 size = ring->frame_capacity * Uniform_Ring_Frame_Count;
+
+    GLint major_version = 0;
+    GLint minor_version = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major_version);
+    glGetIntegerv(GL_MINOR_VERSION, &minor_version);
+
+    bool has_buffer_storage = (major_version > 4) || ((major_version == 4) && (minor_version >= 4)) || has_gl_extension("GL_ARB_buffer_storage");
+
+    glGenBuffers(1, &ring->buffer_object);
+    glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer_object);
+
+    if (has_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, 0, flags);
+        ring->base = cast_p(u8, glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+        ring->is_mapped = (ring->base != 0);
+    }
+
+    if (!ring->is_mapped) {
+        glBufferData(GL_UNIFORM_BUFFER, size, 0, GL_STREAM_DRAW);
+        ring->base = TRACK_GROW(allocator, &ring->cpu_memory, size);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    return (ring->base != 0);
+}
+
+// call before the first push of a frame
+void begin_uniform_ring_frame(Uniform_Ring *ring) {
+    ring->frame_index = (ring->frame_index + 1) % Uniform_Ring_Frame_Count;
+    ring->used_size   = 0;
+
+    GLsync fence = ring->frame_fences[ring->frame_index];
+    if (!fence)
+        return;
+
+    // only blocks if the gpu is Uniform_Ring_Frame_Count frames behind
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        ring->wait_count++;
+
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+    }
+
+    glDeleteSync(fence);
+    ring->frame_fences[ring->frame_index] = 0;
+}
+
+// call after the last draw reading the frame's ranges
+void end_uniform_ring_frame(Uniform_Ring *ring) {
+    ring->frame_fences[ring->frame_index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+Uniform_Range push_uniform_range(Uniform_Ring *ring, u32 size) {
+    u32 offset = align_up(ring->used_size, ring->alignment);
+    assert(offset + size <= ring->frame_capacity);
+
+    ring->used_size = offset + size;
+
+    Uniform_Range range;
+    range.buffer_object = ring->buffer_object;
+    range.offset        = ring->frame_index * ring->frame_capacity + offset;
+    range.size          = size;
+    range.data          = ring->base + range.offset;
+
+    return range;
+}
+
+// call once range is written and before the gpu reads it, nothing to do for a mapped ring
+void flush_uniform_range(Uniform_Ring const *ring, Uniform_Range range) {
+    if (ring->is_mapped)
+        return;
+
+    // the copy target, so the uniform buffer bindings stay as they are
+    glBindBuffer(GL_COPY_WRITE_BUFFER, range.buffer_object);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.offset, range.size, range.data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+Uniform_Range push_uniform_data(Uniform_Ring *ring, void const *data, u32 size) {
+    auto range = push_uniform_range(ring, size);
+    memcpy(range.data, data, size);
+    flush_uniform_range(ring, range);
+
+    return range;
+}
+
+void bind_uniform_range(Uniform_Range range, GLuint binding) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, range.buffer_object, range.offset, range.size);
+}
+
+// mooselib binds its uniform buffers once, returns the binding point of buffer_object or -1
+s32 find_uniform_buffer_binding(GLuint buffer_object) {
+    GLint binding_count = 0;
+    glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &binding_count);
+
+    for (s32 i = 0; i < binding_count; i++) {
+        GLint bound_buffer_object = 0;
+        glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, i, &bound_buffer_object);
+
+        if (cast_v(GLuint, bound_buffer_object) == buffer_object)
+            return i;
+    }
+
+    return -1;
+}
+
+#endif // UNIFORM_RING_H